@@ -37,6 +37,7 @@ namespace dae {
 		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
 		Utils::ParseOBJ("Resources/vehicle.obj", vertices, indices);
+		Utils::OptimizeMesh(vertices, indices);
 
 		m_pMesh = std::make_unique<Mesh>(m_pDevice, vertices, indices);
 		m_pMesh->SetWorldMatrix(Matrix::CreateTranslation(0.0f, 0.0f, 5.0f));
@@ -3,6 +3,7 @@
 #include "vector"
 #include "Texture.h"
 
+#include <algorithm>
 #include <memory>
 
 namespace dae
@@ -45,9 +46,47 @@ namespace dae
 		Matrix rotateMatrix{};
 		Matrix translateMatrix{};
 
+		// Object space bounding box of the vertices, the renderer skips the mesh when it lies outside the frustum.
+		// Call UpdateVertexData after changing the vertices, a mesh without bounds is always rendered.
+		Vector3 boundsMin{};
+		Vector3 boundsMax{};
+		bool hasBounds{ false };
+
+		// Object space positions, normals and tangents as structure of arrays for the vertex stage, set by UpdateVertexData.
+		// Component c (position x, y, z, normal x, y, z, tangent x, y, z) of vertex i is vertexStreams[c * vertexStreamStride + i],
+		// the stride is padded to a multiple of 8 with zeros.
+		std::vector<float> vertexStreams{};
+		size_t vertexStreamStride{};
+
 		void UpdateWorldMatrix()
 		{
 			worldMatrix = scaleMatrix * rotateMatrix * translateMatrix;
 		}
+
+		void UpdateVertexData()
+		{
+			vertexStreamStride = (vertices.size() + 7) / 8 * 8;
+			vertexStreams.assign(9 * vertexStreamStride, 0.f);
+
+			hasBounds = !vertices.empty();
+			if (!hasBounds) return;
+
+			boundsMin = vertices[0].position;
+			boundsMax = vertices[0].position;
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				const Vertex& vertex = vertices[i];
+				boundsMin = { std::min(boundsMin.x, vertex.position.x), std::min(boundsMin.y, vertex.position.y), std::min(boundsMin.z, vertex.position.z) };
+				boundsMax = { std::max(boundsMax.x, vertex.position.x), std::max(boundsMax.y, vertex.position.y), std::max(boundsMax.z, vertex.position.z) };
+
+				const Vector3* pComponents[3]{ &vertex.position, &vertex.normal, &vertex.tangent };
+				for (int c = 0; c < 3; ++c)
+				{
+					vertexStreams[(c * 3) * vertexStreamStride + i] = pComponents[c]->x;
+					vertexStreams[(c * 3 + 1) * vertexStreamStride + i] = pComponents[c]->y;
+					vertexStreams[(c * 3 + 2) * vertexStreamStride + i] = pComponents[c]->z;
+				}
+			}
+		}
 	};
 }
@@ -1,6 +1,11 @@
 #pragma once
 #include <cassert>
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
 #include "Maths.h"
 #include "DataTypes.h"
 
@@ -34,12 +39,30 @@ namespace dae
 			vertices.clear();
 			indices.clear();
 
+			// Face corners are welded: every distinct (position, texcoord, normal) index triple becomes one vertex,
+			// corners that repeat a triple reuse its index. Index 0 means the corner doesn't specify it.
+			struct Corner
+			{
+				size_t iPosition, iTexCoord, iNormal;
+				bool operator==(const Corner& other) const = default;
+			};
+			struct CornerHash
+			{
+				size_t operator()(const Corner& corner) const
+				{
+					size_t hash{ std::hash<size_t>{}(corner.iPosition) };
+					hash ^= std::hash<size_t>{}(corner.iTexCoord) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					hash ^= std::hash<size_t>{}(corner.iNormal) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+					return hash;
+				}
+			};
+			std::unordered_map<Corner, uint32_t, CornerHash> cornerIndices{};
+
 			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
+			// read the first word of every line until the end of the file, use the >> operator (istream::operator>>).
+			// Testing the read itself instead of eof, the last line would otherwise be processed twice.
+			while (file >> sCommand)
 			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
 				//use conditional statements to process the different commands	
 				if (sCommand == "#")
 				{
@@ -76,15 +99,12 @@ namespace dae
 					//add the material index as attibute to the attribute array
 					//
 					// Faces or triangles
-					Vertex vertex{};
-					size_t iPosition, iTexCoord, iNormal;
-
 					uint32_t tempIndices[3];
 					for (size_t iFace = 0; iFace < 3; iFace++)
 					{
 						// OBJ format uses 1-based arrays
-						file >> iPosition;
-						vertex.position = positions[iPosition - 1];
+						Corner corner{};
+						file >> corner.iPosition;
 
 						if ('/' == file.peek())//is next in buffer ==  '/' ?
 						{
@@ -93,8 +113,7 @@ namespace dae
 							if ('/' != file.peek())
 							{
 								// Optional texture coordinate
-								file >> iTexCoord;
-								vertex.uv = UVs[iTexCoord - 1];
+								file >> corner.iTexCoord;
 							}
 
 							if ('/' == file.peek())
@@ -102,14 +121,20 @@ namespace dae
 								file.ignore();
 
 								// Optional vertex normal
-								file >> iNormal;
-								vertex.normal = normals[iNormal - 1];
+								file >> corner.iNormal;
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						//indices.push_back(uint32_t(vertices.size()) - 1);
+						const auto [cornerIt, isNewCorner] = cornerIndices.try_emplace(corner, uint32_t(vertices.size()));
+						if (isNewCorner)
+						{
+							Vertex vertex{};
+							vertex.position = positions[corner.iPosition - 1];
+							if (corner.iTexCoord != 0) vertex.uv = UVs[corner.iTexCoord - 1];
+							if (corner.iNormal != 0) vertex.normal = normals[corner.iNormal - 1];
+							vertices.push_back(vertex);
+						}
+						tempIndices[iFace] = cornerIt->second;
 					}
 
 					indices.push_back(tempIndices[0]);
@@ -171,6 +196,298 @@ namespace dae
 			return true;
 #endif
 		}
+
+		// Post-transform vertex cache statistics of a triangle list, simulated on a FIFO cache of cacheSize vertices.
+		// ACMR: vertices transformed per triangle, 3 without any reuse, around 0.5 for a well ordered regular mesh.
+		// ATVR: vertices transformed per vertex of the mesh, 1 when every vertex is transformed only once.
+		struct VertexCacheStatistics
+		{
+			float acmr{};
+			float atvr{};
+		};
+
+		static VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16)
+		{
+			// A vertex is still cached while fewer than cacheSize vertices entered the cache after it
+			std::vector<uint32_t> cacheTimeStamps(vertexCount, 0);
+			uint32_t timeStamp{ cacheSize + 1 };
+			uint32_t transformCount{};
+			for (const uint32_t index : indices)
+			{
+				if (timeStamp - cacheTimeStamps[index] > cacheSize)
+				{
+					cacheTimeStamps[index] = timeStamp++;
+					++transformCount;
+				}
+			}
+
+			VertexCacheStatistics statistics{};
+			if (indices.size() >= 3) statistics.acmr = static_cast<float>(transformCount) / static_cast<float>(indices.size() / 3);
+			if (vertexCount > 0) statistics.atvr = static_cast<float>(transformCount) / static_cast<float>(vertexCount);
+			return statistics;
+		}
+
+		// Reorders the triangles of a list for the post-transform vertex cache, Tom Forsyth's linear-speed optimizer:
+		// the next triangle is always the one whose vertices score highest in a simulated LRU cache. Cached vertices
+		// and vertices with few triangles left score high, so the mesh is finished patch by patch instead of in strips.
+		static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			constexpr int cacheSize{ 32 };
+			constexpr int maxValence{ 32 }; // valence scores above it are calculated, not looked up
+			constexpr uint32_t noTriangle{ UINT32_MAX };
+
+			const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+			if (triangleCount == 0) return;
+
+			// The vertices of the last triangle score the same whatever their order, the rest fall off with the cache position
+			float cachePositionScores[cacheSize]{};
+			for (int i = 0; i < cacheSize; ++i)
+			{
+				cachePositionScores[i] = i < 3 ? 0.75f : std::pow(1.f - static_cast<float>(i - 3) / static_cast<float>(cacheSize - 3), 1.5f);
+			}
+			float valenceScores[maxValence + 1]{};
+			for (int i = 1; i <= maxValence; ++i)
+			{
+				valenceScores[i] = 2.f / std::sqrt(static_cast<float>(i));
+			}
+
+			// Triangles still to emit per vertex: vertexTriangles[triangleOffsets[v], triangleOffsets[v] + remainingTriangles[v])
+			std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+			for (const uint32_t index : indices) ++triangleOffsets[index + 1];
+			for (size_t v = 0; v < vertexCount; ++v) triangleOffsets[v + 1] += triangleOffsets[v];
+
+			std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+			std::vector<uint32_t> vertexTriangles(indices.size());
+			for (uint32_t t = 0; t < triangleCount; ++t)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					const uint32_t v{ indices[t * 3 + i] };
+					vertexTriangles[triangleOffsets[v] + remainingTriangles[v]++] = t;
+				}
+			}
+
+			std::vector<int> cachePositions(vertexCount, -1);
+			auto getVertexScore = [&](uint32_t v)
+			{
+				const uint32_t valence{ remainingTriangles[v] };
+				if (valence == 0) return -1.f; // finished, no triangle can use it anymore
+
+				float score{ cachePositions[v] >= 0 ? cachePositionScores[cachePositions[v]] : 0.f };
+				score += valence <= maxValence ? valenceScores[valence] : 2.f / std::sqrt(static_cast<float>(valence));
+				return score;
+			};
+
+			std::vector<float> vertexScores(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; ++v) vertexScores[v] = getVertexScore(v);
+
+			std::vector<float> triangleScores(triangleCount);
+			std::vector<uint8_t> isEmitted(triangleCount, 0);
+			uint32_t bestTriangle{ 0 };
+			for (uint32_t t = 0; t < triangleCount; ++t)
+			{
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (triangleScores[t] > triangleScores[bestTriangle]) bestTriangle = t;
+			}
+
+			std::vector<uint32_t> optimizedIndices{};
+			optimizedIndices.reserve(indices.size());
+
+			uint32_t cache[cacheSize + 3]{};
+			int cacheCount{};
+			uint32_t firstUnemittedTriangle{};
+			for (uint32_t emitted = 0; emitted < triangleCount; ++emitted)
+			{
+				if (bestTriangle == noTriangle)
+				{
+					// None of the cached vertices has triangles left, start over from the first triangle not emitted yet
+					while (isEmitted[firstUnemittedTriangle]) ++firstUnemittedTriangle;
+					bestTriangle = firstUnemittedTriangle;
+				}
+
+				isEmitted[bestTriangle] = 1;
+				const uint32_t* pTriangle{ &indices[bestTriangle * 3] };
+				optimizedIndices.insert(optimizedIndices.end(), pTriangle, pTriangle + 3);
+
+				// Remove the triangle from the lists of its vertices
+				for (int i = 0; i < 3; ++i)
+				{
+					const uint32_t v{ pTriangle[i] };
+					uint32_t* pTriangles{ &vertexTriangles[triangleOffsets[v]] };
+					uint32_t* pLast{ pTriangles + remainingTriangles[v] - 1 };
+					uint32_t* pFound{ std::find(pTriangles, pLast + 1, bestTriangle) };
+					if (pFound > pLast) continue; // degenerate triangle, already removed for an earlier corner
+
+					*pFound = *pLast;
+					--remainingTriangles[v];
+				}
+
+				// Its vertices move to the front of the cache, the others shift back and the last ones drop out
+				uint32_t newCache[cacheSize + 3]{};
+				int newCacheCount{};
+				for (int i = 0; i < 3; ++i)
+				{
+					if (std::find(newCache, newCache + newCacheCount, pTriangle[i]) == newCache + newCacheCount) newCache[newCacheCount++] = pTriangle[i];
+				}
+				const int triangleVertexCount{ newCacheCount };
+				for (int i = 0; i < cacheCount; ++i)
+				{
+					if (std::find(newCache, newCache + triangleVertexCount, cache[i]) == newCache + triangleVertexCount) newCache[newCacheCount++] = cache[i];
+				}
+
+				for (int i = 0; i < newCacheCount; ++i)
+				{
+					const uint32_t v{ newCache[i] };
+					cachePositions[v] = i < cacheSize ? i : -1;
+					vertexScores[v] = getVertexScore(v);
+				}
+
+				// Only the triangles of vertices whose score changed need a new score, the best of them is next
+				bestTriangle = noTriangle;
+				float bestScore{ -1.f };
+				for (int i = 0; i < newCacheCount; ++i)
+				{
+					const uint32_t v{ newCache[i] };
+					for (uint32_t j = triangleOffsets[v]; j < triangleOffsets[v] + remainingTriangles[v]; ++j)
+					{
+						const uint32_t t{ vertexTriangles[j] };
+						const float score{ vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]] };
+						triangleScores[t] = score;
+						if (score > bestScore)
+						{
+							bestScore = score;
+							bestTriangle = t;
+						}
+					}
+				}
+
+				cacheCount = std::min(newCacheCount, cacheSize);
+				std::copy(newCache, newCache + cacheCount, cache);
+			}
+
+			indices = std::move(optimizedIndices);
+		}
+
+		// Reorders the clusters of a vertex cache optimized triangle list against overdraw, after Sander et al. (Tipsify).
+		// A cluster ends where the cache starts over anyway (all three vertices of a triangle miss) or where its own ACMR,
+		// from an empty cache, is within threshold of the ACMR of the mesh. Clusters facing away from the center of the
+		// mesh are drawn first, they tend to occlude the rest and the depth test rejects more of what follows.
+		static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f, uint32_t cacheSize = 16)
+		{
+			const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+			if (triangleCount == 0) return;
+
+			const float maxClusterACMR{ AnalyzeVertexCache(indices, vertices.size(), cacheSize).acmr * threshold };
+
+			std::vector<uint32_t> clusterStarts{};
+			std::vector<uint32_t> cacheTimeStamps(vertices.size(), 0);
+			uint32_t timeStamp{ cacheSize + 1 };
+			uint32_t clusterTriangles{};
+			uint32_t clusterTransforms{};
+			for (uint32_t t = 0; t < triangleCount; ++t)
+			{
+				if (clusterTriangles > 0 && static_cast<float>(clusterTransforms) <= maxClusterACMR * static_cast<float>(clusterTriangles))
+				{
+					// Cut here and flush the cache, the next cluster is measured from scratch
+					clusterTriangles = 0;
+					clusterTransforms = 0;
+					timeStamp += cacheSize + 1;
+				}
+
+				uint32_t transforms{};
+				for (int i = 0; i < 3; ++i)
+				{
+					const uint32_t v{ indices[t * 3 + i] };
+					if (timeStamp - cacheTimeStamps[v] > cacheSize)
+					{
+						cacheTimeStamps[v] = timeStamp++;
+						++transforms;
+					}
+				}
+
+				if (clusterTriangles == 0 || transforms == 3)
+				{
+					clusterStarts.push_back(t);
+					clusterTriangles = 0;
+					clusterTransforms = 0;
+				}
+				++clusterTriangles;
+				clusterTransforms += transforms;
+			}
+			clusterStarts.push_back(triangleCount);
+
+			const size_t clusterCount{ clusterStarts.size() - 1 };
+			std::vector<Vector3> clusterCentroids(clusterCount);
+			std::vector<Vector3> clusterNormals(clusterCount);
+			Vector3 meshCentroid{};
+			for (size_t c = 0; c < clusterCount; ++c)
+			{
+				for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+				{
+					for (int i = 0; i < 3; ++i)
+					{
+						const Vertex& vertex{ vertices[indices[t * 3 + i]] };
+						clusterCentroids[c] += vertex.position;
+						clusterNormals[c] += vertex.normal; // the vertex normals, they don't depend on the winding order
+					}
+				}
+				meshCentroid += clusterCentroids[c];
+				clusterCentroids[c] /= static_cast<float>((clusterStarts[c + 1] - clusterStarts[c]) * 3);
+			}
+			meshCentroid /= static_cast<float>(triangleCount * 3);
+
+			std::vector<float> clusterSortKeys(clusterCount);
+			for (size_t c = 0; c < clusterCount; ++c)
+			{
+				const float normalLength{ clusterNormals[c].Magnitude() };
+				clusterSortKeys[c] = normalLength > 0.f ? Vector3::Dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]) / normalLength : 0.f;
+			}
+
+			std::vector<uint32_t> clusterOrder(clusterCount);
+			std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+			std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t c0, uint32_t c1) { return clusterSortKeys[c0] > clusterSortKeys[c1]; });
+
+			std::vector<uint32_t> sortedIndices{};
+			sortedIndices.reserve(indices.size());
+			for (const uint32_t c : clusterOrder)
+			{
+				sortedIndices.insert(sortedIndices.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+			}
+			indices = std::move(sortedIndices);
+		}
+
+		// Renumbers the vertices in the order the index buffer first uses them, so consecutive triangles fetch
+		// neighbouring vertices. Vertices no triangle uses are dropped.
+		static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+			std::vector<Vertex> orderedVertices{};
+			orderedVertices.reserve(vertices.size());
+			for (uint32_t& index : indices)
+			{
+				if (remap[index] == UINT32_MAX)
+				{
+					remap[index] = static_cast<uint32_t>(orderedVertices.size());
+					orderedVertices.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+			vertices = std::move(orderedVertices);
+		}
+
+		// Vertex cache, overdraw and vertex fetch optimization of a triangle list, prints the ACMR/ATVR before and after
+		static void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			const VertexCacheStatistics before{ AnalyzeVertexCache(indices, vertices.size()) };
+
+			OptimizeVertexCache(indices, vertices.size());
+			OptimizeOverdraw(indices, vertices);
+			OptimizeVertexFetch(vertices, indices);
+
+			const VertexCacheStatistics after{ AnalyzeVertexCache(indices, vertices.size()) };
+			std::cout << "Mesh optimized: ACMR " << before.acmr << " -> " << after.acmr
+				<< ", ATVR " << before.atvr << " -> " << after.atvr << " (16 vertex FIFO cache)\n";
+		}
 #pragma warning(pop)
 	}
 }
\ No newline at end of file
@@ -9,8 +9,79 @@
 #include "Maths.h"
 #include "BRDFs.h"
 
+#include <algorithm>
+#include <execution>
+#include <ranges>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define PARALLEL_EXECUTION
+
+// Screen tiles are TILE_SIZE x TILE_SIZE pixels, triangles are binned in chunks of BIN_CHUNK_SIZE
+#define TILE_SIZE 64
+#define BIN_CHUNK_SIZE 1024
+// Rows are rasterized in screen aligned segments of BLOCK_SIZE pixels, one 8 wide coverage mask each.
+// The hierarchical depth buffer keeps one min/max per BLOCK_SIZE x BLOCK_SIZE block, TILE_SIZE must be a multiple.
+#define BLOCK_SIZE 8
+// Vertices may lie up to GUARD_BAND_SIZE pixels beyond the screen edges before a triangle is clipped against the sides
+#define GUARD_BAND_SIZE 2048
+// Vertices are transformed in parallel batches of VERTEX_BATCH_SIZE, a multiple of 8
+#define VERTEX_BATCH_SIZE 4096
+
 namespace dae
 {
+	namespace
+	{
+		// Clip outcodes, one bit per plane a clip space vertex lies outside of
+		constexpr uint32_t NEAR_PLANE{ 1 << 0 }; // z < 0
+		constexpr uint32_t GUARD_BAND_LEFT{ 1 << 1 };
+		constexpr uint32_t GUARD_BAND_RIGHT{ 1 << 2 };
+		constexpr uint32_t GUARD_BAND_BOTTOM{ 1 << 3 };
+		constexpr uint32_t GUARD_BAND_TOP{ 1 << 4 };
+		constexpr uint32_t FRUSTUM_LEFT{ 1 << 5 };
+		constexpr uint32_t FRUSTUM_RIGHT{ 1 << 6 };
+		constexpr uint32_t FRUSTUM_BOTTOM{ 1 << 7 };
+		constexpr uint32_t FRUSTUM_TOP{ 1 << 8 };
+		constexpr uint32_t FAR_PLANE{ 1 << 9 }; // z > w
+
+		// Planes that get clipped against, the frustum planes only reject triangles that lie completely outside
+		constexpr uint32_t CLIP_PLANES{ NEAR_PLANE | GUARD_BAND_LEFT | GUARD_BAND_RIGHT | GUARD_BAND_BOTTOM | GUARD_BAND_TOP };
+		constexpr uint32_t REJECT_PLANES{ NEAR_PLANE | FRUSTUM_LEFT | FRUSTUM_RIGHT | FRUSTUM_BOTTOM | FRUSTUM_TOP | FAR_PLANE };
+
+		// The guard band is [-guardBand * w, guardBand * w] in clip space
+		uint32_t GetClipOutcode(const Vector4& position, float guardBandX, float guardBandY)
+		{
+			uint32_t outcode{};
+			if (position.z < 0.0f) outcode |= NEAR_PLANE;
+			if (position.z > position.w) outcode |= FAR_PLANE;
+			if (position.x < -position.w) outcode |= FRUSTUM_LEFT;
+			if (position.x > position.w) outcode |= FRUSTUM_RIGHT;
+			if (position.y < -position.w) outcode |= FRUSTUM_BOTTOM;
+			if (position.y > position.w) outcode |= FRUSTUM_TOP;
+			if (position.x < -guardBandX * position.w) outcode |= GUARD_BAND_LEFT;
+			if (position.x > guardBandX * position.w) outcode |= GUARD_BAND_RIGHT;
+			if (position.y < -guardBandY * position.w) outcode |= GUARD_BAND_BOTTOM;
+			if (position.y > guardBandY * position.w) outcode |= GUARD_BAND_TOP;
+			return outcode;
+		}
+
+		// Signed distance to a clip plane, positive inside
+		float GetClipDistance(const Vector4& position, uint32_t plane, float guardBandX, float guardBandY)
+		{
+			switch (plane)
+			{
+			case NEAR_PLANE: return position.z;
+			case GUARD_BAND_LEFT: return position.x + guardBandX * position.w;
+			case GUARD_BAND_RIGHT: return guardBandX * position.w - position.x;
+			case GUARD_BAND_BOTTOM: return position.y + guardBandY * position.w;
+			case GUARD_BAND_TOP: return guardBandY * position.w - position.y;
+			default: return 0.0f;
+			}
+		}
+	}
+
 	Renderer::Renderer(SDL_Window* pWindow) 
 		: m_pWindow(pWindow)
 		, m_CurrentLightingMode{ LightingMode::Combined }
@@ -24,6 +95,16 @@ namespace dae
 		m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 		m_pDepthBufferPixels = new float[m_Width * m_Height] {};
+		m_TriangleIndexBuffer.resize(static_cast<size_t>(m_Width) * m_Height);
+
+		m_TilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+		m_TilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+
+		m_HiZBlocksX = (m_Width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		const size_t hiZBlockCount{ static_cast<size_t>(m_HiZBlocksX) * ((m_Height + BLOCK_SIZE - 1) / BLOCK_SIZE) };
+		m_HiZMinDepths.resize(hiZBlockCount);
+		m_HiZMaxDepths.resize(hiZBlockCount);
+		m_IsHiZMaxStale.resize(hiZBlockCount);
 
 		//Initialize Camera
 		m_Camera.aspectRatio = m_AspectRatio;
@@ -32,6 +113,8 @@ namespace dae
 
 		// Initialize test mesh & texture(s)
 		Utils::ParseOBJ("Resources/vehicle.obj", m_Mesh.vertices, m_Mesh.indices);
+		Utils::OptimizeMesh(m_Mesh.vertices, m_Mesh.indices);
+		m_Mesh.UpdateVertexData();
 		m_Mesh.primitiveTopology = PrimitiveTopology::TriangleList;			
 		m_Mesh.translateMatrix = Matrix::CreateTranslation(0.f, 0.f, 0.f);
 
@@ -65,10 +148,7 @@ namespace dae
 	void Renderer::Render()
 	{
 		//@START
-		std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
-		SDL_FillRect(m_pBackBuffer, nullptr, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
-
-		//Lock BackBuffer
+		//Lock BackBuffer, the tiles clear their own depth and triangle indices right before rasterizing (see RasterizeTiles)
 		SDL_LockSurface(m_pBackBuffer);
 
 		// Assignment
@@ -83,47 +163,195 @@ namespace dae
 
 	void Renderer::RenderMesh()
 	{
-		VertexTransformationFunction(m_Mesh);
-
-		switch (m_Mesh.primitiveTopology)
+		if (IsMeshInFrustum(m_Mesh))
+		{
+			VertexTransformationFunction(m_Mesh);
+			BinTriangles(m_Mesh);
+		}
+		else
 		{
-		case PrimitiveTopology::TriangleList:
-			RasterizeTriangleList(m_Mesh);
-			break;
+			// Nothing to bin, the tiles only clear
+			m_Triangles.clear();
+			m_BinChunkCount = 0;
+		}
+
+		RasterizeTiles(m_Mesh);
+	}
+
+	bool Renderer::IsMeshInFrustum(const Mesh& mesh) const
+	{
+		if (!mesh.hasBounds) return true;
+
+		const Matrix worldViewProjectionMatrix = mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
 
-		case PrimitiveTopology::TriangleStrip:
-			RasterizeTriangleStrip(m_Mesh);
-			break;
+		// Outside when all 8 corners lie outside the same plane
+		uint32_t commonOutcode{ ~0u };
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const Vector4 position{
+				(corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+				(corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+				(corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z,
+				1.0f };
+			commonOutcode &= GetClipOutcode(worldViewProjectionMatrix.TransformPoint(position), 1.0f, 1.0f);
 		}
+
+		return (commonOutcode & REJECT_PLANES) == 0;
 	}
 
 
-	void Renderer::VertexTransformationFunction(Mesh& mesh) const
+	void Renderer::VertexTransformationFunction(Mesh& mesh)
 	{
+		const size_t vertexCount{ mesh.vertices.size() };
 
-		// match size of vertices_out with the max vertices of the mesh
-		mesh.vertices_out.resize(mesh.vertices.size());
+		// The streams are only rebuilt when the vertices were replaced, the output buffers keep their size between frames
+		if (mesh.vertexStreamStride != (vertexCount + 7) / 8 * 8) mesh.UpdateVertexData();
+		if (mesh.vertices_out.size() != vertexCount) mesh.vertices_out.resize(vertexCount);
+		if (m_ClipPositions.size() != vertexCount) m_ClipPositions.resize(vertexCount);
 
 		// Calculate WorldViewProjection matrix
-		Matrix worldViewProjectionMatrix = mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+		const Matrix worldViewProjectionMatrix = mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
 
-		for (size_t i = 0; i < mesh.vertices.size(); ++i)
+		// Matrix elements [row][column] and camera origin as plain floats, read once instead of per vertex
+		float projection[4][4], world[4][3], cameraOrigin[3];
+		for (int row = 0; row < 4; ++row)
+		{
+			const Vector4 projectionRow{ worldViewProjectionMatrix[row] };
+			const Vector4 worldRow{ mesh.worldMatrix[row] };
+			for (int column = 0; column < 4; ++column)
+			{
+				projection[row][column] = projectionRow[column];
+				if (column < 3) world[row][column] = worldRow[column];
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis)
 		{
-			// Convert Vertex to Vertex_Out
-			mesh.vertices_out[i].position = {mesh.vertices[i].position, 1.0f};
-			mesh.vertices_out[i].color = mesh.vertices[i].color;
-			mesh.vertices_out[i].uv = mesh.vertices[i].uv;
-			mesh.vertices_out[i].normal = mesh.worldMatrix.TransformVector(mesh.vertices[i].normal); // normals in worldview
-			mesh.vertices_out[i].tangent = mesh.worldMatrix.TransformVector(mesh.vertices[i].tangent); // tangent in worldview
+			cameraOrigin[axis] = m_Camera.origin[axis];
+		}
+
+		const float* pStreams = mesh.vertexStreams.data();
+		const size_t stride{ mesh.vertexStreamStride };
 
-			mesh.vertices_out[i].position = worldViewProjectionMatrix.TransformPoint(mesh.vertices_out[i].position); // projection view for vertices
+		// Every batch transforms its vertices 8 at a time: clip position, perspective divide and viewport,
+		// normal and tangent to world space and the view direction, then spreads them over vertices_out
+		const auto transformBatch = [&](size_t batch)
+		{
+			alignas(32) float clip[4][8], screen[3][8], normal[3][8], tangent[3][8], viewDirection[3][8];
 
-			Vector3 worldPosition = mesh.worldMatrix.TransformPoint(mesh.vertices_out[i].position);
-			mesh.vertices_out[i].viewDirection = (worldPosition - m_Camera.origin).Normalized();
+			const size_t lastVertex{ std::min((batch + 1) * VERTEX_BATCH_SIZE, vertexCount) };
+			for (size_t first = batch * VERTEX_BATCH_SIZE; first < lastVertex; first += 8)
+			{
+#ifdef __AVX2__
+				__m256 components[9];
+				for (int c = 0; c < 9; ++c)
+				{
+					components[c] = _mm256_loadu_ps(pStreams + c * stride + first);
+				}
 
-			PerspectiveDivide(mesh.vertices_out[i]);
-			TransformToScreenSpace(mesh.vertices_out[i]);
+				// Row vector times matrix, the same sums as Matrix::TransformPoint and Matrix::TransformVector
+				const auto transform = [&](const auto& matrix, int component, int axis, bool isPoint)
+				{
+					__m256 result = _mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(components[component], _mm256_set1_ps(matrix[0][axis])),
+						_mm256_mul_ps(components[component + 1], _mm256_set1_ps(matrix[1][axis]))),
+						_mm256_mul_ps(components[component + 2], _mm256_set1_ps(matrix[2][axis])));
+					if (isPoint) result = _mm256_add_ps(result, _mm256_set1_ps(matrix[3][axis]));
+					return result;
+				};
+
+				__m256 clipAxes[4];
+				for (int axis = 0; axis < 4; ++axis)
+				{
+					clipAxes[axis] = transform(projection, 0, axis, true);
+					_mm256_store_ps(clip[axis], clipAxes[axis]);
+				}
+
+				const __m256 one = _mm256_set1_ps(1.0f);
+				const __m256 half = _mm256_set1_ps(0.5f);
+				_mm256_store_ps(screen[0], _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(clipAxes[0], clipAxes[3]), one), half), _mm256_set1_ps(static_cast<float>(m_Width))));
+				_mm256_store_ps(screen[1], _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_div_ps(clipAxes[1], clipAxes[3])), half), _mm256_set1_ps(static_cast<float>(m_Height))));
+				_mm256_store_ps(screen[2], _mm256_div_ps(clipAxes[2], clipAxes[3]));
+
+				__m256 toVertex[3];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					_mm256_store_ps(normal[axis], transform(world, 3, axis, false));
+					_mm256_store_ps(tangent[axis], transform(world, 6, axis, false));
+					toVertex[axis] = _mm256_sub_ps(transform(world, 0, axis, true), _mm256_set1_ps(cameraOrigin[axis]));
+				}
+				const __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(toVertex[0], toVertex[0]),
+					_mm256_mul_ps(toVertex[1], toVertex[1])),
+					_mm256_mul_ps(toVertex[2], toVertex[2])));
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					_mm256_store_ps(viewDirection[axis], _mm256_div_ps(toVertex[axis], distance));
+				}
+#else
+				for (int lane = 0; lane < 8; ++lane)
+				{
+					float components[9];
+					for (int c = 0; c < 9; ++c)
+					{
+						components[c] = pStreams[c * stride + first + lane];
+					}
+
+					const auto transform = [&](const auto& matrix, int component, int axis, bool isPoint)
+					{
+						float result{ components[component] * matrix[0][axis] + components[component + 1] * matrix[1][axis] + components[component + 2] * matrix[2][axis] };
+						if (isPoint) result += matrix[3][axis];
+						return result;
+					};
+
+					for (int axis = 0; axis < 4; ++axis)
+					{
+						clip[axis][lane] = transform(projection, 0, axis, true);
+					}
+					screen[0][lane] = (clip[0][lane] / clip[3][lane] + 1) * 0.5f * m_Width;
+					screen[1][lane] = (1 - clip[1][lane] / clip[3][lane]) * 0.5f * m_Height;
+					screen[2][lane] = clip[2][lane] / clip[3][lane];
+
+					float toVertex[3];
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						normal[axis][lane] = transform(world, 3, axis, false);
+						tangent[axis][lane] = transform(world, 6, axis, false);
+						toVertex[axis] = transform(world, 0, axis, true) - cameraOrigin[axis];
+					}
+					const float distance{ std::sqrt(toVertex[0] * toVertex[0] + toVertex[1] * toVertex[1] + toVertex[2] * toVertex[2]) };
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						viewDirection[axis][lane] = toVertex[axis] / distance;
+					}
+				}
+#endif
+
+				const int laneCount{ static_cast<int>(std::min<size_t>(8, lastVertex - first)) };
+				for (int lane = 0; lane < laneCount; ++lane)
+				{
+					const size_t i{ first + lane };
+					Vertex_Out& vertexOut = mesh.vertices_out[i];
+					vertexOut.position = { screen[0][lane], screen[1][lane], screen[2][lane], clip[3][lane] };
+					vertexOut.color = mesh.vertices[i].color;
+					vertexOut.uv = mesh.vertices[i].uv;
+					vertexOut.normal = { normal[0][lane], normal[1][lane], normal[2][lane] };
+					vertexOut.tangent = { tangent[0][lane], tangent[1][lane], tangent[2][lane] };
+					vertexOut.viewDirection = { viewDirection[0][lane], viewDirection[1][lane], viewDirection[2][lane] };
+					m_ClipPositions[i] = { clip[0][lane], clip[1][lane], clip[2][lane], clip[3][lane] };
+				}
+			}
+		};
+
+		const size_t batchCount{ (vertexCount + VERTEX_BATCH_SIZE - 1) / VERTEX_BATCH_SIZE };
+#ifdef PARALLEL_EXECUTION
+		auto batches = std::views::iota(size_t{ 0 }, batchCount);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), transformBatch);
+#else
+		for (size_t batch = 0; batch < batchCount; ++batch)
+		{
+			transformBatch(batch);
 		}
+#endif
 	}
 
 	bool Renderer::SaveBufferToImage() const
@@ -147,114 +375,553 @@ namespace dae
 	}
 
 	
-	void Renderer::RasterizeTriangleStrip(const Mesh& mesh)
+	void Renderer::BinTriangles(const Mesh& mesh)
 	{
-		for (size_t currentIdx = 2; currentIdx < mesh.indices.size(); ++currentIdx) //start odd triangle
+		const bool isStrip{ mesh.primitiveTopology == PrimitiveTopology::TriangleStrip };
+		assert((isStrip || mesh.indices.size() % 3 == 0) && "incomplete triangles");
+
+		size_t triangleCount{ mesh.indices.size() / 3 };
+		if (isStrip) triangleCount = mesh.indices.size() >= 3 ? mesh.indices.size() - 2 : 0;
+
+		const int tileCount{ m_TilesX * m_TilesY };
+		const size_t chunkCount{ (triangleCount + BIN_CHUNK_SIZE - 1) / BIN_CHUNK_SIZE };
+
+		m_Triangles.resize(triangleCount);
+		if (m_TileBins.size() < chunkCount * tileCount) m_TileBins.resize(chunkCount * tileCount);
+		if (m_ClippedChunks.size() < chunkCount) m_ClippedChunks.resize(chunkCount);
+		m_BinChunkCount = chunkCount;
+
+		// Guard band in normalized device coordinates
+		const float guardBandX{ 1.0f + 2.0f * GUARD_BAND_SIZE / m_Width };
+		const float guardBandY{ 1.0f + 2.0f * GUARD_BAND_SIZE / m_Height };
+
+		const auto binChunk = [&](size_t chunk)
+		{
+			std::vector<uint32_t>* pBins = &m_TileBins[chunk * tileCount];
+			for (int tile = 0; tile < tileCount; ++tile)
+			{
+				pBins[tile].clear();
+			}
+
+			ClippedChunk& clippedChunk = m_ClippedChunks[chunk];
+			clippedChunk.triangles.clear();
+			clippedChunk.vertices.clear();
+
+			const auto binTriangle = [&](const TriangleSetup& setup, uint32_t triangleIndex)
+			{
+				for (int tileY = setup.minY / TILE_SIZE; tileY <= (setup.maxY - 1) / TILE_SIZE; ++tileY)
+				{
+					for (int tileX = setup.minX / TILE_SIZE; tileX <= (setup.maxX - 1) / TILE_SIZE; ++tileX)
+					{
+						pBins[tileX + tileY * m_TilesX].push_back(triangleIndex);
+					}
+				}
+			};
+
+			// Clipping adds a vertex per plane at most
+			ClipVertex polygon[3 + 5];
+			ClipVertex scratch[3 + 5];
+
+			const size_t lastTriangle{ std::min((chunk + 1) * BIN_CHUNK_SIZE, triangleCount) };
+			for (size_t triangleIndex = chunk * BIN_CHUNK_SIZE; triangleIndex < lastTriangle; ++triangleIndex)
+			{
+				TriangleSetup& setup = m_Triangles[triangleIndex];
+
+				if (isStrip)
+				{
+					// Every odd triangle swaps its first two vertices to keep the winding
+					const size_t isOdd{ triangleIndex % 2 };
+					setup.vertexIndices[0] = mesh.indices[triangleIndex + isOdd];
+					setup.vertexIndices[1] = mesh.indices[triangleIndex + 1 - isOdd];
+					setup.vertexIndices[2] = mesh.indices[triangleIndex + 2];
+				}
+				else
+				{
+					setup.vertexIndices[0] = mesh.indices[triangleIndex * 3];
+					setup.vertexIndices[1] = mesh.indices[triangleIndex * 3 + 1];
+					setup.vertexIndices[2] = mesh.indices[triangleIndex * 3 + 2];
+				}
+
+				uint32_t outcodes[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					outcodes[i] = GetClipOutcode(m_ClipPositions[setup.vertexIndices[i]], guardBandX, guardBandY);
+				}
+
+				// All vertices outside the same plane
+				if (outcodes[0] & outcodes[1] & outcodes[2] & REJECT_PLANES) continue;
+
+				// Within the guard band and in front of the near plane, rasterized as is
+				const uint32_t clipOutcodes{ (outcodes[0] | outcodes[1] | outcodes[2]) & CLIP_PLANES };
+				if (clipOutcodes == 0)
+				{
+					if (SetupTriangle(setup, mesh.vertices_out[setup.vertexIndices[0]].position, mesh.vertices_out[setup.vertexIndices[1]].position, mesh.vertices_out[setup.vertexIndices[2]].position))
+					{
+						binTriangle(setup, static_cast<uint32_t>(triangleIndex));
+					}
+					continue;
+				}
+
+				for (int i = 0; i < 3; ++i)
+				{
+					polygon[i].position = m_ClipPositions[setup.vertexIndices[i]];
+					polygon[i].vertex = mesh.vertices_out[setup.vertexIndices[i]];
+				}
+				const int polygonCount{ ClipPolygon(polygon, scratch, 3, clipOutcodes, guardBandX, guardBandY) };
+				if (polygonCount < 3) continue;
+
+				const uint32_t firstVertex{ static_cast<uint32_t>(clippedChunk.vertices.size()) };
+				for (int i = 0; i < polygonCount; ++i)
+				{
+					polygon[i].vertex.position = polygon[i].position;
+					PerspectiveDivide(polygon[i].vertex);
+					TransformToScreenSpace(polygon[i].vertex);
+					clippedChunk.vertices.push_back(polygon[i].vertex);
+				}
+
+				// Triangle fan around the first vertex, keeps the winding
+				for (int i = 1; i + 1 < polygonCount; ++i)
+				{
+					TriangleSetup clippedSetup{};
+					clippedSetup.vertexIndices[0] = firstVertex;
+					clippedSetup.vertexIndices[1] = firstVertex + i;
+					clippedSetup.vertexIndices[2] = firstVertex + i + 1;
+					if (!SetupTriangle(clippedSetup, polygon[0].vertex.position, polygon[i].vertex.position, polygon[i + 1].vertex.position)) continue;
+
+					binTriangle(clippedSetup, CLIPPED_TRIANGLE | static_cast<uint32_t>(clippedChunk.triangles.size()));
+					clippedChunk.triangles.push_back(clippedSetup);
+				}
+			}
+		};
+
+#ifdef PARALLEL_EXECUTION
+		auto chunks = std::views::iota(size_t{ 0 }, chunkCount);
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), binChunk);
+#else
+		for (size_t chunk = 0; chunk < chunkCount; ++chunk)
 		{
-			// Check first vertex idx for every odd triangle
-			size_t firstVertexIndex = (currentIdx % 2) == 0 ? currentIdx - 2 : currentIdx - 1;
-			// Check second vertex idx for every odd triangle
-			size_t secondVertexIndex = (currentIdx % 2) == 0 ? currentIdx - 1 : currentIdx - 2;
-			// Check third vertex idx for every odd triangle
-			size_t thirdVertexIndex = currentIdx;
-
-			const Vertex_Out& vertex0 = mesh.vertices_out[mesh.indices[firstVertexIndex]];
-			const Vertex_Out& vertex1 = mesh.vertices_out[mesh.indices[secondVertexIndex]];
-			const Vertex_Out& vertex2 = mesh.vertices_out[mesh.indices[thirdVertexIndex]];
-
-			RasterizeTriangle(vertex0, vertex1, vertex2);
+			binChunk(chunk);
+		}
+#endif
+
+		// Clipped triangles and their vertices go behind the mesh triangles and vertices, usually only a handful
+		m_ClippedVertices.clear();
+		for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			ClippedChunk& clippedChunk = m_ClippedChunks[chunk];
+			clippedChunk.firstTriangle = static_cast<uint32_t>(m_Triangles.size());
+
+			const uint32_t firstVertex{ static_cast<uint32_t>(mesh.vertices_out.size() + m_ClippedVertices.size()) };
+			for (TriangleSetup& setup : clippedChunk.triangles)
+			{
+				for (uint32_t& vertexIndex : setup.vertexIndices)
+				{
+					vertexIndex += firstVertex;
+				}
+				m_Triangles.push_back(setup);
+			}
+			m_ClippedVertices.insert(m_ClippedVertices.end(), clippedChunk.vertices.begin(), clippedChunk.vertices.end());
 		}
 	}
 
-	void Renderer::RasterizeTriangleList(const Mesh& mesh)
+	bool Renderer::SetupTriangle(TriangleSetup& setup, const Vector4& position0, const Vector4& position1, const Vector4& position2) const
 	{
-		assert(mesh.indices.size() % 3 == 0 && "incomplete triangles");
+		// Find triangle bounding box, only the pixel centers (+ 0.5) inside it, clamped to the screen size.
+		// Small triangles that fall between the pixel centers end up with an empty box.
+		setup.minX = std::clamp(static_cast<int>(std::ceil(std::min({ position0.x, position1.x, position2.x }) - 0.5f)), 0, m_Width);
+		setup.maxX = std::clamp(static_cast<int>(std::floor(std::max({ position0.x, position1.x, position2.x }) - 0.5f)) + 1, 0, m_Width);
+		setup.minY = std::clamp(static_cast<int>(std::ceil(std::min({ position0.y, position1.y, position2.y }) - 0.5f)), 0, m_Height);
+		setup.maxY = std::clamp(static_cast<int>(std::floor(std::max({ position0.y, position1.y, position2.y }) - 0.5f)) + 1, 0, m_Height);
+
+		if (setup.minX >= setup.maxX || setup.minY >= setup.maxY) return false;
+
+		// Edge functions, normalized to barycentric weights
+		const Vector2 edge0 = (position1 - position0).GetXY();
+		const Vector2 edge1 = (position2 - position1).GetXY();
+		const Vector2 edge2 = (position0 - position2).GetXY();
+
+		// Front faces are clockwise on screen (y points down) like in DirectX, back faces and triangles without area are culled.
+		// The area also has to survive the division for the span setup.
+		const float totalWeight{ Vector2::Cross(edge0, -edge2) };
+		if (!(totalWeight > 0.0f)) return false;
+		const float invTotalWeight = 1.0f / totalWeight;
+		if (!std::isfinite(invTotalWeight)) return false;
+
+		const Vector2 origin{ setup.minX + 0.5f, setup.minY + 0.5f };
+		setup.originWeights[0] = Vector2::Cross(edge1, origin - position1.GetXY()) * invTotalWeight;
+		setup.originWeights[1] = Vector2::Cross(edge2, origin - position2.GetXY()) * invTotalWeight;
+		setup.originWeights[2] = Vector2::Cross(edge0, origin - position0.GetXY()) * invTotalWeight;
+
+		setup.weightStepX[0] = -edge1.y * invTotalWeight;
+		setup.weightStepX[1] = -edge2.y * invTotalWeight;
+		setup.weightStepX[2] = -edge0.y * invTotalWeight;
+		setup.weightStepY[0] = edge1.x * invTotalWeight;
+		setup.weightStepY[1] = edge2.x * invTotalWeight;
+		setup.weightStepY[2] = edge0.x * invTotalWeight;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			// Unused for edges parallel to the rows (no step in x)
+			const float invStepX{ setup.weightStepX[i] != 0.0f ? 1.0f / setup.weightStepX[i] : 0.0f };
+			setup.crossingX[i] = setup.minX - setup.originWeights[i] * invStepX;
+			setup.crossingStepX[i] = -setup.weightStepY[i] * invStepX;
+		}
+
+		setup.depths[0] = position0.z;
+		setup.depths[1] = position1.z;
+		setup.depths[2] = position2.z;
+		setup.invW[0] = 1.0f / position0.w;
+		setup.invW[1] = 1.0f / position1.w;
+		setup.invW[2] = 1.0f / position2.w;
+
+		setup.minDepth = std::min({ position0.z, position1.z, position2.z });
+		setup.maxDepth = std::max({ position0.z, position1.z, position2.z });
+
+		return true;
+	}
 
-		for (size_t i = 0; i < mesh.indices.size(); i += 3)
+	int Renderer::ClipPolygon(ClipVertex* pPolygon, ClipVertex* pScratch, int vertexCount, uint32_t clipOutcodes, float guardBandX, float guardBandY) const
+	{
+		for (uint32_t plane = NEAR_PLANE; plane <= GUARD_BAND_TOP && vertexCount > 0; plane <<= 1)
 		{
-			const Vertex_Out& v0 = mesh.vertices_out[mesh.indices[i]];
-			const Vertex_Out& v1 = mesh.vertices_out[mesh.indices[i + 1]];
-			const Vertex_Out& v2 = mesh.vertices_out[mesh.indices[i + 2]];
+			if (!(clipOutcodes & plane)) continue;
+
+			// Every edge keeps its start vertex when inside, and adds the intersection when it crosses the plane
+			int clippedCount{};
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				const ClipVertex& start = pPolygon[i];
+				const ClipVertex& end = pPolygon[(i + 1) % vertexCount];
+				const float startDistance{ GetClipDistance(start.position, plane, guardBandX, guardBandY) };
+				const float endDistance{ GetClipDistance(end.position, plane, guardBandX, guardBandY) };
+
+				if (startDistance >= 0.0f) pScratch[clippedCount++] = start;
+				if ((startDistance >= 0.0f) == (endDistance >= 0.0f)) continue;
+
+				// Attributes are linear in clip space
+				const float t{ startDistance / (startDistance - endDistance) };
+				ClipVertex& intersection = pScratch[clippedCount++];
+				intersection.position = start.position + (end.position - start.position) * t;
+				intersection.vertex.color = start.vertex.color + (end.vertex.color - start.vertex.color) * t;
+				intersection.vertex.uv = start.vertex.uv + (end.vertex.uv - start.vertex.uv) * t;
+				intersection.vertex.normal = start.vertex.normal + (end.vertex.normal - start.vertex.normal) * t;
+				intersection.vertex.tangent = start.vertex.tangent + (end.vertex.tangent - start.vertex.tangent) * t;
+				intersection.vertex.viewDirection = start.vertex.viewDirection + (end.vertex.viewDirection - start.vertex.viewDirection) * t;
+
+				// Exactly on the near plane, rounding must not push the depth below 0
+				if (plane == NEAR_PLANE) intersection.position.z = 0.0f;
+			}
 
-			RasterizeTriangle(v0, v1, v2);
+			std::copy(pScratch, pScratch + clippedCount, pPolygon);
+			vertexCount = clippedCount;
 		}
+
+		return vertexCount;
 	}
 
-	void Renderer::RasterizeTriangle(const Vertex_Out& vertex0, const Vertex_Out& vertex1, const Vertex_Out& vertex2)
+	void Renderer::RasterizeTiles(const Mesh& mesh)
 	{
-		if (vertex0.position.w < 0.0f || vertex1.position.w < 0.0f || vertex2.position.w < 0.0f) return;
+		const int tileCount{ m_TilesX * m_TilesY };
+		const size_t chunkCount{ m_BinChunkCount };
+
+		const uint32_t clearColor{ SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100) };
+
+		// A pixel belongs to exactly one tile, tiles never touch each other's depth or color
+		const auto rasterizeTile = [&](int tile)
+		{
+			const int tileMinX{ (tile % m_TilesX) * TILE_SIZE };
+			const int tileMinY{ (tile / m_TilesX) * TILE_SIZE };
+			const int tileMaxX{ std::min(tileMinX + TILE_SIZE, m_Width) };
+			const int tileMaxY{ std::min(tileMinY + TILE_SIZE, m_Height) };
+
+			// Clearing here instead of over the whole frame up front, the tile is still in cache when its triangles write to it.
+			// The color isn't cleared, ShadeTile writes every pixel.
+			for (int py = tileMinY; py < tileMaxY; ++py)
+			{
+				std::fill(m_pDepthBufferPixels + tileMinX + py * m_Width, m_pDepthBufferPixels + tileMaxX + py * m_Width, FLT_MAX);
+				std::fill(m_TriangleIndexBuffer.begin() + tileMinX + py * m_Width, m_TriangleIndexBuffer.begin() + tileMaxX + py * m_Width, NO_TRIANGLE);
+			}
+			for (int blockY = tileMinY / BLOCK_SIZE; blockY * BLOCK_SIZE < tileMaxY; ++blockY)
+			{
+				const int firstBlock{ tileMinX / BLOCK_SIZE + blockY * m_HiZBlocksX };
+				const int lastBlock{ (tileMaxX + BLOCK_SIZE - 1) / BLOCK_SIZE + blockY * m_HiZBlocksX };
+				std::fill(m_HiZMinDepths.begin() + firstBlock, m_HiZMinDepths.begin() + lastBlock, FLT_MAX);
+				std::fill(m_HiZMaxDepths.begin() + firstBlock, m_HiZMaxDepths.begin() + lastBlock, FLT_MAX);
+				std::fill(m_IsHiZMaxStale.begin() + firstBlock, m_IsHiZMaxStale.begin() + lastBlock, uint8_t{ 0 });
+			}
 
-		// Find triangle bounding box
-		int minBoxX = static_cast<int>(std::floor(std::min({ vertex0.position.x, vertex1.position.x, vertex2.position.x })));
-		int maxBoxX = static_cast<int>(std::ceil(std::max({ vertex0.position.x, vertex1.position.x, vertex2.position.x })));
-		int minBoxY = static_cast<int>(std::floor(std::min({ vertex0.position.y, vertex1.position.y, vertex2.position.y })));
-		int maxBoxY = static_cast<int>(std::ceil(std::max({ vertex0.position.y, vertex1.position.y, vertex2.position.y })));
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				for (uint32_t triangleIndex : m_TileBins[chunk * tileCount + tile])
+				{
+					if (triangleIndex & CLIPPED_TRIANGLE) triangleIndex = m_ClippedChunks[chunk].firstTriangle + (triangleIndex & ~CLIPPED_TRIANGLE);
+					RasterizeTriangle(triangleIndex, m_Triangles[triangleIndex], tileMinX, tileMinY, tileMaxX, tileMaxY);
+				}
+			}
 
-		// Clamping to the screen size
-		minBoxX = std::clamp(minBoxX, 0, m_Width);
-		maxBoxX = std::clamp(maxBoxX, 0, m_Width);
-		minBoxY = std::clamp(minBoxY, 0, m_Height);
-		maxBoxY = std::clamp(maxBoxY, 0, m_Height);
+			// Depth is final, only the visible triangle of every pixel is shaded
+			ShadeTile(mesh, tileMinX, tileMinY, tileMaxX, tileMaxY, clearColor);
+		};
 
-		// Calculate triangle edges
-		const Vector2 edge0 = (vertex1.position - vertex0.position).GetXY();
-		const Vector2 edge1 = (vertex2.position - vertex1.position).GetXY();
-		const Vector2 edge2 = (vertex0.position - vertex2.position).GetXY();
+#ifdef PARALLEL_EXECUTION
+		auto tiles = std::views::iota(0, tileCount);
+		std::for_each(std::execution::par, tiles.begin(), tiles.end(), rasterizeTile);
+#else
+		for (int tile = 0; tile < tileCount; ++tile)
+		{
+			rasterizeTile(tile);
+		}
+#endif
+	}
 
-		const float invTotalWeight = 1.0f / Vector2::Cross(edge0, -edge2);
+	float Renderer::GetHiZMaxDepth(int blockIndex)
+	{
+		if (m_IsHiZMaxStale[blockIndex])
+		{
+			const int blockMinX{ (blockIndex % m_HiZBlocksX) * BLOCK_SIZE };
+			const int blockMinY{ (blockIndex / m_HiZBlocksX) * BLOCK_SIZE };
+			const int blockMaxX{ std::min(blockMinX + BLOCK_SIZE, m_Width) };
+			const int blockMaxY{ std::min(blockMinY + BLOCK_SIZE, m_Height) };
 
-		// Loop variables
-		int pixelIndex = -1;
-		Vector2 pixel, point0, point1, point2;
-		float weight0, weight1, weight2;
-		float depthZ, depthW;
+			float maxDepth{ 0.0f };
+			for (int py = blockMinY; py < blockMaxY; ++py)
+			{
+				const float* pRow = m_pDepthBufferPixels + py * m_Width;
+				maxDepth = std::max(maxDepth, *std::max_element(pRow + blockMinX, pRow + blockMaxX));
+			}
 
-		Vertex_Out pixelVertex;
+			m_HiZMaxDepths[blockIndex] = maxDepth;
+			m_IsHiZMaxStale[blockIndex] = 0;
+		}
+
+		return m_HiZMaxDepths[blockIndex];
+	}
+
+	void Renderer::RasterizeTriangle(uint32_t triangleIndex, const TriangleSetup& setup, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+	{
+		// Bounding box of the triangle within the tile
+		const int minBoxX = std::max(setup.minX, tileMinX);
+		const int maxBoxX = std::min(setup.maxX, tileMaxX);
+		const int minBoxY = std::max(setup.minY, tileMinY);
+		const int maxBoxY = std::min(setup.maxY, tileMaxY);
+
+		// Whole triangle behind everything drawn in the blocks of its box
+		bool isOccluded{ true };
+		for (int blockY = minBoxY / BLOCK_SIZE; blockY <= (maxBoxY - 1) / BLOCK_SIZE && isOccluded; ++blockY)
+		{
+			for (int blockX = minBoxX / BLOCK_SIZE; blockX <= (maxBoxX - 1) / BLOCK_SIZE; ++blockX)
+			{
+				if (!(setup.minDepth > GetHiZMaxDepth(blockX + blockY * m_HiZBlocksX)))
+				{
+					isOccluded = false;
+					break;
+				}
+			}
+		}
+		if (isOccluded) return;
+
+#ifdef __AVX2__
+		const __m256 laneOffsets = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+		const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		__m256 laneSteps[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			laneSteps[i] = _mm256_mul_ps(_mm256_set1_ps(setup.weightStepX[i]), laneOffsets);
+		}
+#endif
+
+		const bool isSingleSegment{ minBoxX / BLOCK_SIZE == (maxBoxX - 1) / BLOCK_SIZE };
 
-		for (int px = minBoxX; px < maxBoxX; ++px)
+		// Scanlines top to bottom, every row only visits the segments of its covered span, left to right
+		for (int py = minBoxY; py < maxBoxY; ++py)
 		{
-			for (int py = minBoxY; py < maxBoxY; ++py)
+			const float rowStepY{ static_cast<float>(py - setup.minY) };
+
+			float rowWeights[3];
+			for (int i = 0; i < 3; ++i)
 			{
-				pixel.x = px + 0.5f;
-				pixel.y = py + 0.5f;
+				rowWeights[i] = setup.originWeights[i] + setup.weightStepY[i] * rowStepY;
+			}
+
+			// Span of the row: weight i is linear in x, it is positive on one side of where it crosses zero.
+			// The span is widened by a pixel for rounding, only the pixels at least a pixel inside skip the coverage test.
+			// Boxes within one segment only have the coverage test to gain, they skip the span setup.
+			float spanMin{ static_cast<float>(minBoxX) }, spanMax{ static_cast<float>(maxBoxX) };
+			float innerMin{ isSingleSegment ? spanMax : spanMin }, innerMax{ isSingleSegment ? spanMin : spanMax };
+			bool isRowEmpty{ false };
+			for (int i = 0; i < 3 && !isSingleSegment; ++i)
+			{
+				const float stepX{ setup.weightStepX[i] };
+				if (stepX == 0.0f)
+				{
+					isRowEmpty |= !(rowWeights[i] >= 0.0f);
+					continue;
+				}
+
+				const float edgeX{ setup.crossingX[i] + setup.crossingStepX[i] * rowStepY };
+				if (stepX > 0.0f)
+				{
+					spanMin = std::max(spanMin, edgeX - 1.0f);
+					innerMin = std::max(innerMin, edgeX + 1.0f);
+				}
+				else
+				{
+					spanMax = std::min(spanMax, edgeX + 2.0f);
+					innerMax = std::min(innerMax, edgeX - 1.0f);
+				}
+			}
+			if (isRowEmpty || !(spanMin < spanMax)) continue;
+
+			const int firstPixel{ static_cast<int>(std::ceil(spanMin)) };
+			const int lastPixel{ static_cast<int>(std::ceil(spanMax)) }; // exclusive
+			const int firstInnerPixel{ static_cast<int>(std::ceil(std::min(innerMin, spanMax))) };
+			const int lastInnerPixel{ static_cast<int>(std::ceil(std::max(innerMax, spanMin))) };
+
+			for (int blockX = firstPixel - firstPixel % BLOCK_SIZE; blockX < lastPixel; blockX += BLOCK_SIZE)
+			{
+				const int rowIndex{ blockX + py * m_Width };
+				const float blockStepX{ static_cast<float>(blockX - setup.minX) };
+
+				// Lanes of the segment inside the span
+				uint32_t spanMask{ 0xFF };
+				if (blockX < firstPixel) spanMask &= 0xFFu << (firstPixel - blockX);
+				if (blockX + BLOCK_SIZE > lastPixel) spanMask &= 0xFFu >> (blockX + BLOCK_SIZE - lastPixel);
+
+				const bool isFullyCovered{ blockX >= firstInnerPixel && blockX + BLOCK_SIZE <= lastInnerPixel };
+
+				// Segment behind the whole block, or in front of it (every depth test passes)
+				const int hiZBlockIndex{ blockX / BLOCK_SIZE + (py / BLOCK_SIZE) * m_HiZBlocksX };
+				if (setup.minDepth > GetHiZMaxDepth(hiZBlockIndex)) continue;
+				const bool isInFront{ setup.maxDepth < m_HiZMinDepths[hiZBlockIndex] && setup.minDepth >= 0.0f && setup.maxDepth <= 1.0f };
 
-				// Calculate vertex to pixel vectors
-				point0 = pixel - vertex0.position.GetXY();
-				point1 = pixel - vertex1.position.GetXY();
-				point2 = pixel - vertex2.position.GetXY();
+#ifdef __AVX2__
+				__m256 weights[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					const float blockWeight{ rowWeights[i] + setup.weightStepX[i] * blockStepX };
+					weights[i] = _mm256_add_ps(_mm256_set1_ps(blockWeight), laneSteps[i]);
+				}
+
+				const __m256 zero = _mm256_setzero_ps();
+				uint32_t mask{ spanMask };
+				if (!isFullyCovered)
+				{
+					const __m256 inside = _mm256_and_ps(_mm256_and_ps(
+						_mm256_cmp_ps(weights[0], zero, _CMP_GE_OQ),
+						_mm256_cmp_ps(weights[1], zero, _CMP_GE_OQ)),
+						_mm256_cmp_ps(weights[2], zero, _CMP_GE_OQ));
+					mask &= static_cast<uint32_t>(_mm256_movemask_ps(inside));
+				}
+				if (mask == 0) continue;
 
-				// Barycentric cooridnates
-				weight0 = Vector2::Cross(edge1, point1) * invTotalWeight;
-				weight1 = Vector2::Cross(edge2, point2) * invTotalWeight;
-				weight2 = Vector2::Cross(edge0, point0) * invTotalWeight;
+				// Interpolate depth Z value using weights, z / w is linear in screen space
+				const __m256 depthZ = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(weights[0], _mm256_set1_ps(setup.depths[0])),
+					_mm256_mul_ps(weights[1], _mm256_set1_ps(setup.depths[1]))),
+					_mm256_mul_ps(weights[2], _mm256_set1_ps(setup.depths[2])));
 
-				// Check sign equality
-				if (weight0 < 0.0f || weight1 < 0.0f || weight2 < 0.0f) continue;
+				// Frustum culling and depth test, only the lanes inside the span touch the depth buffer
+				if (!isInFront)
+				{
+					const __m256i spanLanes = _mm256_cmpgt_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(spanMask)), laneBits), _mm256_setzero_si256());
+					const __m256 storedDepth = _mm256_maskload_ps(m_pDepthBufferPixels + rowIndex, spanLanes);
+					const __m256 passed = _mm256_and_ps(_mm256_and_ps(
+						_mm256_cmp_ps(depthZ, zero, _CMP_GE_OQ),
+						_mm256_cmp_ps(depthZ, _mm256_set1_ps(1.0f), _CMP_LE_OQ)),
+						_mm256_cmp_ps(depthZ, storedDepth, _CMP_LE_OQ));
+					mask &= static_cast<uint32_t>(_mm256_movemask_ps(passed));
+					if (mask == 0) continue;
+				}
 
-				// Interpolate depth Z value using weights
-				depthZ = 1.0f / (weight0 / vertex0.position.z + weight1 / vertex1.position.z + weight2 / vertex2.position.z);
+				const __m256i passedLanes = _mm256_cmpgt_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)), laneBits), _mm256_setzero_si256());
+				_mm256_maskstore_ps(m_pDepthBufferPixels + rowIndex, passedLanes, depthZ);
 
-				// Frustum culling
-				if (depthZ < 0.0f || depthZ > 1.0f) continue;
+				_mm256_maskstore_epi32(reinterpret_cast<int*>(m_TriangleIndexBuffer.data() + rowIndex), passedLanes, _mm256_set1_epi32(static_cast<int>(triangleIndex)));
 
-				// Calculate pixel index
-				pixelIndex = px + py * m_Width;
-				assert(pixelIndex < m_Width * m_Height && "buffer index out of bounds");
+				// Lowest written depth for the block min, the other lanes count as FLT_MAX
+				__m256 writtenDepth = _mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), depthZ, _mm256_castsi256_ps(passedLanes));
+				writtenDepth = _mm256_min_ps(writtenDepth, _mm256_permute2f128_ps(writtenDepth, writtenDepth, 1));
+				writtenDepth = _mm256_min_ps(writtenDepth, _mm256_shuffle_ps(writtenDepth, writtenDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+				writtenDepth = _mm256_min_ps(writtenDepth, _mm256_shuffle_ps(writtenDepth, writtenDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+				m_HiZMinDepths[hiZBlockIndex] = std::min(m_HiZMinDepths[hiZBlockIndex], _mm256_cvtss_f32(writtenDepth));
+				m_IsHiZMaxStale[hiZBlockIndex] = 1;
+#else
+				for (int lane = 0; lane < BLOCK_SIZE; ++lane)
+				{
+					if (!(spanMask & (1u << lane))) continue;
+
+					const float laneStepX{ blockStepX + lane };
+					const float weight0{ rowWeights[0] + setup.weightStepX[0] * laneStepX };
+					const float weight1{ rowWeights[1] + setup.weightStepX[1] * laneStepX };
+					const float weight2{ rowWeights[2] + setup.weightStepX[2] * laneStepX };
+
+					// Check sign equality, written as the negated tests so NaN weights fail like in the AVX2 path
+					if (!isFullyCovered && !(weight0 >= 0.0f && weight1 >= 0.0f && weight2 >= 0.0f)) continue;
+
+					// Interpolate depth Z value using weights
+					const float depthZ{ weight0 * setup.depths[0] + weight1 * setup.depths[1] + weight2 * setup.depths[2] };
+
+					// Frustum culling and depth test
+					if (!isInFront)
+					{
+						if (!(depthZ >= 0.0f && depthZ <= 1.0f)) continue;
+						if (!(depthZ <= m_pDepthBufferPixels[rowIndex + lane])) continue;
+					}
+
+					m_pDepthBufferPixels[rowIndex + lane] = depthZ;
+					m_TriangleIndexBuffer[rowIndex + lane] = triangleIndex;
+					m_HiZMinDepths[hiZBlockIndex] = std::min(m_HiZMinDepths[hiZBlockIndex], depthZ);
+					m_IsHiZMaxStale[hiZBlockIndex] = 1;
+				}
+#endif
+			}
+		}
+	}
+
+	void Renderer::ShadeTile(const Mesh& mesh, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, uint32_t clearColor)
+	{
+		Vertex_Out pixelVertex;
+
+		const auto getVertex = [&](uint32_t vertexIndex) -> const Vertex_Out&
+		{
+			return vertexIndex < mesh.vertices_out.size() ? mesh.vertices_out[vertexIndex] : m_ClippedVertices[vertexIndex - mesh.vertices_out.size()];
+		};
+
+		for (int py = tileMinY; py < tileMaxY; ++py)
+		{
+			for (int px = tileMinX; px < tileMaxX; ++px)
+			{
+				const int pixelIndex{ px + py * m_Width };
+
+				const uint32_t triangleIndex{ m_TriangleIndexBuffer[pixelIndex] };
+				if (triangleIndex == NO_TRIANGLE)
+				{
+					m_pBackBufferPixels[pixelIndex] = clearColor;
+					continue;
+				}
 
-				// Depth test
-				if (depthZ > m_pDepthBufferPixels[pixelIndex]) continue;
+				const TriangleSetup& setup = m_Triangles[triangleIndex];
+				const Vertex_Out& vertex0 = getVertex(setup.vertexIndices[0]);
+				const Vertex_Out& vertex1 = getVertex(setup.vertexIndices[1]);
+				const Vertex_Out& vertex2 = getVertex(setup.vertexIndices[2]);
 
-				m_pDepthBufferPixels[pixelIndex] = depthZ;
+				// Same edge function steps as the rasterizer, the depth test already passed so the stored depth is this triangle's
+				const float rowStepY{ static_cast<float>(py - setup.minY) };
+				const float pixelStepX{ static_cast<float>(px - setup.minX) };
+				const float weight0{ setup.originWeights[0] + setup.weightStepY[0] * rowStepY + setup.weightStepX[0] * pixelStepX };
+				const float weight1{ setup.originWeights[1] + setup.weightStepY[1] * rowStepY + setup.weightStepX[1] * pixelStepX };
+				const float weight2{ setup.originWeights[2] + setup.weightStepY[2] * rowStepY + setup.weightStepX[2] * pixelStepX };
+				const float depthZ{ m_pDepthBufferPixels[pixelIndex] };
 
 				// Interpolate depth W value using weights
-				depthW = 1.0f / (weight0 / vertex0.position.w + weight1 / vertex1.position.w + weight2 / vertex2.position.w);
+				const float depthW{ 1.0f / (weight0 * setup.invW[0] + weight1 * setup.invW[1] + weight2 * setup.invW[2]) };
 
 				pixelVertex.position = { static_cast<float>(px), static_cast<float>(py), depthZ, depthW };
 				pixelVertex.color = vertex0.color * weight0 + vertex1.color * weight1 + vertex2.color * weight2;
 				pixelVertex.normal = ((vertex0.normal * weight0 + vertex1.normal * weight1 + vertex2.normal * weight2) / 3).Normalized();
 				pixelVertex.tangent = (vertex0.tangent * weight0 + vertex1.tangent * weight1 + vertex2.tangent * weight2).Normalized();
 				pixelVertex.viewDirection = (vertex0.viewDirection * weight0 + vertex1.viewDirection * weight1 + vertex2.viewDirection * weight2).Normalized();
-				pixelVertex.uv = (vertex0.uv / vertex0.position.w * weight0 + vertex1.uv / vertex1.position.w * weight1 + vertex2.uv / vertex2.position.w * weight2) * depthW;
+				pixelVertex.uv = (vertex0.uv * (setup.invW[0] * weight0) + vertex1.uv * (setup.invW[1] * weight1) + vertex2.uv * (setup.invW[2] * weight2)) * depthW;
 
 				ShadePixel(pixelIndex, pixelVertex, depthZ);
 			}
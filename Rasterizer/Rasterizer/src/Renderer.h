@@ -39,7 +39,8 @@ namespace dae
 		void ToggleNormalMapping();
 		void CycleLightning();
 
-		void VertexTransformationFunction(Mesh& mesh) const;
+		// Fills mesh.vertices_out (screen space) and the clip space positions of the vertices, from the SoA streams of the mesh
+		void VertexTransformationFunction(Mesh& mesh);
 
 	private:
 		enum class LightingMode
@@ -60,6 +61,10 @@ namespace dae
 		uint32_t* m_pBackBufferPixels{};
 
 		float* m_pDepthBufferPixels{};
+		// Visibility buffer: index into m_Triangles of the closest triangle per pixel, NO_TRIANGLE for the background.
+		// Rasterization only writes depth and this index, every visible pixel is shaded once afterwards.
+		std::vector<uint32_t> m_TriangleIndexBuffer{};
+		static constexpr uint32_t NO_TRIANGLE{ UINT32_MAX };
 
 		Camera m_Camera{};
 
@@ -82,13 +87,86 @@ namespace dae
 		bool m_DebugDepthBuffer{};
 		bool m_NormalMapping{ true };
 
+		// Screen space bounding box and edge functions of a triangle, set up once and rasterized by every tile it overlaps
+		struct TriangleSetup
+		{
+			uint32_t vertexIndices[3]{}; // into Mesh::vertices_out, followed by m_ClippedVertices
+			int minX{}, minY{}, maxX{}, maxY{}; // pixel centers inside the triangle's bounds, clamped to the screen, max exclusive
+
+			// Barycentric weight i at pixel (x, y) = originWeights[i] + weightStepX[i] * (x - minX) + weightStepY[i] * (y - minY),
+			// the edge functions are stepped from the first pixel center instead of evaluated from scratch per pixel
+			float originWeights[3]{};
+			float weightStepX[3]{};
+			float weightStepY[3]{};
+
+			// Where weight i crosses zero on the first row and how far that moves per row, gives the span of every row
+			float crossingX[3]{};
+			float crossingStepX[3]{};
+
+			float depths[3]{}; // z / w of the vertices, linear in screen space
+			float invW[3]{}; // 1 / w of the vertices, for perspective correct interpolation
+
+			// Depth range of the triangle, the interpolated depth never leaves it
+			float minDepth{};
+			float maxDepth{};
+		};
+
+		// Clip space position and attributes of a vertex, the vertices of the clipped polygons are interpolated between them
+		struct ClipVertex
+		{
+			Vector4 position{};
+			Vertex_Out vertex{};
+		};
+
+		// Triangles a chunk split up by clipping, appended to m_Triangles in chunk order once all chunks are binned.
+		// The bins of the chunk refer to them as CLIPPED_TRIANGLE | index in triangles.
+		struct ClippedChunk
+		{
+			std::vector<TriangleSetup> triangles{}; // vertexIndices into vertices until appended
+			std::vector<Vertex_Out> vertices{};
+			uint32_t firstTriangle{}; // in m_Triangles
+		};
+		static constexpr uint32_t CLIPPED_TRIANGLE{ 0x80000000u };
+
+		std::vector<Vector4> m_ClipPositions{}; // per vertex of the mesh
+		std::vector<TriangleSetup> m_Triangles{}; // one per mesh triangle, followed by the clipped ones
+		std::vector<ClippedChunk> m_ClippedChunks{};
+		std::vector<Vertex_Out> m_ClippedVertices{};
+
+		// Triangles are binned per chunk of consecutive triangles: m_TileBins[chunk * tileCount + tile].
+		// A tile walks the chunks in order, so it draws its triangles in submission order without any locks.
+		std::vector<std::vector<uint32_t>> m_TileBins{};
+		size_t m_BinChunkCount{};
+		int m_TilesX{};
+		int m_TilesY{};
+
+		// Hierarchical depth: min and max of every 8x8 block of the depth buffer. Writes only lower depths, so the
+		// min follows every write and the max is only marked stale, it is recalculated when a triangle needs it.
+		std::vector<float> m_HiZMinDepths{};
+		std::vector<float> m_HiZMaxDepths{};
+		std::vector<uint8_t> m_IsHiZMaxStale{};
+		int m_HiZBlocksX{};
+
 	private:
 
 		void RenderMesh();
-
-		void RasterizeTriangleStrip(const Mesh& mesh);
-		void RasterizeTriangleList(const Mesh& mesh);
-		void RasterizeTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2);
+		// False when the bounding box of the mesh lies completely outside the frustum
+		bool IsMeshInFrustum(const Mesh& mesh) const;
+
+		// Sets up the triangles of the mesh (list or strip) in parallel and bins them into screen tiles.
+		// Triangles crossing the near plane or the guard band are clipped first.
+		void BinTriangles(const Mesh& mesh);
+		// Returns false for triangles that face away, have no area or cover no pixel centers, positions in screen space
+		bool SetupTriangle(TriangleSetup& setup, const Vector4& position0, const Vector4& position1, const Vector4& position2) const;
+		// Sutherland-Hodgman in clip space against the planes of clipOutcodes, returns the vertex count of the polygon
+		int ClipPolygon(ClipVertex* pPolygon, ClipVertex* pScratch, int vertexCount, uint32_t clipOutcodes, float guardBandX, float guardBandY) const;
+		// Every tile rasterizes its own bins into the visibility buffer and then shades its pixels, tiles run in parallel
+		void RasterizeTiles(const Mesh& mesh);
+		float GetHiZMaxDepth(int blockIndex);
+		// Only the pixels in [tileMinX, tileMaxX) x [tileMinY, tileMaxY) are rasterized, writes depth and triangleIndex
+		void RasterizeTriangle(uint32_t triangleIndex, const TriangleSetup& setup, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+		// Reconstructs the weights of the visible triangle per pixel from its setup and shades it, background pixels get clearColor
+		void ShadeTile(const Mesh& mesh, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, uint32_t clearColor);
 
 		void PerspectiveDivide(Vertex_Out& vertex) const;
 		void TransformToScreenSpace(Vertex_Out& vertex) const;
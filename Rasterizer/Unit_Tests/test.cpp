@@ -1,5 +1,11 @@
 #include "gtest/gtest.h"
 #include "Maths.h"
+#include "Utils.h"
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <random>
 
 
 namespace dae
@@ -9,4 +15,219 @@ namespace dae
 		EXPECT_TRUE(true);
 	}
 
+	namespace
+	{
+		// Writes contents to an OBJ file in the temp directory, returns its path
+		std::string WriteOBJ(const std::string& name, const std::string& contents)
+		{
+			const std::filesystem::path path{ std::filesystem::temp_directory_path() / name };
+			std::ofstream file(path, std::ios::binary);
+			file << contents;
+			return path.string();
+		}
+
+		// cellCount x cellCount quads in the xy plane, two triangles each, every corner shares its texcoord and normal index with its position
+		std::string GridOBJ(int cellCount)
+		{
+			std::string obj{ "# grid\nvn 0 0 1\n" };
+			for (int y{}; y <= cellCount; ++y)
+			{
+				for (int x{}; x <= cellCount; ++x)
+				{
+					obj += "v " + std::to_string(x) + " " + std::to_string(y) + " 0\n";
+					obj += "vt " + std::to_string(x) + " " + std::to_string(y) + "\n";
+				}
+			}
+
+			const auto corner = [&](int x, int y)
+			{
+				const std::string index{ std::to_string(1 + x + y * (cellCount + 1)) };
+				return index + "/" + index + "/1";
+			};
+
+			for (int y{}; y < cellCount; ++y)
+			{
+				for (int x{}; x < cellCount; ++x)
+				{
+					obj += "f " + corner(x, y) + " " + corner(x + 1, y) + " " + corner(x + 1, y + 1) + "\n";
+					obj += "f " + corner(x, y) + " " + corner(x + 1, y + 1) + " " + corner(x, y + 1) + "\n";
+				}
+			}
+			return obj;
+		}
+
+		// cellCount x cellCount quads in the xy plane, triangles in row order or shuffled
+		void BuildGrid(int cellCount, bool isShuffled, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			vertices.clear();
+			for (int y{}; y <= cellCount; ++y)
+			{
+				for (int x{}; x <= cellCount; ++x)
+				{
+					Vertex vertex{};
+					vertex.position = Vector3(static_cast<float>(x), static_cast<float>(y), 0.f);
+					vertex.uv = Vector2(static_cast<float>(x) / cellCount, static_cast<float>(y) / cellCount);
+					vertices.push_back(vertex);
+				}
+			}
+
+			std::vector<std::array<uint32_t, 3>> triangles{};
+			for (int y{}; y < cellCount; ++y)
+			{
+				for (int x{}; x < cellCount; ++x)
+				{
+					const uint32_t corner{ static_cast<uint32_t>(x + y * (cellCount + 1)) };
+					const uint32_t rowAbove{ static_cast<uint32_t>(cellCount + 1) };
+					triangles.push_back({ corner, corner + 1, corner + rowAbove + 1 });
+					triangles.push_back({ corner, corner + rowAbove + 1, corner + rowAbove });
+				}
+			}
+			if (isShuffled) std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ 42 });
+
+			indices.clear();
+			for (const std::array<uint32_t, 3>& triangle : triangles)
+			{
+				indices.insert(indices.end(), triangle.begin(), triangle.end());
+			}
+		}
+
+		// The triangles as corner positions, each rotated to start at its smallest corner (keeps the winding), sorted
+		std::vector<std::array<std::array<float, 3>, 3>> CanonicalTriangles(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			std::vector<std::array<std::array<float, 3>, 3>> triangles{};
+			for (size_t i{}; i + 2 < indices.size(); i += 3)
+			{
+				std::array<std::array<float, 3>, 3> triangle{};
+				for (size_t c{}; c < 3; ++c)
+				{
+					const Vector3& position = vertices[indices[i + c]].position;
+					triangle[c] = { position.x, position.y, position.z };
+				}
+				std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+				triangles.push_back(triangle);
+			}
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		}
+	}
+
+	TEST(ParseOBJ, WeldsSharedGridCorners) {
+		constexpr int cellCount{ 8 };
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(WriteOBJ("parseobj_grid.obj", GridOBJ(cellCount)), vertices, indices, false));
+
+		EXPECT_EQ(vertices.size(), static_cast<size_t>((cellCount + 1) * (cellCount + 1)));
+		ASSERT_EQ(indices.size(), static_cast<size_t>(cellCount * cellCount * 6));
+
+		// Welding must not move any corner: the first triangle of every quad still starts at its own grid point
+		for (int y{}; y < cellCount; ++y)
+		{
+			for (int x{}; x < cellCount; ++x)
+			{
+				const size_t first{ static_cast<size_t>(x + y * cellCount) * 6 };
+				EXPECT_EQ(vertices[indices[first]].position, Vector3(static_cast<float>(x), static_cast<float>(y), 0.f));
+				EXPECT_EQ(vertices[indices[first + 1]].position, Vector3(static_cast<float>(x + 1), static_cast<float>(y), 0.f));
+				EXPECT_EQ(vertices[indices[first + 2]].position, Vector3(static_cast<float>(x + 1), static_cast<float>(y + 1), 0.f));
+			}
+		}
+	}
+
+	TEST(ParseOBJ, KeepsCornersWithDifferentAttributesApart) {
+		// Both triangles share positions 1 and 3, the second one with other texcoords (a UV seam)
+		const std::string obj{
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+			"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvt .5 .5\n"
+			"f 1/1 2/2 3/3\n"
+			"f 1/5 3/5 4/4\n" };
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(WriteOBJ("parseobj_seam.obj", obj), vertices, indices, false));
+
+		EXPECT_EQ(vertices.size(), 6u);
+		EXPECT_EQ(indices.size(), 6u);
+	}
+
+	TEST(ParseOBJ, DoesNotDuplicateLastFace) {
+		const std::string faces{ "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3\nf 1 3 4" };
+
+		for (const std::string& obj : { faces, faces + "\n", faces + "\n\n" })
+		{
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			ASSERT_TRUE(Utils::ParseOBJ(WriteOBJ("parseobj_last_face.obj", obj), vertices, indices, false));
+
+			EXPECT_EQ(indices.size(), 6u);
+			EXPECT_EQ(vertices.size(), 4u);
+		}
+	}
+
+	TEST(ParseOBJ, FlipsWinding) {
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(WriteOBJ("parseobj_flip.obj", "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n"), vertices, indices));
+
+		ASSERT_EQ(indices.size(), 3u);
+		EXPECT_EQ(vertices[indices[0]].position, Vector3(0.f, 0.f, 0.f));
+		EXPECT_EQ(vertices[indices[1]].position, Vector3(1.f, 1.f, 0.f));
+		EXPECT_EQ(vertices[indices[2]].position, Vector3(1.f, 0.f, 0.f));
+	}
+
+	TEST(ParseOBJ, FailsOnMissingFile) {
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		EXPECT_FALSE(Utils::ParseOBJ((std::filesystem::temp_directory_path() / "parseobj_missing.obj").string(), vertices, indices));
+	}
+
+	TEST(OptimizeMesh, KeepsTrianglesAndWinding) {
+		for (bool isShuffled : { false, true })
+		{
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			BuildGrid(16, isShuffled, vertices, indices);
+			const auto trianglesBefore{ CanonicalTriangles(vertices, indices) };
+
+			Utils::OptimizeMesh(vertices, indices);
+
+			EXPECT_EQ(vertices.size(), static_cast<size_t>(17 * 17));
+			EXPECT_EQ(CanonicalTriangles(vertices, indices), trianglesBefore);
+		}
+	}
+
+	TEST(OptimizeMesh, DoesNotIncreaseACMR) {
+		for (bool isShuffled : { false, true })
+		{
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			BuildGrid(32, isShuffled, vertices, indices);
+			const Utils::VertexCacheStatistics before{ Utils::AnalyzeVertexCache(indices, vertices.size()) };
+
+			Utils::OptimizeMesh(vertices, indices);
+
+			const Utils::VertexCacheStatistics after{ Utils::AnalyzeVertexCache(indices, vertices.size()) };
+			EXPECT_LE(after.acmr, before.acmr);
+			if (isShuffled)
+			{
+				EXPECT_LT(after.acmr, before.acmr);
+			}
+		}
+	}
+
+	TEST(OptimizeMesh, OrdersVerticesByFirstUse) {
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		BuildGrid(8, true, vertices, indices);
+
+		Utils::OptimizeMesh(vertices, indices);
+
+		uint32_t nextVertex{};
+		for (uint32_t index : indices)
+		{
+			ASSERT_LE(index, nextVertex);
+			if (index == nextVertex) ++nextVertex;
+		}
+		EXPECT_EQ(nextVertex, vertices.size());
+	}
+
 }
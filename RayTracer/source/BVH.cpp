@@ -0,0 +1,649 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "DataTypes.h"
+#include "ThreadPool.h"
+
+using namespace dae;
+
+namespace
+{
+	struct Bounds
+	{
+		float min[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+		float max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const float* point)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], point[axis]);
+				max[axis] = std::max(max[axis], point[axis]);
+			}
+		}
+
+		void Grow(const Bounds& other)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], other.min[axis]);
+				max[axis] = std::max(max[axis], other.max[axis]);
+			}
+		}
+
+		float Area() const
+		{
+			if (min[0] > max[0]) return 0.f;
+
+			const float dx{ max[0] - min[0] };
+			const float dy{ max[1] - min[1] };
+			const float dz{ max[2] - min[2] };
+			return 2.f * (dx * dy + dy * dz + dz * dx);
+		}
+
+		float Centroid(int axis) const { return (min[axis] + max[axis]) * 0.5f; }
+	};
+
+	struct Reference
+	{
+		Bounds bounds{};
+		uint32_t triangleIndex{};
+	};
+
+	struct Bin
+	{
+		Bounds bounds{};
+		uint32_t count{};
+	};
+
+	constexpr uint32_t MAX_BINS{ 32 };
+	constexpr uint32_t MAX_LEAF_SIZE_HARD{ 16 };
+	constexpr float TRAVERSAL_COST{ 1.f };
+	constexpr uint32_t MAX_SPATIAL_SPLIT_DEPTH{ 8 };
+
+	uint16_t QuantizeCoordinate(float value, float origin, float scale)
+	{
+		if (scale <= 0.f) return 0;
+		return static_cast<uint16_t>(std::clamp(std::lround((value - origin) / scale), 0l, static_cast<long>(UINT16_MAX)));
+	}
+
+#pragma region Spatial Splits
+	// Clips a convex polygon against the plane point[axis] = position, keeping one side
+	uint32_t ClipPolygon(const float (*in)[3], uint32_t inCount, float (*out)[3], int axis, float position, bool keepBelow)
+	{
+		uint32_t outCount{};
+		for (uint32_t i{}; i < inCount; ++i)
+		{
+			const float* current{ in[i] };
+			const float* next{ in[(i + 1) % inCount] };
+
+			const float dCurrent{ keepBelow ? position - current[axis] : current[axis] - position };
+			const float dNext{ keepBelow ? position - next[axis] : next[axis] - position };
+
+			if (dCurrent >= 0.f)
+			{
+				std::copy_n(current, 3, out[outCount++]);
+			}
+
+			if ((dCurrent >= 0.f) != (dNext >= 0.f))
+			{
+				const float factor{ dCurrent / (dCurrent - dNext) };
+				for (int a{}; a < 3; ++a)
+				{
+					out[outCount][a] = Lerpf(current[a], next[a], factor);
+				}
+				out[outCount][axis] = position;
+				++outCount;
+			}
+		}
+		return outCount;
+	}
+
+	void SplitReference(const float (*polygon)[3], uint32_t vertexCount, uint32_t triangleIndex, float triangleArea,
+		const BVHBuildSettings& settings, uint32_t depth, std::vector<Reference>& out)
+	{
+		Reference reference{};
+		reference.triangleIndex = triangleIndex;
+		for (uint32_t i{}; i < vertexCount; ++i)
+		{
+			reference.bounds.Grow(polygon[i]);
+		}
+
+		if (depth >= std::min(settings.maxSpatialSplitDepth, MAX_SPATIAL_SPLIT_DEPTH) || reference.bounds.Area() <= settings.spatialSplitThreshold * triangleArea)
+		{
+			out.emplace_back(reference);
+			return;
+		}
+
+		// Halve the longest axis, each half keeps its own (tighter) bounds
+		int axis{};
+		float longestExtent{};
+		for (int a{}; a < 3; ++a)
+		{
+			const float extent{ reference.bounds.max[a] - reference.bounds.min[a] };
+			if (extent > longestExtent)
+			{
+				longestExtent = extent;
+				axis = a;
+			}
+		}
+
+		const float position{ reference.bounds.Centroid(axis) };
+
+		// Every clip adds at most one vertex, so 3 + MAX_SPATIAL_SPLIT_DEPTH vertices at most
+		float clipped[12][3]{};
+		uint32_t clippedCount{ ClipPolygon(polygon, vertexCount, clipped, axis, position, true) };
+		if (clippedCount >= 3)
+		{
+			SplitReference(clipped, clippedCount, triangleIndex, triangleArea, settings, depth + 1, out);
+		}
+
+		clippedCount = ClipPolygon(polygon, vertexCount, clipped, axis, position, false);
+		if (clippedCount >= 3)
+		{
+			SplitReference(clipped, clippedCount, triangleIndex, triangleArea, settings, depth + 1, out);
+		}
+	}
+#pragma endregion
+
+	class BVHBuilder final
+	{
+	public:
+		BVHBuilder(std::vector<Reference>& references, std::vector<BVHNode>& nodes, const BVHBuildSettings& settings, ThreadPool& pool) :
+			m_References(references),
+			m_Nodes(nodes),
+			m_Settings(settings),
+			m_Pool(pool)
+		{
+		}
+
+		uint32_t Build()
+		{
+			TaskGroup group{ m_Pool };
+			BuildNode(0, 0, static_cast<uint32_t>(m_References.size()), group);
+			group.Wait();
+
+			return m_NodesUsed.load();
+		}
+
+	private:
+		struct Split
+		{
+			int axis{ -1 };
+			uint32_t binIndex{};
+			float cost{ FLT_MAX };
+		};
+
+		struct BinnedRange
+		{
+			Bin bins[3][MAX_BINS]{};
+		};
+
+		std::vector<Reference>& m_References;
+		std::vector<BVHNode>& m_Nodes;
+		const BVHBuildSettings& m_Settings;
+		ThreadPool& m_Pool;
+
+		std::atomic<uint32_t> m_NodesUsed{ 1 }; // root is node 0
+
+		uint32_t GetBinCount() const { return std::clamp(m_Settings.binCount, 2u, MAX_BINS); }
+		uint32_t GetMaxLeafSize() const { return std::clamp(m_Settings.maxLeafSize, 1u, MAX_LEAF_SIZE_HARD); }
+
+		bool IsParallel(uint32_t count) const { return count > m_Settings.parallelThreshold; }
+		uint32_t GetGrainSize() const { return std::max(m_Settings.parallelThreshold, 1u); }
+
+		void CalculateBounds(uint32_t first, uint32_t count, Bounds& bounds, Bounds& centroidBounds) const
+		{
+			const auto calculate = [this](uint32_t begin, uint32_t end, Bounds& outBounds, Bounds& outCentroidBounds)
+			{
+				for (uint32_t i{ begin }; i < end; ++i)
+				{
+					const Bounds& referenceBounds{ m_References[i].bounds };
+					outBounds.Grow(referenceBounds);
+
+					const float centroid[3]{ referenceBounds.Centroid(0), referenceBounds.Centroid(1), referenceBounds.Centroid(2) };
+					outCentroidBounds.Grow(centroid);
+				}
+			};
+
+			if (!IsParallel(count))
+			{
+				calculate(first, first + count, bounds, centroidBounds);
+				return;
+			}
+
+			const uint32_t grainSize{ GetGrainSize() };
+			const uint32_t chunkCount{ (count + grainSize - 1) / grainSize };
+			std::vector<Bounds> chunkBounds(chunkCount), chunkCentroidBounds(chunkCount);
+
+			m_Pool.ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+			{
+				const uint32_t chunk{ begin / grainSize };
+				calculate(first + begin, first + end, chunkBounds[chunk], chunkCentroidBounds[chunk]);
+			});
+
+			for (uint32_t chunk{}; chunk < chunkCount; ++chunk)
+			{
+				bounds.Grow(chunkBounds[chunk]);
+				centroidBounds.Grow(chunkCentroidBounds[chunk]);
+			}
+		}
+
+		void BinReferences(uint32_t begin, uint32_t end, const Bounds& centroidBounds, const float* scale, BinnedRange& out) const
+		{
+			const uint32_t binCount{ GetBinCount() };
+
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				const Bounds& referenceBounds{ m_References[i].bounds };
+				for (int axis{}; axis < 3; ++axis)
+				{
+					const float offset{ (referenceBounds.Centroid(axis) - centroidBounds.min[axis]) * scale[axis] };
+					const uint32_t binIndex{ std::min(static_cast<uint32_t>(offset), binCount - 1) };
+
+					Bin& bin{ out.bins[axis][binIndex] };
+					bin.bounds.Grow(referenceBounds);
+					++bin.count;
+				}
+			}
+		}
+
+		Split FindBestSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds, const float* scale) const
+		{
+			const uint32_t binCount{ GetBinCount() };
+
+			BinnedRange binned{};
+			if (!IsParallel(count))
+			{
+				BinReferences(first, first + count, centroidBounds, scale, binned);
+			}
+			else
+			{
+				// Every chunk bins into its own set, merged afterwards
+				const uint32_t grainSize{ GetGrainSize() };
+				const uint32_t chunkCount{ (count + grainSize - 1) / grainSize };
+				std::vector<BinnedRange> chunkBins(chunkCount);
+
+				m_Pool.ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+				{
+					BinReferences(first + begin, first + end, centroidBounds, scale, chunkBins[begin / grainSize]);
+				});
+
+				for (const BinnedRange& chunk : chunkBins)
+				{
+					for (int axis{}; axis < 3; ++axis)
+					{
+						for (uint32_t b{}; b < binCount; ++b)
+						{
+							binned.bins[axis][b].bounds.Grow(chunk.bins[axis][b].bounds);
+							binned.bins[axis][b].count += chunk.bins[axis][b].count;
+						}
+					}
+				}
+			}
+
+			Split bestSplit{};
+			for (int axis{}; axis < 3; ++axis)
+			{
+				if (centroidBounds.max[axis] <= centroidBounds.min[axis]) continue;
+
+				const Bin* bins{ binned.bins[axis] };
+
+				// Sweep from the right to get the cost of everything right of each plane
+				float rightArea[MAX_BINS]{};
+				uint32_t rightCount[MAX_BINS]{};
+				Bounds rightBounds{};
+				uint32_t rightSum{};
+				for (uint32_t b{ binCount - 1 }; b > 0; --b)
+				{
+					rightBounds.Grow(bins[b].bounds);
+					rightSum += bins[b].count;
+					rightArea[b - 1] = rightBounds.Area();
+					rightCount[b - 1] = rightSum;
+				}
+
+				Bounds leftBounds{};
+				uint32_t leftSum{};
+				for (uint32_t b{}; b < binCount - 1; ++b)
+				{
+					leftBounds.Grow(bins[b].bounds);
+					leftSum += bins[b].count;
+
+					if (leftSum == 0 || rightCount[b] == 0) continue;
+
+					const float cost{ leftBounds.Area() * leftSum + rightArea[b] * rightCount[b] };
+					if (cost < bestSplit.cost)
+					{
+						bestSplit.axis = axis;
+						bestSplit.binIndex = b;
+						bestSplit.cost = cost;
+					}
+				}
+			}
+
+			return bestSplit;
+		}
+
+		void MakeLeaf(BVHNode& node, uint32_t first, uint32_t count) const
+		{
+			node.leftFirst = first;
+			node.triangleCount = count;
+		}
+
+		void BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, TaskGroup& group)
+		{
+			BVHNode& node{ m_Nodes[nodeIndex] };
+
+			Bounds bounds{}, centroidBounds{};
+			CalculateBounds(first, count, bounds, centroidBounds);
+
+			node.minAABB = { bounds.min[0], bounds.min[1], bounds.min[2] };
+			node.maxAABB = { bounds.max[0], bounds.max[1], bounds.max[2] };
+
+			if (count <= GetMaxLeafSize())
+			{
+				MakeLeaf(node, first, count);
+				return;
+			}
+
+			float scale[3]{};
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const float extent{ centroidBounds.max[axis] - centroidBounds.min[axis] };
+				scale[axis] = extent > 0.f ? GetBinCount() / extent : 0.f;
+			}
+
+			const Split split{ FindBestSplit(first, count, centroidBounds, scale) };
+
+			// SAH: compare against intersecting every reference in this node, costs relative to the node area
+			const float leafCost{ static_cast<float>(count) };
+			const float splitCost{ TRAVERSAL_COST + split.cost / bounds.Area() };
+
+			uint32_t leftCount{};
+			if (split.axis >= 0)
+			{
+				if (splitCost >= leafCost && count <= MAX_LEAF_SIZE_HARD)
+				{
+					MakeLeaf(node, first, count);
+					return;
+				}
+
+				const auto middle = std::partition(m_References.begin() + first, m_References.begin() + first + count,
+					[&](const Reference& reference)
+					{
+						const float offset{ (reference.bounds.Centroid(split.axis) - centroidBounds.min[split.axis]) * scale[split.axis] };
+						return std::min(static_cast<uint32_t>(offset), GetBinCount() - 1) <= split.binIndex;
+					});
+
+				leftCount = static_cast<uint32_t>(middle - (m_References.begin() + first));
+			}
+
+			// No usable plane (all centroids coincide or the partition collapsed), fall back to an object median split
+			if (leftCount == 0 || leftCount == count)
+			{
+				if (count <= MAX_LEAF_SIZE_HARD)
+				{
+					MakeLeaf(node, first, count);
+					return;
+				}
+
+				int axis{};
+				for (int a{ 1 }; a < 3; ++a)
+				{
+					if (bounds.max[a] - bounds.min[a] > bounds.max[axis] - bounds.min[axis]) axis = a;
+				}
+
+				leftCount = count / 2;
+				std::nth_element(m_References.begin() + first, m_References.begin() + first + leftCount, m_References.begin() + first + count,
+					[axis](const Reference& a, const Reference& b) { return a.bounds.Centroid(axis) < b.bounds.Centroid(axis); });
+			}
+
+			// Children are allocated as a pair from the arena
+			const uint32_t leftIndex{ m_NodesUsed.fetch_add(2, std::memory_order_relaxed) };
+			assert(leftIndex + 1 < m_Nodes.size() && "BVH node arena exhausted");
+
+			node.leftFirst = leftIndex;
+			node.triangleCount = 0;
+
+			const uint32_t rightFirst{ first + leftCount };
+			const uint32_t rightCount{ count - leftCount };
+
+			if (IsParallel(leftCount))
+			{
+				group.Run([this, leftIndex, first, leftCount, &group]() { BuildNode(leftIndex, first, leftCount, group); });
+			}
+			else
+			{
+				BuildNode(leftIndex, first, leftCount, group);
+			}
+
+			BuildNode(leftIndex + 1, rightFirst, rightCount, group);
+		}
+	};
+}
+
+void BVH::Build(const std::vector<Vector3>& positions, const std::vector<int>& indices, const BVHBuildSettings& settings)
+{
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	Clear();
+
+	const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+	if (triangleCount == 0) return;
+
+	ThreadPool& pool{ ThreadPool::GetInstance() };
+
+	// Compressed mode builds over the 16-bit quantized positions, so the node bounds enclose the decoded triangles exactly
+	std::vector<Vector3> quantizedPositions{};
+	if (settings.mode == BVHMode::Compressed)
+	{
+		QuantizePositions(positions, quantizedPositions);
+	}
+	const std::vector<Vector3>& buildPositions{ settings.mode == BVHMode::Compressed ? quantizedPositions : positions };
+
+	// Create the build references, optionally splitting long thin triangles
+	std::vector<Reference> references{};
+	const uint32_t grainSize{ std::max(settings.parallelThreshold, 1u) };
+	const uint32_t chunkCount{ (triangleCount + grainSize - 1) / grainSize };
+	std::vector<std::vector<Reference>> chunkReferences(chunkCount);
+
+	pool.ParallelFor(triangleCount, grainSize, [&](uint32_t begin, uint32_t end)
+	{
+		std::vector<Reference>& out{ chunkReferences[begin / grainSize] };
+		out.reserve(end - begin);
+
+		for (uint32_t i{ begin }; i < end; ++i)
+		{
+			const Vector3& v0{ buildPositions[indices[i * 3]] };
+			const Vector3& v1{ buildPositions[indices[i * 3 + 1]] };
+			const Vector3& v2{ buildPositions[indices[i * 3 + 2]] };
+
+			const float triangle[3][3]{ { v0.x, v0.y, v0.z }, { v1.x, v1.y, v1.z }, { v2.x, v2.y, v2.z } };
+
+			if (settings.useSpatialSplits)
+			{
+				const float triangleArea{ Vector3::Cross(v1 - v0, v2 - v0).Magnitude() * 0.5f };
+				SplitReference(triangle, 3, i, triangleArea, settings, 0, out);
+			}
+			else
+			{
+				Reference reference{};
+				reference.triangleIndex = i;
+				reference.bounds.Grow(triangle[0]);
+				reference.bounds.Grow(triangle[1]);
+				reference.bounds.Grow(triangle[2]);
+				out.emplace_back(reference);
+			}
+		}
+	});
+
+	size_t referenceCount{};
+	for (const auto& chunk : chunkReferences) referenceCount += chunk.size();
+
+	references.reserve(referenceCount);
+	for (auto& chunk : chunkReferences)
+	{
+		references.insert(references.end(), chunk.begin(), chunk.end());
+		chunk = std::vector<Reference>{};
+	}
+
+	// Node arena: a binary tree over N references never needs more than 2N - 1 nodes
+	m_Nodes.resize(references.size() * 2);
+
+	BVHBuilder builder{ references, m_Nodes, settings, pool };
+	const uint32_t nodesUsed{ builder.Build() };
+	m_Nodes.resize(nodesUsed);
+	m_Nodes.shrink_to_fit();
+
+	m_TriangleIndices.resize(references.size());
+	for (size_t i{}; i < references.size(); ++i)
+	{
+		m_TriangleIndices[i] = references[i].triangleIndex;
+	}
+
+	if (settings.mode == BVHMode::Compressed)
+	{
+		Compress();
+	}
+
+	const auto endTime = std::chrono::high_resolution_clock::now();
+	m_BuildTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+	std::cout << "BVH built: " << triangleCount << " triangles, " << references.size() << " references, "
+		<< nodesUsed << " nodes in " << m_BuildTime << " ms"
+		<< (m_Mode == BVHMode::Compressed ? " (compressed, " : " (full, ") << GetMemoryFootprint() / 1024 << " KB)\n";
+}
+
+void BVH::Clear()
+{
+	m_Mode = BVHMode::Full;
+	m_Nodes.clear();
+	m_TriangleIndices.clear();
+	m_CompressedNodes.clear();
+	m_QuantizedVertices.clear();
+	m_BuildTime = 0.f;
+}
+
+size_t BVH::GetMemoryFootprint() const
+{
+	return m_Nodes.capacity() * sizeof(BVHNode)
+		+ m_TriangleIndices.capacity() * sizeof(uint32_t)
+		+ m_CompressedNodes.capacity() * sizeof(CompressedBVHNode)
+		+ m_QuantizedVertices.capacity() * sizeof(QuantizedVertex);
+}
+
+#pragma region Compression
+void BVH::Compress()
+{
+	m_Mode = BVHMode::Compressed;
+
+	// Every compressed node stores both children of a full interior node
+	m_CompressedNodes.reserve(std::max<size_t>(m_Nodes.size() / 2, 1));
+
+	CompressNode(0);
+
+	// The full nodes are only needed to build the compressed ones, the leaves keep using the triangle index list
+	m_Nodes = std::vector<BVHNode>{};
+	m_CompressedNodes.shrink_to_fit();
+}
+
+void BVH::QuantizePositions(const std::vector<Vector3>& positions, std::vector<Vector3>& quantizedPositions)
+{
+	// 16 bits per axis inside the mesh bounds
+	const AABB bounds{ AABB::FromPoints(positions) };
+	m_QuantizationOrigin = bounds.minAABB;
+	m_QuantizationScale = (bounds.maxAABB - bounds.minAABB) / static_cast<float>(UINT16_MAX);
+
+	m_QuantizedVertices.resize(positions.size());
+	quantizedPositions.resize(positions.size());
+	for (size_t i{}; i < positions.size(); ++i)
+	{
+		uint16_t* quantized{ m_QuantizedVertices[i].position };
+		quantized[0] = QuantizeCoordinate(positions[i].x, m_QuantizationOrigin.x, m_QuantizationScale.x);
+		quantized[1] = QuantizeCoordinate(positions[i].y, m_QuantizationOrigin.y, m_QuantizationScale.y);
+		quantized[2] = QuantizeCoordinate(positions[i].z, m_QuantizationOrigin.z, m_QuantizationScale.z);
+		quantizedPositions[i] = DecodePosition(quantized);
+	}
+}
+
+uint32_t BVH::CompressNode(uint32_t nodeIndex)
+{
+	// Children are appended while recursing, so fill a copy and store it at the end
+	const uint32_t compressedIndex{ static_cast<uint32_t>(m_CompressedNodes.size()) };
+	m_CompressedNodes.emplace_back();
+
+	const BVHNode node{ m_Nodes[nodeIndex] };
+	CompressedBVHNode compressed{};
+
+	const float nodeMin[3]{ node.minAABB.x, node.minAABB.y, node.minAABB.z };
+	const float nodeMax[3]{ node.maxAABB.x, node.maxAABB.y, node.maxAABB.z };
+
+	for (int axis{}; axis < 3; ++axis)
+	{
+		compressed.origin[axis] = nodeMin[axis];
+
+		// Smallest power of two grid that fits the node extent in 255 steps
+		const float extent{ nodeMax[axis] - nodeMin[axis] };
+		int exponent{ -126 };
+		if (extent > 0.f)
+		{
+			exponent = static_cast<int>(std::ceil(std::log2(extent / 255.f)));
+		}
+		compressed.exponent[axis] = static_cast<int8_t>(std::clamp(exponent, -126, 127));
+	}
+
+	// A leaf root becomes the single child of the compressed root
+	const BVHNode children[2]{
+		node.IsLeaf() ? node : m_Nodes[node.leftFirst],
+		node.IsLeaf() ? BVHNode{} : m_Nodes[node.leftFirst + 1]
+	};
+
+	for (int child{}; child < 2; ++child)
+	{
+		if (node.IsLeaf() && child == 1)
+		{
+			compressed.childData[child] = CompressedBVHNode::EMPTY_CHILD;
+			continue;
+		}
+
+		const float childMin[3]{ children[child].minAABB.x, children[child].minAABB.y, children[child].minAABB.z };
+		const float childMax[3]{ children[child].maxAABB.x, children[child].maxAABB.y, children[child].maxAABB.z };
+
+		// Conservative: round outwards, then fix up any float rounding in the decode so the box never shrinks
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float scale{ compressed.GetScale(axis) };
+			const float origin{ compressed.origin[axis] };
+
+			int minQuantized{ std::clamp(static_cast<int>(std::floor((childMin[axis] - origin) / scale)), 0, 255) };
+			while (minQuantized > 0 && origin + minQuantized * scale > childMin[axis]) --minQuantized;
+
+			int maxQuantized{ std::clamp(static_cast<int>(std::ceil((childMax[axis] - origin) / scale)), 0, 255) };
+			while (maxQuantized < 255 && origin + maxQuantized * scale < childMax[axis]) ++maxQuantized;
+
+			compressed.childMin[child][axis] = static_cast<uint8_t>(minQuantized);
+			compressed.childMax[child][axis] = static_cast<uint8_t>(maxQuantized);
+		}
+
+		if (children[child].IsLeaf())
+		{
+			assert(children[child].leftFirst < (1u << 27) && children[child].triangleCount <= 32 && "Leaf does not fit the compressed encoding");
+			compressed.leafMask |= 1 << child;
+			compressed.childData[child] = (children[child].leftFirst << 5) | (children[child].triangleCount - 1);
+		}
+		else
+		{
+			compressed.childData[child] = CompressNode(node.leftFirst + child);
+		}
+	}
+
+	m_CompressedNodes[compressedIndex] = compressed;
+	return compressedIndex;
+}
+#pragma endregion
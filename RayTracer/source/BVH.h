@@ -0,0 +1,123 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	// 32 bytes, two nodes share a cache line
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		uint32_t leftFirst{}; // interior: index of the left child (right child = left + 1), leaf: first entry in the triangle index list
+		Vector3 maxAABB{};
+		uint32_t triangleCount{}; // 0 for interior nodes
+
+		bool IsLeaf() const { return triangleCount > 0; }
+	};
+
+	enum class BVHMode
+	{
+		Full, // float AABB nodes, triangles are read from the mesh
+		Compressed // 8-bit child bounds relative to the parent, 16-bit quantized vertex positions instead of the mesh's floats
+	};
+
+	struct CompressedBVHNode
+	{
+		float origin[3]{}; // min corner of this node's bounds
+		int8_t exponent[3]{}; // child bounds are stored on a grid of 2^exponent per axis
+		uint8_t leafMask{}; // bit i set when child i is a leaf
+		uint8_t childMin[2][3]{};
+		uint8_t childMax[2][3]{};
+		uint32_t childData[2]{}; // interior: compressed node index, leaf: (first entry in the triangle index list << 5) | (triangle count - 1)
+
+		static constexpr uint32_t EMPTY_CHILD{ UINT32_MAX };
+
+		bool IsLeaf(int child) const { return leafMask & (1 << child); }
+		float GetScale(int axis) const { return std::bit_cast<float>(static_cast<uint32_t>(exponent[axis] + 127) << 23); }
+
+		Vector3 GetChildMin(int child) const
+		{
+			return { origin[0] + childMin[child][0] * GetScale(0), origin[1] + childMin[child][1] * GetScale(1), origin[2] + childMin[child][2] * GetScale(2) };
+		}
+
+		Vector3 GetChildMax(int child) const
+		{
+			return { origin[0] + childMax[child][0] * GetScale(0), origin[1] + childMax[child][1] * GetScale(1), origin[2] + childMax[child][2] * GetScale(2) };
+		}
+	};
+
+	// 6 bytes, one per mesh vertex. The leaves index them through the mesh indices like the full BVH indexes the float
+	// positions, the normal of the closest hit is recalculated from the decoded vertices.
+	struct QuantizedVertex
+	{
+		uint16_t position[3]{}; // relative to the mesh bounds, see BVH::DecodePosition
+	};
+
+	struct BVHBuildSettings
+	{
+		BVHMode mode{ BVHMode::Full };
+
+		uint32_t binCount{ 16 };
+		uint32_t maxLeafSize{ 4 };
+
+		// Nodes holding more references than this are binned on the thread pool and their children are built as separate tasks
+		uint32_t parallelThreshold{ 8192 };
+
+		// Long thin triangles get split into several references with tighter bounds before building (early split clipping)
+		bool useSpatialSplits{ false };
+		float spatialSplitThreshold{ 16.f }; // split when the AABB surface area exceeds this times the triangle area
+		uint32_t maxSpatialSplitDepth{ 3 };
+	};
+
+	class BVH final
+	{
+	public:
+		// Builds over the triangles in object space, the mesh transform is applied to the ray during traversal
+		void Build(const std::vector<Vector3>& positions, const std::vector<int>& indices, const BVHBuildSettings& settings = {});
+		void Clear();
+
+		bool IsBuilt() const { return !m_Nodes.empty() || !m_CompressedNodes.empty(); }
+		BVHMode GetMode() const { return m_Mode; }
+
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetTriangleIndices() const { return m_TriangleIndices; }
+
+		const std::vector<CompressedBVHNode>& GetCompressedNodes() const { return m_CompressedNodes; }
+		const std::vector<QuantizedVertex>& GetQuantizedVertices() const { return m_QuantizedVertices; }
+
+		Vector3 DecodePosition(const uint16_t* quantized) const
+		{
+			return {
+				m_QuantizationOrigin.x + quantized[0] * m_QuantizationScale.x,
+				m_QuantizationOrigin.y + quantized[1] * m_QuantizationScale.y,
+				m_QuantizationOrigin.z + quantized[2] * m_QuantizationScale.z
+			};
+		}
+
+		Vector3 DecodeVertex(int vertexIndex) const { return DecodePosition(m_QuantizedVertices[vertexIndex].position); }
+
+		float GetBuildTime() const { return m_BuildTime; } // milliseconds
+		size_t GetMemoryFootprint() const; // bytes
+
+	private:
+		BVHMode m_Mode{ BVHMode::Full };
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_TriangleIndices{};
+
+		std::vector<CompressedBVHNode> m_CompressedNodes{};
+		std::vector<QuantizedVertex> m_QuantizedVertices{};
+		Vector3 m_QuantizationOrigin{};
+		Vector3 m_QuantizationScale{};
+
+		float m_BuildTime{};
+
+		// Fills m_QuantizedVertices and their decoded positions, the compressed build runs over the decoded ones
+		void QuantizePositions(const std::vector<Vector3>& positions, std::vector<Vector3>& quantizedPositions);
+		void Compress();
+		uint32_t CompressNode(uint32_t nodeIndex);
+	};
+}
@@ -5,6 +5,7 @@
 
 #include "Math.h"
 #include "Timer.h"
+#include "CameraPath.h"
 
 namespace dae
 {
@@ -40,6 +41,22 @@ namespace dae
 			fov = tanf(TO_RADIANS * fovAngle * 0.5f);
 		}
 
+		void LookAt(const Vector3& target)
+		{
+			const Vector3 direction{ (target - origin).Normalized() };
+			totalYaw = atan2f(direction.x, direction.z);
+			totalPitch = -asinf(direction.y);
+			CalculateCameraToWorld();
+		}
+
+		void ApplyKeyframe(const CameraKeyframe& keyframe)
+		{
+			origin = keyframe.origin;
+			fovAngle = keyframe.fovAngle;
+			SetFOV(fovAngle);
+			LookAt(keyframe.target);
+		}
+
 
 		Matrix CalculateCameraToWorld()
 		{
@@ -0,0 +1,64 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct CameraKeyframe
+	{
+		float time{}; // seconds on the scene timeline
+		Vector3 origin{};
+		Vector3 target{};
+		float fovAngle{ 45.f };
+	};
+
+	// Keyframed camera, positions and targets follow a Catmull-Rom spline through the keys, the fov is interpolated linearly
+	class CameraPath final
+	{
+	public:
+		// Keys have to be added in increasing time order
+		void AddKeyframe(const CameraKeyframe& keyframe) { m_Keyframes.push_back(keyframe); }
+		void Clear() { m_Keyframes.clear(); }
+
+		bool IsEmpty() const { return m_Keyframes.empty(); }
+		float GetDuration() const { return IsEmpty() ? 0.f : m_Keyframes.back().time - m_Keyframes.front().time; }
+
+		// Clamps to the first/last key outside of the path
+		CameraKeyframe Evaluate(float time) const
+		{
+			if (m_Keyframes.size() == 1 || time <= m_Keyframes.front().time) return m_Keyframes.front();
+			if (time >= m_Keyframes.back().time) return m_Keyframes.back();
+
+			const auto next = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), time,
+				[](float t, const CameraKeyframe& keyframe) { return t < keyframe.time; });
+			const size_t index1{ static_cast<size_t>(next - m_Keyframes.begin()) };
+			const size_t index0{ index1 - 1 };
+
+			const CameraKeyframe& key0{ m_Keyframes[index0 > 0 ? index0 - 1 : index0] };
+			const CameraKeyframe& key1{ m_Keyframes[index0] };
+			const CameraKeyframe& key2{ m_Keyframes[index1] };
+			const CameraKeyframe& key3{ m_Keyframes[std::min(index1 + 1, m_Keyframes.size() - 1)] };
+
+			const float t{ (time - key1.time) / (key2.time - key1.time) };
+
+			CameraKeyframe result{};
+			result.time = time;
+			result.origin = CatmullRom(key0.origin, key1.origin, key2.origin, key3.origin, t);
+			result.target = CatmullRom(key0.target, key1.target, key2.target, key3.target, t);
+			result.fovAngle = Lerpf(key1.fovAngle, key2.fovAngle, t);
+			return result;
+		}
+
+	private:
+		std::vector<CameraKeyframe> m_Keyframes{};
+
+		static Vector3 CatmullRom(const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& p3, float t)
+		{
+			const float t2{ t * t };
+			const float t3{ t2 * t };
+			return 0.5f * ((2.f * p1) + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+		}
+	};
+}
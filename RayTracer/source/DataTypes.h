@@ -2,6 +2,7 @@
 #include <cassert>
 
 #include "Math.h"
+#include "BVH.h"
 #include <vector>
 #include <array>
 
@@ -106,6 +107,15 @@ namespace dae
 		}
 	};
 
+	// Per-frame placement of a mesh, the geometry itself never changes after loading.
+	// Hit tests take this separately so a frame can be traced with the transforms captured in a SceneSnapshot.
+	struct MeshInstance
+	{
+		Matrix worldTransform{};
+		Matrix inverseTransform{}; // world to object space, rays are traced in object space
+		AABB transformedAABB{};
+	};
+
 
 	struct TriangleMesh
 	{
@@ -136,13 +146,14 @@ namespace dae
 		Matrix rotationTransform{};
 		Matrix translationTransform{};
 		Matrix scaleTransform{};
+		Matrix worldTransform{};
+		Matrix inverseTransform{}; // world to object space, used to trace the BVH
+
+		BVH bvh{};
 
 		AABB aabb;
 		AABB transformedAABB;
 
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
-
 		void Translate(const Vector3& translation)
 		{
 			translationTransform = Matrix::CreateTranslation(translation);
@@ -160,6 +171,8 @@ namespace dae
 
 		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
 		{
+			assert(bvh.GetMode() != BVHMode::Compressed && "The float positions of a compressed mesh are released");
+
 			int startIndex = static_cast<int>(positions.size());
 
 			positions.emplace_back(triangle.v0);
@@ -172,6 +185,9 @@ namespace dae
 
 			normals.emplace_back(triangle.normal);
 
+			// Topology changed, BuildBVH needs to be called again
+			bvh.Clear();
+
 			//Not ideal, but making sure all vertices are updated
 			if (!ignoreTransformUpdate)
 			{
@@ -204,24 +220,58 @@ namespace dae
 			aabb = AABB::FromPoints(positions);
 		}
 
-		void UpdateTransforms() 
+		// A compressed BVH keeps its own quantized vertices, the float positions and normals are released:
+		// nothing reads them anymore and they would take more memory than the whole compressed BVH
+		void BuildBVH(const BVHBuildSettings& settings = {})
 		{
-			Matrix transform = scaleTransform * rotationTransform * translationTransform;
+			bvh.Build(positions, indices, settings);
 
-			transformedPositions.clear();
-			transformedNormals.clear();
-			transformedPositions.reserve(positions.size());
-			transformedNormals.reserve(normals.size());
-
-			for (const auto& position : positions) {
-				transformedPositions.emplace_back(transform.TransformPoint(position));
+			if (bvh.GetMode() == BVHMode::Compressed)
+			{
+				positions = std::vector<Vector3>{};
+				normals = std::vector<Vector3>{};
 			}
+		}
 
-			for (const auto& normal : normals) {
-				transformedNormals.emplace_back(transform.TransformVector(normal).Normalized());
-			}
+		size_t GetVertexCount() const
+		{
+			return bvh.GetMode() == BVHMode::Compressed ? bvh.GetQuantizedVertices().size() : positions.size();
+		}
+
+		// Object space position and normal, decoded for compressed meshes
+		Vector3 GetPosition(int vertexIndex) const
+		{
+			return bvh.GetMode() == BVHMode::Compressed ? bvh.DecodeVertex(vertexIndex) : positions[vertexIndex];
+		}
 
+		Vector3 GetNormal(uint32_t triangleIndex) const
+		{
+			if (bvh.GetMode() != BVHMode::Compressed) return normals[triangleIndex];
+
+			const Vector3 v0{ bvh.DecodeVertex(indices[triangleIndex * 3]) };
+			const Vector3 v1{ bvh.DecodeVertex(indices[triangleIndex * 3 + 1]) };
+			const Vector3 v2{ bvh.DecodeVertex(indices[triangleIndex * 3 + 2]) };
+			return Vector3::Cross(v1 - v0, v2 - v0).Normalized();
+		}
+
+		void UpdateTransforms() 
+		{
+			Matrix transform = scaleTransform * rotationTransform * translationTransform;
+			worldTransform = transform;
+			inverseTransform = Matrix::Inverse(transform);
 			transformedAABB = aabb.Transformed(transform);
+
+			// Rays are traced in object space, only the normal of the closest hit gets transformed
+		}
+
+		MeshInstance GetInstance() const { return { worldTransform, inverseTransform, transformedAABB }; }
+
+		// Bytes held by the mesh data and its acceleration structure
+		size_t GetMemoryFootprint() const
+		{
+			return (positions.capacity() + normals.capacity()) * sizeof(Vector3)
+				+ indices.capacity() * sizeof(int)
+				+ bvh.GetMemoryFootprint();
 		}
 	};
 #pragma endregion
@@ -229,7 +279,9 @@ namespace dae
 	enum class LightType
 	{
 		Point,
-		Directional
+		Directional,
+		SphereArea, // origin + radius
+		QuadArea // origin is the center, extentU and extentV go from the center to the edges
 	};
 
 	struct Light
@@ -240,6 +292,20 @@ namespace dae
 		float intensity{};
 
 		LightType type{};
+
+		// Area lights are shaded like a point light in their center, only their shadows are soft
+		float radius{};
+		Vector3 extentU{};
+		Vector3 extentV{};
+
+		bool IsAreaLight() const { return type == LightType::SphereArea || type == LightType::QuadArea; }
+		// No point of the light is farther from origin than this
+		float GetBoundingRadius() const
+		{
+			if (type == LightType::SphereArea) return radius;
+			if (type == LightType::QuadArea) return extentU.Magnitude() + extentV.Magnitude();
+			return 0.f;
+		}
 	};
 #pragma endregion
 #pragma region MISC
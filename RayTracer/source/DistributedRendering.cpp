@@ -0,0 +1,471 @@
+#include "DistributedRendering.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SceneSnapshot.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace dae;
+
+namespace
+{
+	// Both ends are expected to share endianness and float layout (any x86/x64 machine), nothing is byte swapped
+	constexpr uint32_t PROTOCOL_MAGIC{ 0x52445452 }; // "RTDR"
+	constexpr uint32_t PROTOCOL_VERSION{ 4 };
+
+	// Generous because the first frame of a worker includes loading its scene, a crashed worker is noticed immediately anyway
+	constexpr int WORKER_TIMEOUT_MS{ 60000 };
+
+	enum class MessageType : uint32_t
+	{
+		Hello, // worker -> coordinator, right after connecting
+		FrameBegin, // coordinator -> worker, before the tiles of a frame
+		Tile, // coordinator -> worker
+		TileResult, // worker -> coordinator, TileMessage followed by the tile's ColorRGBs
+		Shutdown // coordinator -> worker
+	};
+
+	struct MessageHeader
+	{
+		MessageType type;
+		uint32_t size; // payload bytes after the header
+	};
+
+	struct HelloMessage
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t threadCount;
+	};
+
+	struct FrameMessage
+	{
+		uint32_t frameIndex;
+		uint32_t sceneIndex;
+		float time;
+
+		float cameraToWorld[4][4];
+		float fov;
+
+		int32_t width;
+		int32_t height;
+		int32_t lightingMode;
+		uint32_t isShadowsActive;
+		uint32_t isRasterizedPrimary;
+	};
+
+	struct TileMessage
+	{
+		uint32_t frameIndex;
+		int32_t x0, y0, x1, y1;
+	};
+
+	void AppendMessage(std::vector<char>& buffer, MessageType type, const void* pPayload, uint32_t size)
+	{
+		const MessageHeader header{ type, size };
+		const char* pHeader{ reinterpret_cast<const char*>(&header) };
+		buffer.insert(buffer.end(), pHeader, pHeader + sizeof(header));
+		buffer.insert(buffer.end(), static_cast<const char*>(pPayload), static_cast<const char*>(pPayload) + size);
+	}
+
+	bool WriteMessage(Socket& socket, MessageType type, const void* pPayload, uint32_t size)
+	{
+		const MessageHeader header{ type, size };
+		return socket.Send(&header, sizeof(header)) && socket.Send(pPayload, size);
+	}
+
+	// Reads a fixed size payload, fails on any other message or size
+	template<typename T>
+	bool ReadMessage(Socket& socket, MessageType type, T& payload)
+	{
+		MessageHeader header{};
+		return socket.Receive(&header, sizeof(header))
+			&& header.type == type && header.size == sizeof(T)
+			&& socket.Receive(&payload, sizeof(T));
+	}
+
+	int TileArea(const TileMessage& tile)
+	{
+		return (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+	}
+}
+
+#pragma region Settings
+bool DistributedSettings::ParseCommandLine(int argc, char* args[], DistributedSettings& settings)
+{
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc && args[i + 1][0] != '-' };
+
+		if (argument == "--coordinator")
+		{
+			settings.mode = Mode::Coordinator;
+			if (hasValue)
+				settings.port = static_cast<uint16_t>(std::stoul(args[++i]));
+		}
+		else if (argument == "--worker")
+		{
+			settings.mode = Mode::Worker;
+			if (hasValue)
+			{
+				const std::string address{ args[++i] };
+				const size_t separator{ address.rfind(':') };
+				settings.host = address.substr(0, separator);
+				if (separator != std::string::npos)
+					settings.port = static_cast<uint16_t>(std::stoul(address.substr(separator + 1)));
+			}
+		}
+		else if (argument == "--workers" && hasValue)
+			settings.expectedWorkers = static_cast<uint32_t>(std::stoul(args[++i]));
+	}
+
+	return settings.mode != Mode::Local;
+}
+#pragma endregion
+
+#pragma region Coordinator
+RenderCoordinator::RenderCoordinator(uint32_t sceneIndex)
+	: m_SceneIndex(sceneIndex)
+{
+	Socket::InitializeNetwork();
+}
+
+RenderCoordinator::~RenderCoordinator()
+{
+	for (WorkerConnection& worker : m_Workers)
+	{
+		WriteMessage(worker.socket, MessageType::Shutdown, nullptr, 0);
+	}
+}
+
+bool RenderCoordinator::Listen(uint16_t port)
+{
+	if (!m_ListenSocket.Listen(port))
+	{
+		std::cout << "Coordinator failed to listen on port " << port << std::endl;
+		return false;
+	}
+
+	std::cout << "Coordinator listening on port " << port << std::endl;
+	return true;
+}
+
+void RenderCoordinator::AcceptWorkers(uint32_t minWorkers, int timeoutMs)
+{
+	if (!m_ListenSocket.IsValid()) return;
+
+	const auto deadline{ std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs) };
+	while (true)
+	{
+		const auto remaining{ std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count() };
+		const bool isWaiting{ m_Workers.size() < minWorkers && remaining > 0 };
+
+		Socket socket{ m_ListenSocket.Accept(isWaiting ? static_cast<int>(remaining) : 0) };
+		if (!socket.IsValid())
+		{
+			if (isWaiting) continue;
+			break;
+		}
+
+		socket.SetReceiveTimeout(WORKER_TIMEOUT_MS);
+
+		HelloMessage hello{};
+		if (!ReadMessage(socket, MessageType::Hello, hello) || hello.magic != PROTOCOL_MAGIC || hello.version != PROTOCOL_VERSION)
+		{
+			std::cout << "Rejected render worker with a different protocol" << std::endl;
+			continue;
+		}
+
+		const uint32_t id{ m_NextWorkerId++ };
+		std::cout << "Render worker " << id << " connected (" << hello.threadCount << " threads)" << std::endl;
+		m_Workers.push_back({ std::move(socket), id });
+	}
+}
+
+void RenderCoordinator::RenderFrame(const SceneSnapshot& snapshot, Renderer& renderer)
+{
+	// Late joiners start with the next frame
+	AcceptWorkers(0, 0);
+
+	const int width{ renderer.GetWidth() };
+	const int height{ renderer.GetHeight() };
+
+	{
+		std::lock_guard lock{ m_TileMutex };
+		m_PendingTiles.clear();
+		for (int y{}; y < height; y += TILE_SIZE)
+		{
+			for (int x{}; x < width; x += TILE_SIZE)
+			{
+				m_PendingTiles.push_back({ x, y, std::min(x + TILE_SIZE, width), std::min(y + TILE_SIZE, height) });
+			}
+		}
+	}
+
+	// Workers rebuild the scene state from the time, only the camera is sent since it follows input
+	FrameMessage frame{};
+	frame.frameIndex = m_FrameIndex;
+	frame.sceneIndex = m_SceneIndex;
+	frame.time = snapshot.time;
+	for (int row{}; row < 4; ++row)
+	{
+		const Vector4 axis{ snapshot.cameraToWorld[row] };
+		frame.cameraToWorld[row][0] = axis.x;
+		frame.cameraToWorld[row][1] = axis.y;
+		frame.cameraToWorld[row][2] = axis.z;
+		frame.cameraToWorld[row][3] = axis.w;
+	}
+	frame.fov = snapshot.fov;
+	frame.width = width;
+	frame.height = height;
+	frame.lightingMode = renderer.GetLightingMode();
+	frame.isShadowsActive = renderer.IsShadowsActive();
+	frame.isRasterizedPrimary = renderer.IsRasterizedPrimaryVisibilityActive();
+
+	std::vector<char> frameMessage{};
+	AppendMessage(frameMessage, MessageType::FrameBegin, &frame, sizeof(frame));
+
+	// One session per worker, tiles are pulled from the shared queue
+	std::vector<std::thread> sessions{};
+	std::vector<char> isLost(m_Workers.size(), false);
+	for (size_t i{}; i < m_Workers.size(); ++i)
+	{
+		sessions.emplace_back([this, i, &frameMessage, &renderer, &isLost]()
+		{
+			isLost[i] = !ServeWorker(m_Workers[i], frameMessage, renderer);
+		});
+	}
+
+	// The coordinator is a worker too
+	renderer.BeginFrame(snapshot);
+	Tile tile{};
+	while (PopTile(tile))
+	{
+		renderer.RenderRegion(snapshot, tile.x0, tile.y0, tile.x1, tile.y1);
+	}
+
+	for (std::thread& session : sessions)
+	{
+		session.join();
+	}
+
+	// Tiles returned by workers that were lost after the local loop ran dry
+	while (PopTile(tile))
+	{
+		renderer.RenderRegion(snapshot, tile.x0, tile.y0, tile.x1, tile.y1);
+	}
+
+	for (size_t i{ m_Workers.size() }; i-- > 0;)
+	{
+		if (!isLost[i]) continue;
+
+		std::cout << "Lost render worker " << m_Workers[i].id << ", its tiles were redistributed" << std::endl;
+		m_Workers.erase(m_Workers.begin() + i);
+	}
+
+	++m_FrameIndex;
+}
+
+bool RenderCoordinator::PopTile(Tile& tile)
+{
+	std::lock_guard lock{ m_TileMutex };
+	if (m_PendingTiles.empty()) return false;
+
+	tile = m_PendingTiles.front();
+	m_PendingTiles.pop_front();
+	return true;
+}
+
+void RenderCoordinator::ReturnTiles(const std::vector<Tile>& tiles)
+{
+	std::lock_guard lock{ m_TileMutex };
+	m_PendingTiles.insert(m_PendingTiles.end(), tiles.begin(), tiles.end());
+}
+
+bool RenderCoordinator::ServeWorker(WorkerConnection& worker, const std::vector<char>& frameMessage, Renderer& renderer)
+{
+	std::vector<Tile> inFlight{};
+	std::vector<ColorRGB> colors(TILE_SIZE * TILE_SIZE);
+	worker.tilesRendered = 0;
+
+	const auto sendNextTile = [&]()
+	{
+		Tile tile{};
+		if (!PopTile(tile)) return true;
+
+		inFlight.push_back(tile);
+		const TileMessage message{ m_FrameIndex, tile.x0, tile.y0, tile.x1, tile.y1 };
+		return WriteMessage(worker.socket, MessageType::Tile, &message, sizeof(message));
+	};
+
+	bool isConnected{ worker.socket.Send(frameMessage.data(), frameMessage.size()) };
+	for (uint32_t i{}; isConnected && i < MAX_TILES_IN_FLIGHT; ++i)
+	{
+		isConnected = sendNextTile();
+	}
+
+	while (isConnected && !inFlight.empty())
+	{
+		MessageHeader header{};
+		TileMessage result{};
+		isConnected = worker.socket.Receive(&header, sizeof(header))
+			&& header.type == MessageType::TileResult && header.size >= sizeof(TileMessage)
+			&& worker.socket.Receive(&result, sizeof(result));
+		if (!isConnected) break;
+
+		const auto it{ std::find_if(inFlight.begin(), inFlight.end(), [&result](const Tile& tile)
+		{
+			return tile.x0 == result.x0 && tile.y0 == result.y0 && tile.x1 == result.x1 && tile.y1 == result.y1;
+		}) };
+
+		const size_t pixelCount{ static_cast<size_t>(TileArea(result)) };
+		isConnected = result.frameIndex == m_FrameIndex && it != inFlight.end()
+			&& header.size == sizeof(TileMessage) + pixelCount * sizeof(ColorRGB)
+			&& worker.socket.Receive(colors.data(), pixelCount * sizeof(ColorRGB));
+		if (!isConnected) break;
+
+		// Tiles don't overlap, sessions can write the frame concurrently
+		renderer.WriteRegion(result.x0, result.y0, result.x1, result.y1, colors.data());
+		inFlight.erase(it);
+		++worker.tilesRendered;
+
+		isConnected = sendNextTile();
+	}
+
+	if (!isConnected)
+	{
+		ReturnTiles(inFlight);
+		worker.socket.Close();
+	}
+	return isConnected;
+}
+#pragma endregion
+
+#pragma region Worker
+bool RenderWorker::Run(const std::string& host, uint16_t port)
+{
+	Socket::InitializeNetwork();
+
+	// The coordinator may still be starting up
+	Socket socket{};
+	for (int attempt{}; attempt < 30 && !socket.Connect(host, port); ++attempt)
+	{
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	if (!socket.IsValid())
+	{
+		std::cout << "Render worker failed to connect to " << host << ":" << port << std::endl;
+		return false;
+	}
+
+	const HelloMessage hello{ PROTOCOL_MAGIC, PROTOCOL_VERSION, std::thread::hardware_concurrency() };
+	if (!WriteMessage(socket, MessageType::Hello, &hello, sizeof(hello))) return false;
+
+	std::cout << "Render worker connected to " << host << ":" << port << std::endl;
+
+	Timer timer{};
+	Renderer renderer{ 1, 1 };
+	Scene* pScene{ nullptr };
+	uint32_t sceneIndex{};
+	SceneSnapshot snapshot{};
+
+	FrameMessage frame{};
+	std::vector<char> resultMessage{};
+	std::vector<ColorRGB> colors{};
+
+	bool isRunning{ true };
+	while (isRunning)
+	{
+		MessageHeader header{};
+		if (!socket.Receive(&header, sizeof(header))) break;
+
+		switch (header.type)
+		{
+		case MessageType::FrameBegin:
+		{
+			if (header.size != sizeof(FrameMessage) || !socket.Receive(&frame, sizeof(frame)))
+			{
+				isRunning = false;
+				break;
+			}
+
+			if (!pScene || sceneIndex != frame.sceneIndex)
+			{
+				delete pScene;
+				sceneIndex = frame.sceneIndex;
+				pScene = CreateScene(sceneIndex);
+				if (!pScene)
+				{
+					std::cout << "Render worker doesn't know scene " << sceneIndex << std::endl;
+					isRunning = false;
+					break;
+				}
+				pScene->Initialize();
+			}
+
+			timer.SetTotal(frame.time);
+			pScene->Update(&timer);
+			pScene->CreateSnapshot(snapshot);
+
+			// The coordinator's camera follows its input, take it over as is
+			const auto& axes = frame.cameraToWorld;
+			snapshot.cameraToWorld = Matrix{
+				Vector4{ axes[0][0], axes[0][1], axes[0][2], axes[0][3] },
+				Vector4{ axes[1][0], axes[1][1], axes[1][2], axes[1][3] },
+				Vector4{ axes[2][0], axes[2][1], axes[2][2], axes[2][3] },
+				Vector4{ axes[3][0], axes[3][1], axes[3][2], axes[3][3] } };
+			snapshot.cameraOrigin = snapshot.cameraToWorld.GetTranslation();
+			snapshot.fov = frame.fov;
+
+			if (renderer.GetWidth() != frame.width || renderer.GetHeight() != frame.height)
+				renderer.SetRenderResolution(frame.width, frame.height);
+			renderer.SetLightingMode(frame.lightingMode);
+			renderer.SetShadowsActive(frame.isShadowsActive != 0);
+			renderer.SetRasterizedPrimaryVisibility(frame.isRasterizedPrimary != 0);
+			renderer.BeginFrame(snapshot);
+			break;
+		}
+		case MessageType::Tile:
+		{
+			TileMessage tile{};
+			if (!pScene || header.size != sizeof(TileMessage) || !socket.Receive(&tile, sizeof(tile)))
+			{
+				isRunning = false;
+				break;
+			}
+
+			renderer.RenderRegion(snapshot, tile.x0, tile.y0, tile.x1, tile.y1);
+
+			colors.resize(static_cast<size_t>(TileArea(tile)));
+			renderer.ReadRegion(tile.x0, tile.y0, tile.x1, tile.y1, colors.data());
+
+			// Single send per tile
+			resultMessage.clear();
+			const uint32_t colorBytes{ static_cast<uint32_t>(colors.size() * sizeof(ColorRGB)) };
+			AppendMessage(resultMessage, MessageType::TileResult, &tile, sizeof(tile));
+			reinterpret_cast<MessageHeader*>(resultMessage.data())->size += colorBytes;
+			const char* pColors{ reinterpret_cast<const char*>(colors.data()) };
+			resultMessage.insert(resultMessage.end(), pColors, pColors + colorBytes);
+
+			isRunning = socket.Send(resultMessage.data(), resultMessage.size());
+			break;
+		}
+		default: // Shutdown or garbage
+			isRunning = false;
+			break;
+		}
+	}
+
+	delete pScene;
+
+	std::cout << "Render worker stopped" << std::endl;
+	return true;
+}
+#pragma endregion
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Socket.h"
+
+namespace dae
+{
+	//Forward Declarations
+	class Renderer;
+	struct SceneSnapshot;
+
+	struct DistributedSettings
+	{
+		enum class Mode
+		{
+			Local,
+			Coordinator,
+			Worker
+		};
+
+		Mode mode{ Mode::Local };
+
+		std::string host{ "127.0.0.1" }; // coordinator address, workers only
+		uint16_t port{ 27015 };
+
+		// The coordinator waits for this many workers before the first frame, later workers join between frames
+		uint32_t expectedWorkers{ 0 };
+
+		// --coordinator [port] [--workers N] | --worker [host:port]
+		// Returns false when neither is on the command line
+		static bool ParseCommandLine(int argc, char* args[], DistributedSettings& settings);
+	};
+
+	// Splits every frame into tiles that connected RenderWorkers pull over TCP.
+	// Each worker keeps a couple of tiles in flight and gets a new one per returned tile, so faster machines simply take more of the frame.
+	// Tiles of a worker that disconnects or times out go back to the queue, the coordinator renders tiles itself as well.
+	class RenderCoordinator final
+	{
+	public:
+		explicit RenderCoordinator(uint32_t sceneIndex);
+		~RenderCoordinator(); // tells the workers to quit
+
+		RenderCoordinator(const RenderCoordinator&) = delete;
+		RenderCoordinator(RenderCoordinator&&) noexcept = delete;
+		RenderCoordinator& operator=(const RenderCoordinator&) = delete;
+		RenderCoordinator& operator=(RenderCoordinator&&) noexcept = delete;
+
+		bool Listen(uint16_t port);
+		// Accepts workers until there are at least minWorkers or timeoutMs passed, 0 only takes the ones already waiting
+		void AcceptWorkers(uint32_t minWorkers, int timeoutMs);
+
+		// Same result as renderer.Render(snapshot), call from the render thread
+		void RenderFrame(const SceneSnapshot& snapshot, Renderer& renderer);
+
+		size_t GetWorkerCount() const { return m_Workers.size(); }
+
+	private:
+		struct Tile
+		{
+			int x0, y0, x1, y1;
+		};
+
+		struct WorkerConnection
+		{
+			Socket socket{};
+			uint32_t id{};
+			uint32_t tilesRendered{}; // this frame
+		};
+
+		static constexpr int TILE_SIZE{ 64 };
+		static constexpr uint32_t MAX_TILES_IN_FLIGHT{ 2 }; // hides the round trip without hoarding tiles
+
+		const uint32_t m_SceneIndex;
+
+		Socket m_ListenSocket{};
+		std::vector<WorkerConnection> m_Workers{};
+		uint32_t m_NextWorkerId{};
+		uint32_t m_FrameIndex{};
+
+		std::mutex m_TileMutex{};
+		std::deque<Tile> m_PendingTiles{};
+
+		bool PopTile(Tile& tile);
+		void ReturnTiles(const std::vector<Tile>& tiles);
+
+		// Runs on its own thread per worker, returns false when the worker was lost
+		bool ServeWorker(WorkerConnection& worker, const std::vector<char>& frameMessage, Renderer& renderer);
+	};
+
+	// Headless render process: loads the coordinator's scene, updates it to the time of every frame and renders the tiles it is sent
+	class RenderWorker final
+	{
+	public:
+		RenderWorker() = default;
+		~RenderWorker() = default;
+
+		RenderWorker(const RenderWorker&) = delete;
+		RenderWorker(RenderWorker&&) noexcept = delete;
+		RenderWorker& operator=(const RenderWorker&) = delete;
+		RenderWorker& operator=(RenderWorker&&) noexcept = delete;
+
+		// Blocks until the coordinator shuts down or the connection is lost, false if it never connected
+		bool Run(const std::string& host, uint16_t port);
+	};
+}
@@ -0,0 +1,398 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace dae;
+
+namespace
+{
+	void AppendBigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value >> 24));
+		bytes.push_back(static_cast<uint8_t>(value >> 16));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+		bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	template<typename T>
+	void AppendLittleEndian(std::vector<uint8_t>& bytes, T value)
+	{
+		uint8_t raw[sizeof(T)];
+		std::memcpy(raw, &value, sizeof(T));
+		bytes.insert(bytes.end(), raw, raw + sizeof(T)); // all our targets are little endian
+	}
+
+	void AppendString(std::vector<uint8_t>& bytes, const char* string)
+	{
+		bytes.insert(bytes.end(), string, string + std::strlen(string) + 1);
+	}
+
+	// Same tone mapping as the screen: scale down so the brightest channel is 1
+	void ToRGB8(ColorRGB color, uint8_t* pRGB)
+	{
+		color.MaxToOne();
+		pRGB[0] = static_cast<uint8_t>(std::clamp(color.r, 0.f, 1.f) * 255);
+		pRGB[1] = static_cast<uint8_t>(std::clamp(color.g, 0.f, 1.f) * 255);
+		pRGB[2] = static_cast<uint8_t>(std::clamp(color.b, 0.f, 1.f) * 255);
+	}
+
+	uint32_t CalculateCRC32(const uint8_t* pData, size_t size)
+	{
+		static const std::array<uint32_t, 256> table = []()
+		{
+			std::array<uint32_t, 256> result{};
+			for (uint32_t n{}; n < 256; ++n)
+			{
+				uint32_t c{ n };
+				for (int k{}; k < 8; ++k)
+				{
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				result[n] = c;
+			}
+			return result;
+		}();
+
+		uint32_t crc{ 0xFFFFFFFFu };
+		for (size_t i{}; i < size; ++i)
+		{
+			crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	uint32_t CalculateAdler32(const uint8_t* pData, size_t size)
+	{
+		constexpr uint32_t modulus{ 65521 };
+		uint32_t a{ 1 };
+		uint32_t b{ 0 };
+
+		// 5552 is the largest block for which b can't overflow before the modulo
+		while (size > 0)
+		{
+			const size_t blockSize{ std::min<size_t>(size, 5552) };
+			for (size_t i{}; i < blockSize; ++i)
+			{
+				a += pData[i];
+				b += a;
+			}
+			a %= modulus;
+			b %= modulus;
+
+			pData += blockSize;
+			size -= blockSize;
+		}
+		return (b << 16) | a;
+	}
+
+	void AppendPNGChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+	{
+		AppendBigEndian(png, static_cast<uint32_t>(data.size()));
+
+		const size_t typeOffset{ png.size() };
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+
+		AppendBigEndian(png, CalculateCRC32(png.data() + typeOffset, data.size() + 4));
+	}
+
+	std::vector<uint8_t> EncodePPM(const Image& image)
+	{
+		const std::string header{ "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n" };
+
+		std::vector<uint8_t> bytes(header.begin(), header.end());
+		bytes.resize(header.size() + image.pixels.size() * 3);
+
+		uint8_t* pRGB{ bytes.data() + header.size() };
+		for (const ColorRGB& color : image.pixels)
+		{
+			ToRGB8(color, pRGB);
+			pRGB += 3;
+		}
+		return bytes;
+	}
+
+	std::vector<uint8_t> EncodePNG(const Image& image)
+	{
+		// Raw scanlines, each prefixed with filter type 0 (none)
+		const size_t rowSize{ image.width * 3ull + 1 };
+		std::vector<uint8_t> scanlines(rowSize * image.height);
+		for (uint32_t y{}; y < image.height; ++y)
+		{
+			uint8_t* pRow{ scanlines.data() + y * rowSize };
+			pRow[0] = 0;
+			for (uint32_t x{}; x < image.width; ++x)
+			{
+				ToRGB8(image.pixels[y * image.width + x], pRow + 1 + x * 3);
+			}
+		}
+
+		// zlib stream made of stored deflate blocks: trades file size for zero encode time
+		constexpr size_t maxBlockSize{ 65535 };
+		std::vector<uint8_t> zlib{ 0x78, 0x01 };
+		zlib.reserve(scanlines.size() + scanlines.size() / maxBlockSize * 5 + 16);
+
+		size_t offset{};
+		do
+		{
+			const size_t blockSize{ std::min(maxBlockSize, scanlines.size() - offset) };
+			const bool isLastBlock{ offset + blockSize == scanlines.size() };
+
+			zlib.push_back(isLastBlock ? 1 : 0);
+			zlib.push_back(static_cast<uint8_t>(blockSize));
+			zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+			zlib.push_back(static_cast<uint8_t>(~blockSize));
+			zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+
+			offset += blockSize;
+		} while (offset < scanlines.size());
+
+		AppendBigEndian(zlib, CalculateAdler32(scanlines.data(), scanlines.size()));
+
+		std::vector<uint8_t> header{};
+		AppendBigEndian(header, image.width);
+		AppendBigEndian(header, image.height);
+		header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit, truecolor, deflate, adaptive filtering, no interlace
+
+		std::vector<uint8_t> png{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		AppendPNGChunk(png, "IHDR", header);
+		AppendPNGChunk(png, "IDAT", zlib);
+		AppendPNGChunk(png, "IEND", {});
+		return png;
+	}
+
+	std::vector<uint8_t> EncodeRawVideoFrame(const Image& image)
+	{
+		std::vector<uint8_t> bytes(image.pixels.size() * 3);
+		for (size_t i{}; i < image.pixels.size(); ++i)
+		{
+			ToRGB8(image.pixels[i], bytes.data() + i * 3);
+		}
+		return bytes;
+	}
+
+	std::vector<uint8_t> EncodeEXR(const Image& image)
+	{
+		std::vector<uint8_t> exr{ 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 }; // magic, version 2, single part scanline
+
+		const auto appendAttribute = [&exr](const char* name, const char* type, const std::vector<uint8_t>& value)
+		{
+			AppendString(exr, name);
+			AppendString(exr, type);
+			AppendLittleEndian(exr, static_cast<int32_t>(value.size()));
+			exr.insert(exr.end(), value.begin(), value.end());
+		};
+
+		// Channels have to be sorted by name
+		std::vector<uint8_t> channels{};
+		for (const char* pName : { "B", "G", "R" })
+		{
+			AppendString(channels, pName);
+			AppendLittleEndian(channels, int32_t{ 2 }); // FLOAT
+			channels.insert(channels.end(), { 0, 0, 0, 0 }); // pLinear + reserved
+			AppendLittleEndian(channels, int32_t{ 1 }); // x sampling
+			AppendLittleEndian(channels, int32_t{ 1 }); // y sampling
+		}
+		channels.push_back(0);
+
+		std::vector<uint8_t> window{};
+		AppendLittleEndian(window, int32_t{ 0 });
+		AppendLittleEndian(window, int32_t{ 0 });
+		AppendLittleEndian(window, static_cast<int32_t>(image.width) - 1);
+		AppendLittleEndian(window, static_cast<int32_t>(image.height) - 1);
+
+		std::vector<uint8_t> one{};
+		AppendLittleEndian(one, 1.f);
+
+		std::vector<uint8_t> center{};
+		AppendLittleEndian(center, 0.f);
+		AppendLittleEndian(center, 0.f);
+
+		appendAttribute("channels", "chlist", channels);
+		appendAttribute("compression", "compression", { 0 }); // NO_COMPRESSION
+		appendAttribute("dataWindow", "box2i", window);
+		appendAttribute("displayWindow", "box2i", window);
+		appendAttribute("lineOrder", "lineOrder", { 0 }); // INCREASING_Y
+		appendAttribute("pixelAspectRatio", "float", one);
+		appendAttribute("screenWindowCenter", "v2f", center);
+		appendAttribute("screenWindowWidth", "float", one);
+		exr.push_back(0);
+
+		// Offset table, one scanline per block without compression
+		const uint32_t lineDataSize{ image.width * 3 * static_cast<uint32_t>(sizeof(float)) };
+		const uint64_t firstLineOffset{ exr.size() + image.height * sizeof(uint64_t) };
+		for (uint32_t y{}; y < image.height; ++y)
+		{
+			AppendLittleEndian(exr, firstLineOffset + y * (8ull + lineDataSize));
+		}
+
+		exr.reserve(exr.size() + image.height * (8ull + lineDataSize));
+		for (uint32_t y{}; y < image.height; ++y)
+		{
+			AppendLittleEndian(exr, static_cast<int32_t>(y));
+			AppendLittleEndian(exr, static_cast<int32_t>(lineDataSize));
+
+			const ColorRGB* pRow{ image.pixels.data() + y * image.width };
+			for (uint32_t x{}; x < image.width; ++x) AppendLittleEndian(exr, pRow[x].b);
+			for (uint32_t x{}; x < image.width; ++x) AppendLittleEndian(exr, pRow[x].g);
+			for (uint32_t x{}; x < image.width; ++x) AppendLittleEndian(exr, pRow[x].r);
+		}
+		return exr;
+	}
+}
+
+ImageWriter::ImageWriter(uint32_t maxQueuedImages)
+	: m_MaxQueuedImages(std::max(maxQueuedImages, 1u))
+	, m_Thread(&ImageWriter::WorkerLoop, this)
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+	CloseVideoPipe();
+
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_JobAvailable.notify_one();
+	m_Thread.join();
+}
+
+Image ImageWriter::AcquireImage(uint32_t width, uint32_t height)
+{
+	Image image{};
+	{
+		std::lock_guard lock{ m_Mutex };
+		if (!m_FreeImages.empty())
+		{
+			image = std::move(m_FreeImages.back());
+			m_FreeImages.pop_back();
+		}
+	}
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height);
+	return image;
+}
+
+void ImageWriter::Submit(Image&& image, const std::string& filename, ImageFormat format)
+{
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_JobDone.wait(lock, [this]() { return m_Jobs.size() < m_MaxQueuedImages; });
+
+		m_Jobs.push_back({ std::move(image), filename, format });
+	}
+	m_JobAvailable.notify_one();
+}
+
+void ImageWriter::Flush()
+{
+	std::unique_lock lock{ m_Mutex };
+	m_JobDone.wait(lock, [this]() { return m_Jobs.empty() && !m_IsWriting; });
+}
+
+bool ImageWriter::OpenVideoPipe(const std::string& command)
+{
+	CloseVideoPipe();
+
+#if defined(_WIN32)
+	m_pVideoPipe = _popen(command.c_str(), "wb");
+#else
+	m_pVideoPipe = popen(command.c_str(), "w");
+#endif
+	return m_pVideoPipe != nullptr;
+}
+
+void ImageWriter::CloseVideoPipe()
+{
+	if (!m_pVideoPipe) return;
+
+	Flush();
+
+#if defined(_WIN32)
+	_pclose(m_pVideoPipe);
+#else
+	pclose(m_pVideoPipe);
+#endif
+	m_pVideoPipe = nullptr;
+}
+
+bool ImageWriter::Write(const Image& image, const std::string& filename, ImageFormat format)
+{
+	std::vector<uint8_t> bytes{};
+	switch (format)
+	{
+	case ImageFormat::PPM:
+		bytes = EncodePPM(image);
+		break;
+	case ImageFormat::PNG:
+		bytes = EncodePNG(image);
+		break;
+	case ImageFormat::EXR:
+		bytes = EncodeEXR(image);
+		break;
+	case ImageFormat::RawVideo:
+		return false; // not a file format
+	}
+
+	std::ofstream file{ filename, std::ios::binary };
+	if (!file) return false;
+
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return file.good();
+}
+
+ImageFormat ImageWriter::GetFormatFromExtension(const std::string& filename)
+{
+	const std::string extension{ filename.substr(filename.find_last_of('.') + 1) };
+	if (extension == "ppm") return ImageFormat::PPM;
+	if (extension == "exr") return ImageFormat::EXR;
+	return ImageFormat::PNG;
+}
+
+void ImageWriter::WorkerLoop()
+{
+	while (true)
+	{
+		Job job{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_JobAvailable.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+
+			if (m_IsStopping && m_Jobs.empty()) return;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+			m_IsWriting = true;
+		}
+		m_JobDone.notify_all(); // a queue slot opened up
+
+		if (job.format == ImageFormat::RawVideo)
+		{
+			const std::vector<uint8_t> bytes{ EncodeRawVideoFrame(job.image) };
+			if (!m_pVideoPipe || std::fwrite(bytes.data(), 1, bytes.size(), m_pVideoPipe) != bytes.size())
+			{
+				std::cout << "Something went wrong. Video frame not written!" << std::endl;
+			}
+		}
+		else if (!Write(job.image, job.filename, job.format))
+		{
+			std::cout << "Something went wrong. " << job.filename << " not saved!" << std::endl;
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsWriting = false;
+			m_FreeImages.push_back(std::move(job.image));
+		}
+		m_JobDone.notify_all();
+	}
+}
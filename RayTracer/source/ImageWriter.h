@@ -0,0 +1,87 @@
+#pragma once
+
+//Standard includes
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		PPM, // binary P6, 8-bit
+		PNG, // 8-bit RGB, stored (uncompressed) deflate blocks
+		EXR, // 32-bit float RGB scanlines, unclamped radiance
+		RawVideo // 8-bit RGB frames written back to back to the video pipe, see OpenVideoPipe
+	};
+
+	// Linear, unclamped frame as produced by the renderer
+	struct Image
+	{
+		uint32_t width{};
+		uint32_t height{};
+		std::vector<ColorRGB> pixels{};
+	};
+
+	// Encodes and writes images on its own thread. Submit hands a frame over and returns immediately,
+	// unless the queue is full: then it blocks until the disk catches up (back-pressure instead of unbounded memory).
+	class ImageWriter final
+	{
+	public:
+		explicit ImageWriter(uint32_t maxQueuedImages = 4);
+		~ImageWriter(); // writes everything still queued
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter(ImageWriter&&) noexcept = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+		ImageWriter& operator=(ImageWriter&&) noexcept = delete;
+
+		// Recycled image storage, so dumping every frame doesn't allocate
+		Image AcquireImage(uint32_t width, uint32_t height);
+		void Submit(Image&& image, const std::string& filename, ImageFormat format);
+
+		// Blocks until every submitted image is on disk
+		void Flush();
+
+		// Starts a process that reads raw rgb24 frames on stdin, e.g.
+		// ffmpeg -f rawvideo -pix_fmt rgb24 -s 1280x720 -r 30 -i - -pix_fmt yuv420p turntable.mp4
+		bool OpenVideoPipe(const std::string& command);
+		// Waits for the queued frames and lets the process finish
+		void CloseVideoPipe();
+		void SubmitVideoFrame(Image&& image) { Submit(std::move(image), {}, ImageFormat::RawVideo); }
+
+		static bool Write(const Image& image, const std::string& filename, ImageFormat format);
+		static ImageFormat GetFormatFromExtension(const std::string& filename);
+
+	private:
+		struct Job
+		{
+			Image image{};
+			std::string filename{};
+			ImageFormat format{};
+		};
+
+		void WorkerLoop();
+
+		std::deque<Job> m_Jobs{};
+		std::vector<Image> m_FreeImages{};
+		uint32_t m_MaxQueuedImages{};
+		bool m_IsWriting{ false };
+		bool m_IsStopping{ false };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_JobAvailable{};
+		std::condition_variable m_JobDone{};
+
+		FILE* m_pVideoPipe{ nullptr }; // only touched by the worker while frames are queued
+
+		std::thread m_Thread{};
+	};
+}
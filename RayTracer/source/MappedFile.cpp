@@ -0,0 +1,157 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pView)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_MappingHandle = mapping;
+	m_pData = static_cast<const uint8_t*>(pView);
+	m_Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int fileDescriptor = open(filename.c_str(), O_RDONLY);
+	if (fileDescriptor < 0) return false;
+
+	struct stat fileStat{};
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+
+	void* pView = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (pView == MAP_FAILED)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+
+	// BVH traversal jumps all over the file, sequential read-ahead would only waste memory
+	madvise(pView, static_cast<size_t>(fileStat.st_size), MADV_RANDOM);
+
+	m_FileDescriptor = fileDescriptor;
+	m_pData = static_cast<const uint8_t*>(pView);
+	m_Size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!m_pData) return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_pData);
+	CloseHandle(m_MappingHandle);
+	CloseHandle(m_FileHandle);
+	m_MappingHandle = nullptr;
+	m_FileHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_pData), m_Size);
+	close(m_FileDescriptor);
+	m_FileDescriptor = -1;
+#endif
+
+	m_pData = nullptr;
+	m_Size = 0;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	AlignRange(offset, size);
+	if (size == 0) return;
+
+#if defined(_WIN32)
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<uint8_t*>(m_pData + offset), size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	madvise(const_cast<uint8_t*>(m_pData + offset), size, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::Release(size_t offset, size_t size) const
+{
+	AlignRange(offset, size);
+	if (size == 0) return;
+
+#if defined(_WIN32)
+	// Unlocking pages that aren't locked removes them from the working set (they stay in the standby list)
+	VirtualUnlock(const_cast<uint8_t*>(m_pData + offset), size);
+#else
+	// Clean file backed pages, dropping them is safe even while another thread reads them
+	madvise(const_cast<uint8_t*>(m_pData + offset), size, MADV_DONTNEED);
+#endif
+}
+
+size_t MappedFile::GetPageSize()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO systemInfo{};
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwPageSize;
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+void MappedFile::AlignRange(size_t& offset, size_t& size) const
+{
+	static const size_t pageSize{ GetPageSize() };
+
+	if (offset >= m_Size)
+	{
+		size = 0;
+		return;
+	}
+
+	const size_t end = std::min(offset + size, m_Size);
+	offset -= offset % pageSize;
+	size = end - offset;
+}
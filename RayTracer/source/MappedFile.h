@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	// Read-only memory mapping of a whole file (MapViewOfFile on Windows, mmap elsewhere).
+	// Pages are loaded by the OS on first access, Release hands them back so the resident set stays bounded.
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		bool Open(const std::string& filename);
+		void Close();
+
+		bool IsOpen() const { return m_pData != nullptr; }
+		const uint8_t* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+		// Hints the OS to start reading the range in the background
+		void Prefetch(size_t offset, size_t size) const;
+
+		// Drops the range from the working set, the next access pages it back in from the file
+		void Release(size_t offset, size_t size) const;
+
+		static size_t GetPageSize();
+
+	private:
+		const uint8_t* m_pData{ nullptr };
+		size_t m_Size{};
+
+#if defined(_WIN32)
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+#else
+		int m_FileDescriptor{ -1 };
+#endif
+
+		// Rounds the range outwards to whole pages
+		void AlignRange(size_t& offset, size_t& size) const;
+	};
+}
@@ -0,0 +1,102 @@
+#include "Recorder.h"
+#include "ImageWriter.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+using namespace dae;
+
+bool RecordingSettings::ParseCommandLine(int argc, char* args[], RecordingSettings& settings)
+{
+	bool isRecording{ false };
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (argument == "--record")
+			isRecording = true;
+		else if (argument == "--frames" && hasValue)
+			settings.frameCount = static_cast<uint32_t>(std::stoul(args[++i]));
+		else if (argument == "--fps" && hasValue)
+			settings.framesPerSecond = std::stof(args[++i]);
+		else if (argument == "--size" && hasValue)
+			std::sscanf(args[++i], "%dx%d", &settings.width, &settings.height);
+		else if (argument == "--output" && hasValue)
+			settings.outputPattern = args[++i];
+		else if (argument == "--pipe" && hasValue)
+			settings.pipeCommand = args[++i];
+	}
+
+	return isRecording;
+}
+
+Recorder::Recorder(const RecordingSettings& settings, ImageWriter& imageWriter)
+	: m_Settings(settings)
+	, m_ImageWriter(imageWriter)
+{
+}
+
+bool Recorder::Begin(Timer& timer, Renderer& renderer, Scene& scene)
+{
+	if (!m_Settings.pipeCommand.empty())
+	{
+		if (!m_ImageWriter.OpenVideoPipe(m_Settings.pipeCommand))
+		{
+			std::cout << "Failed to start video pipe: " << m_Settings.pipeCommand << std::endl;
+			return false;
+		}
+	}
+	else
+	{
+		const std::filesystem::path directory{ std::filesystem::path{ m_Settings.outputPattern }.parent_path() };
+		if (!directory.empty())
+		{
+			std::error_code error{};
+			std::filesystem::create_directories(directory, error);
+		}
+	}
+
+	timer.SetFixedTimestep(1.f / m_Settings.framesPerSecond);
+	renderer.SetRenderResolution(m_Settings.width, m_Settings.height);
+	scene.SetFollowCameraPath(true);
+
+	std::cout << "**RECORDING STARTED** " << m_Settings.frameCount << " frames at " << m_Settings.width << "x" << m_Settings.height << std::endl;
+	return true;
+}
+
+bool Recorder::SubmitFrame(const Renderer& renderer)
+{
+	if (m_FrameIndex >= m_Settings.frameCount) return false;
+
+	Image frame{ m_ImageWriter.AcquireImage(static_cast<uint32_t>(m_Settings.width), static_cast<uint32_t>(m_Settings.height)) };
+	renderer.CaptureFrame(frame);
+
+	if (!m_Settings.pipeCommand.empty())
+	{
+		m_ImageWriter.SubmitVideoFrame(std::move(frame));
+	}
+	else
+	{
+		char filename[512]{};
+		std::snprintf(filename, sizeof(filename), m_Settings.outputPattern.c_str(), m_FrameIndex);
+		m_ImageWriter.Submit(std::move(frame), filename, ImageWriter::GetFormatFromExtension(filename));
+	}
+
+	++m_FrameIndex;
+	return m_FrameIndex < m_Settings.frameCount;
+}
+
+void Recorder::End(Timer& timer)
+{
+	m_ImageWriter.CloseVideoPipe();
+	m_ImageWriter.Flush();
+	timer.ClearFixedTimestep();
+
+	std::cout << "**RECORDING FINISHED** " << m_FrameIndex << " frames" << std::endl;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Forward Declarations
+	class Timer;
+	class Renderer;
+	class Scene;
+	class ImageWriter;
+
+	struct RecordingSettings
+	{
+		uint32_t frameCount{ 240 };
+		float framesPerSecond{ 30.f };
+
+		int width{ 1280 };
+		int height{ 720 };
+
+		// printf style pattern, the extension picks the format (png, ppm, exr)
+		std::string outputPattern{ "Recording/frame_%04d.png" };
+
+		// When set, frames are piped as raw rgb24 to this command instead of written as images
+		std::string pipeCommand{};
+
+		// --record [--frames 240] [--fps 30] [--size 1280x720] [--output Recording/frame_%04d.png] [--pipe "ffmpeg ..."]
+		// Returns false when --record isn't on the command line
+		static bool ParseCommandLine(int argc, char* args[], RecordingSettings& settings);
+	};
+
+	// Offline turntable/path renders: fixed timestep, camera driven by the scene's CameraPath,
+	// frames handed to the ImageWriter so encoding overlaps with rendering the next frame
+	class Recorder final
+	{
+	public:
+		Recorder(const RecordingSettings& settings, ImageWriter& imageWriter);
+		~Recorder() = default;
+
+		Recorder(const Recorder&) = delete;
+		Recorder(Recorder&&) noexcept = delete;
+		Recorder& operator=(const Recorder&) = delete;
+		Recorder& operator=(Recorder&&) noexcept = delete;
+
+		// Call before the first frame is snapshotted
+		bool Begin(Timer& timer, Renderer& renderer, Scene& scene);
+		// Call after every finished frame, returns false once all frames are submitted
+		bool SubmitFrame(const Renderer& renderer);
+		// Waits for the writer and restores the timer
+		void End(Timer& timer);
+
+		uint32_t GetFrameIndex() const { return m_FrameIndex; }
+
+	private:
+		RecordingSettings m_Settings;
+		ImageWriter& m_ImageWriter;
+
+		uint32_t m_FrameIndex{};
+	};
+}
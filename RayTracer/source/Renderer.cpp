@@ -7,82 +7,312 @@
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
-#include "Scene.h"
+#include "SceneSnapshot.h"
+#include "ImageWriter.h"
+#include "ThreadPool.h"
 #include "Utils.h"
+#include "VisibilityBuffer.h"
 
 #include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <execution>
 #include <ranges>
 
 #define PARALLEL_EXECUTION
+#define SHADOW_OCCLUDER_CACHE
+#define SHADOW_PACKETS
+
+// Pixels per tile side, the shadow rays of a tile toward a point light are traced as one packet
+#define TILE_SIZE 8
 
 using namespace dae;
 
+#ifdef SHADOW_OCCLUDER_CACHE
+constexpr bool isOccluderCacheActive{ true };
+#else
+constexpr bool isOccluderCacheActive{ false };
+#endif
+
+namespace
+{
+	// Source of Renderer::m_Id, 0 is left to the thread caches that haven't seen a renderer yet
+	std::atomic<uint32_t> g_NextRendererId{ 1 };
+
+	// Per pixel rotation of the area light sample grid (Cranley-Patterson), turns banding into noise while a static
+	// camera still renders the same image every frame. Keyed on the view ray.
+	void GetSampleRotation(const Vector3& viewDirection, float& u, float& v)
+	{
+		uint32_t bits[3]{};
+		std::memcpy(bits, &viewDirection.x, sizeof(float));
+		std::memcpy(bits + 1, &viewDirection.y, sizeof(float));
+		std::memcpy(bits + 2, &viewDirection.z, sizeof(float));
+
+		uint32_t hash{ bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u };
+		hash ^= hash >> 16;
+		hash *= 0x7FEB352Du;
+		hash ^= hash >> 15;
+		hash *= 0x846CA68Bu;
+		hash ^= hash >> 16;
+
+		u = static_cast<float>(hash & 0xFFFFu) / 65536.f;
+		v = static_cast<float>(hash >> 16) / 65536.f;
+	}
+}
+
+struct Renderer::ShadowOccluderCache
+{
+	uint32_t rendererId{};
+	uint32_t renderPass{};
+	std::vector<ShadowOccluder> occluders{}; // one per light
+
+	// Not reported to pRenderer yet
+	uint64_t shadowRays{};
+	uint64_t blockedRays{};
+	uint64_t cacheHits{};
+};
+
 Renderer::Renderer(SDL_Window * pWindow) :
+	m_Id{ g_NextRendererId.fetch_add(1, std::memory_order_relaxed) },
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow)),
 	m_IsShadowsActive{true},
 	m_CurrentLightingMode{LightingMode::Combined}
 {
 	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	int width{}, height{};
+	SDL_GetWindowSize(pWindow, &width, &height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 
-	// Window data
-	m_InvWidth =  1.0f / m_Width ;
-	m_InvHeight =  1.0f / m_Height ;
-	m_AspectRatio = static_cast<float>(m_Width) * m_InvHeight;
+	SetRenderResolution(width, height);
+	SelectColorKernel();
 
 	// Materials
 
 }
 
-void Renderer::Render(Scene* pScene) const
+Renderer::Renderer(int width, int height) :
+	m_Id{ g_NextRendererId.fetch_add(1, std::memory_order_relaxed) },
+	m_IsShadowsActive{true},
+	m_CurrentLightingMode{LightingMode::Combined}
+{
+	SetRenderResolution(width, height);
+	SelectColorKernel();
+}
+
+Renderer::~Renderer()
 {
-	Camera& camera = pScene->GetCamera();
-	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
-	uint32_t amountOfPixels{ static_cast<uint32_t>(m_Width * m_Height) };
+	delete m_pThreadPool;
+	delete m_pVisibilityBuffer;
+}
 
-	const float fov = camera.fov;
+void Renderer::Render(const SceneSnapshot& snapshot)
+{
+	BeginFrame(snapshot);
+	RenderRegion(snapshot, 0, 0, m_Width, m_Height);
+}
+
+void Renderer::BeginFrame(const SceneSnapshot& snapshot)
+{
+	if (m_IsRasterizedPrimaryActive)
+	{
+		if (!m_pVisibilityBuffer) m_pVisibilityBuffer = new VisibilityBuffer();
+		m_pVisibilityBuffer->Setup(snapshot, m_Width, m_Height, m_AspectRatio);
+	}
+}
+
+void Renderer::RenderRegion(const SceneSnapshot& snapshot, int x0, int y0, int x1, int y1)
+{
+	++m_RenderPass;
+
+	const uint32_t regionWidth{ static_cast<uint32_t>(x1 - x0) };
+
+	if (m_IsRasterizedPrimaryActive)
+	{
+		assert(m_pVisibilityBuffer && "BeginFrame must set up the visibility buffer before RenderRegion");
+		m_pVisibilityBuffer->Rasterize(x0, y0, x1, y1, m_ThreadCount > 0 ? m_pThreadPool : nullptr);
+	}
 
 	//Render pixel executions	
 
+#ifdef SHADOW_PACKETS
+	const uint32_t tilesX{ (regionWidth + TILE_SIZE - 1) / TILE_SIZE };
+	const uint32_t tilesY{ (static_cast<uint32_t>(y1 - y0) + TILE_SIZE - 1) / TILE_SIZE };
+	const uint32_t amountOfTiles{ tilesX * tilesY };
+
+	const auto renderTile = [&](uint32_t tileIndex)
+	{
+		const int tileX0{ x0 + static_cast<int>(tileIndex % tilesX) * TILE_SIZE };
+		const int tileY0{ y0 + static_cast<int>(tileIndex / tilesX) * TILE_SIZE };
+		RenderTile(snapshot, tileX0, tileY0, std::min(tileX0 + TILE_SIZE, x1), std::min(tileY0 + TILE_SIZE, y1));
+	};
+
+	if (m_ThreadCount > 0)
+	{
+		// Fixed thread count
+		const auto renderRange = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				renderTile(i);
+			}
+		};
+
+		if (m_pThreadPool)
+			m_pThreadPool->ParallelFor(amountOfTiles, 4, renderRange);
+		else
+			renderRange(0, amountOfTiles);
+		return;
+	}
+
+#ifdef PARALLEL_EXECUTION
+	auto tileIndices = std::views::iota(0u, amountOfTiles);
+	std::for_each(std::execution::par, tileIndices.begin(), tileIndices.end(), renderTile);
+#else
+	for (uint32_t i{}; i < amountOfTiles; ++i)
+	{
+		renderTile(i);
+	}
+#endif
+#else
+	const Matrix& cameraToWorld = snapshot.cameraToWorld;
+	const uint32_t amountOfPixels{ regionWidth * static_cast<uint32_t>(y1 - y0) };
+
+	const float fov = snapshot.fov;
+
+	// region index to buffer index
+	const auto toPixelIndex = [&](uint32_t i)
+	{
+		return (y0 + i / regionWidth) * m_Width + x0 + i % regionWidth;
+	};
+
+	if (m_ThreadCount > 0)
+	{
+		// Fixed thread count
+		const auto renderRange = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				RenderPixel(snapshot, toPixelIndex(i), fov, m_AspectRatio, cameraToWorld, snapshot.cameraOrigin);
+			}
+		};
+
+		if (m_pThreadPool)
+			m_pThreadPool->ParallelFor(amountOfPixels, 256, renderRange);
+		else
+			renderRange(0, amountOfPixels);
+		return;
+	}
+
 #ifdef PARALLEL_EXECUTION
 	// parallel logic	
 	auto pixelIndices = std::views::iota(0u, amountOfPixels); //https://en.cppreference.com/w/cpp/ranges/iota_view
 
-	std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](int i) 
+	std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](uint32_t i) 
 	{
-		RenderPixel(pScene, i, fov, m_AspectRatio, cameraToWorld, camera.origin);
+		RenderPixel(snapshot, toPixelIndex(i), fov, m_AspectRatio, cameraToWorld, snapshot.cameraOrigin);
 	});
 #else
 	// synchronous logic
-	for (uint32_t pixelIndex{}; pixelIndex < amountOfPixels; ++pixelIndex)
+	for (uint32_t i{}; i < amountOfPixels; ++i)
 	{
-		RenderPixel(pScene, pixelIndex, fov, m_AspectRatio, cameraToWorld, camera.origin);
+		RenderPixel(snapshot, toPixelIndex(i), fov, m_AspectRatio, cameraToWorld, snapshot.cameraOrigin);
 	}
 
 #endif
+#endif
+}
+
+void Renderer::RenderTile(const SceneSnapshot& snapshot, int x0, int y0, int x1, int y1)
+{
+	if (m_pShadowTileKernel)
+	{
+		(this->*m_pShadowTileKernel)(snapshot, x0, y0, x1, y1);
+		return;
+	}
+
+	for (int y{ y0 }; y < y1; ++y)
+	{
+		for (int x{ x0 }; x < x1; ++x)
+		{
+			RenderPixel(snapshot, static_cast<uint32_t>(x + y * m_Width), snapshot.fov, m_AspectRatio, snapshot.cameraToWorld, snapshot.cameraOrigin);
+		}
+	}
+}
+
+void Renderer::SetRenderResolution(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+
+	// Window data
+	m_InvWidth =  1.0f / m_Width ;
+	m_InvHeight =  1.0f / m_Height ;
+	m_AspectRatio = static_cast<float>(m_Width) * m_InvHeight;
+
+	m_BackBuffer.resize(static_cast<size_t>(m_Width) * m_Height);
+	m_ColorBuffer.resize(static_cast<size_t>(m_Width) * m_Height);
+}
+
+void Renderer::SetThreadCount(uint32_t threadCount)
+{
+	delete m_pThreadPool;
+	m_pThreadPool = nullptr;
+
+	m_ThreadCount = threadCount;
+	if (threadCount > 1)
+		m_pThreadPool = new ThreadPool(threadCount - 1);
+}
+
+void Renderer::Present()
+{
+	if (m_Width == m_pBuffer->w && m_Height == m_pBuffer->h)
+	{
+		std::memcpy(m_pBufferPixels, m_BackBuffer.data(), m_BackBuffer.size() * sizeof(uint32_t));
+	}
+	else
+	{
+		// Render resolution differs from the window (recording), show a nearest neighbour preview
+		for (int y{}; y < m_pBuffer->h; ++y)
+		{
+			const int sourceY{ y * m_Height / m_pBuffer->h };
+			for (int x{}; x < m_pBuffer->w; ++x)
+			{
+				m_pBufferPixels[x + y * m_pBuffer->w] = m_BackBuffer[x * m_Width / m_pBuffer->w + sourceY * m_Width];
+			}
+		}
+	}
+
 	SDL_UpdateWindowSurface(m_pWindow);
 }
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectratio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const 
+
+void dae::Renderer::RenderPixel(const SceneSnapshot& snapshot, uint32_t pixelIndex, float fov, float aspectratio, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
 {
-	auto& materials = pScene->GetMaterials();
-	auto& lights = pScene->GetLights();
+	auto& materials = snapshot.GetMaterials();
+	auto& lights = snapshot.lights;
 
 	uint32_t px, py;
 	Vector3 rayDirection;
 	CalculatePixelCoordinates(pixelIndex, fov, aspectratio, cameraToWorld, px, py, rayDirection);
 
 	Ray viewRay(cameraOrigin, rayDirection);
-	ColorRGB finalColor = CalculateColor(pScene, viewRay, materials, lights);
+	ColorRGB finalColor = (this->*m_pColorKernel)(snapshot, viewRay, px + (py * m_Width), materials, lights);
 
 	// Update Color in Buffer
-	finalColor.MaxToOne();
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	StorePixel(px + (py * m_Width), finalColor);
+}
+
+void Renderer::StorePixel(uint32_t pixelIndex, ColorRGB color)
+{
+	m_ColorBuffer[pixelIndex] = color;
+	color.MaxToOne();
+
+	const uint8_t r{ static_cast<uint8_t>(color.r * 255) };
+	const uint8_t g{ static_cast<uint8_t>(color.g * 255) };
+	const uint8_t b{ static_cast<uint8_t>(color.b * 255) };
+
+	// Headless renderers have no surface format, they only hand out m_ColorBuffer anyway
+	m_BackBuffer[pixelIndex] = m_pBuffer ? SDL_MapRGB(m_pBuffer->format, r, g, b) : (0xFF000000u | r << 16 | g << 8 | b);
 }
 
 
@@ -99,14 +329,91 @@ void Renderer::CalculatePixelCoordinates(uint32_t pixelIndex, float fov, float a
 	rayDirection = cameraToWorld.TransformVector(rayDirection);
 }
 
-ColorRGB Renderer::CalculateColor(Scene* pScene, const Ray& viewRay, const std::vector<Material*>& materials, const std::vector<Light>& lights) const 
+ColorRGB Renderer::CalculateColor(const SceneSnapshot& snapshot, const Ray& viewRay, const std::vector<Material*>& materials, const std::vector<Light>& lights) const 
+{
+	return (this->*m_pColorKernel)(snapshot, viewRay, UINT32_MAX, materials, lights);
+}
+
+float Renderer::SampleAreaLightVisibility(const SceneSnapshot& snapshot, const Light& light, const Vector3& origin, const Vector3& viewDirection, const ShadowPacket* pPacket, ShadowOccluder& occluder, ShadowOccluderCache* pShadowCache) const
+{
+	constexpr int probeGridSize{ 2 };
+	constexpr int penumbraGridSize{ 4 };
+	constexpr int probeCount{ probeGridSize * probeGridSize };
+
+	const int visibleProbes{ TraceAreaLightSamples(snapshot, light, origin, viewDirection, probeGridSize, pPacket, occluder, pShadowCache) };
+	if (visibleProbes == 0) return 0.f;
+	if (visibleProbes == probeCount) return 1.f;
+
+	const int visibleSamples{ TraceAreaLightSamples(snapshot, light, origin, viewDirection, penumbraGridSize, pPacket, occluder, pShadowCache) };
+	return static_cast<float>(visibleProbes + visibleSamples) / static_cast<float>(probeCount + penumbraGridSize * penumbraGridSize);
+}
+
+int Renderer::TraceAreaLightSamples(const SceneSnapshot& snapshot, const Light& light, const Vector3& origin, const Vector3& viewDirection, int gridSize, const ShadowPacket* pPacket, ShadowOccluder& occluder, ShadowOccluderCache* pShadowCache) const
+{
+	float rotationU{}, rotationV{};
+	GetSampleRotation(viewDirection, rotationU, rotationV);
+
+	const float strataSize{ 1.f / gridSize };
+	int visibleCount{};
+	for (int sampleY{}; sampleY < gridSize; ++sampleY)
+	{
+		for (int sampleX{}; sampleX < gridSize; ++sampleX)
+		{
+			const Vector3 samplePoint{ LightUtils::GetAreaLightSample(light, origin, (sampleX + rotationU) * strataSize, (sampleY + rotationV) * strataSize) };
+
+			Ray lightRay{};
+			lightRay.direction = samplePoint - origin;
+			lightRay.max = lightRay.direction.Normalize();
+			lightRay.origin = origin;
+
+			if (pShadowCache)
+			{
+				++pShadowCache->shadowRays;
+				if (snapshot.DoesHitOccluder(lightRay, occluder))
+				{
+					++pShadowCache->blockedRays;
+					++pShadowCache->cacheHits;
+					continue;
+				}
+			}
+
+			if (pPacket ? snapshot.DoesHit(lightRay, *pPacket, occluder) : snapshot.DoesHit(lightRay, occluder))
+			{
+				if (pShadowCache) ++pShadowCache->blockedRays;
+				continue;
+			}
+
+			++visibleCount;
+		}
+	}
+
+	return visibleCount;
+}
+
+void Renderer::GetPrimaryHit(const SceneSnapshot& snapshot, const Ray& viewRay, uint32_t pixelIndex, HitRecord& closestHit) const
+{
+	if (m_IsRasterizedPrimaryActive && pixelIndex != UINT32_MAX)
+	{
+		m_pVisibilityBuffer->GetClosestHit(snapshot, pixelIndex, viewRay, closestHit);
+		return;
+	}
+
+	snapshot.GetClosestHit(viewRay, closestHit);
+}
+
+template<Renderer::LightingMode lightingMode, bool isShadowsActive>
+ColorRGB Renderer::CalculateColorKernel(const SceneSnapshot& snapshot, const Ray& viewRay, uint32_t pixelIndex, const std::vector<Material*>& materials, const std::vector<Light>& lights) const
 {
 	ColorRGB finalColor{};
 	HitRecord closestHit{};
-	pScene->GetClosestHit(viewRay, closestHit);
+	GetPrimaryHit(snapshot, viewRay, pixelIndex, closestHit);
 
 	if (closestHit.didHit) {
-		for (const auto& light : lights) {
+		ShadowOccluderCache* pShadowCache{};
+		if constexpr (isShadowsActive && isOccluderCacheActive) pShadowCache = &AcquireShadowOccluderCache(lights.size());
+
+		for (size_t lightIndex{}; lightIndex < lights.size(); ++lightIndex) {
+			const Light& light = lights[lightIndex];
 			Vector3 lightRayDirection = LightUtils::GetDirectionToLight(light, closestHit.origin);
 			Ray lightRay;
 			lightRay.max = lightRayDirection.Normalize();
@@ -115,43 +422,301 @@ ColorRGB Renderer::CalculateColor(Scene* pScene, const Ray& viewRay, const std::
 
 			const float lambertCosLaw = Vector3::Dot(closestHit.normal, lightRayDirection);
 			if (lambertCosLaw < 0) continue;
-			if (m_IsShadowsActive && pScene->DoesHit(lightRay)) continue;
-
-			const ColorRGB BRDFrgb = materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, -viewRay.direction);
-
-			switch (m_CurrentLightingMode) {
-			case dae::Renderer::LightingMode::ObservedArea:
-				finalColor += ColorRGB{ lambertCosLaw, lambertCosLaw, lambertCosLaw };
-				break;
-			case dae::Renderer::LightingMode::Radiance:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin);
-				break;
-			case dae::Renderer::LightingMode::BRDF:
-				finalColor += BRDFrgb;
-				break;
-			case dae::Renderer::LightingMode::Combined:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin) * BRDFrgb * lambertCosLaw;
-				break;
-			default:
-				break;
+			if constexpr (isShadowsActive)
+			{
+				if (light.IsAreaLight())
+				{
+					ShadowOccluder uncachedOccluder{};
+					ShadowOccluder& occluder = pShadowCache ? pShadowCache->occluders[lightIndex] : uncachedOccluder;
+
+					const float visibility{ SampleAreaLightVisibility(snapshot, light, lightRay.origin, viewRay.direction, nullptr, occluder, pShadowCache) };
+					if (visibility <= 0.f) continue;
+
+					const ColorRGB contribution{ ShadeLight<lightingMode>(closestHit, light, lightRayDirection, lambertCosLaw, viewRay, materials) };
+					finalColor += contribution * visibility;
+					continue;
+				}
 			}
+			if constexpr (isShadowsActive && isOccluderCacheActive)
+			{
+				// The cached occluder first, the whole scene only when it doesn't block this ray
+				ShadowOccluder& occluder = pShadowCache->occluders[lightIndex];
+				++pShadowCache->shadowRays;
+				if (snapshot.DoesHitOccluder(lightRay, occluder))
+				{
+					++pShadowCache->blockedRays;
+					++pShadowCache->cacheHits;
+					continue;
+				}
+				if (snapshot.DoesHit(lightRay, occluder))
+				{
+					++pShadowCache->blockedRays;
+					continue;
+				}
+			}
+			else if constexpr (isShadowsActive)
+			{
+				if (snapshot.DoesHit(lightRay)) continue;
+			}
+
+			finalColor += ShadeLight<lightingMode>(closestHit, light, lightRayDirection, lambertCosLaw, viewRay, materials);
 		}
 	}
 
 	return finalColor;
 }
 
+template<Renderer::LightingMode lightingMode>
+ColorRGB Renderer::ShadeLight(const HitRecord& closestHit, const Light& light, const Vector3& lightRayDirection, float lambertCosLaw, const Ray& viewRay, const std::vector<Material*>& materials) const
+{
+	// Only the terms of the mode get evaluated, ObservedArea and Radiance skip the BRDF altogether
+	if constexpr (lightingMode == LightingMode::ObservedArea)
+	{
+		return ColorRGB{ lambertCosLaw, lambertCosLaw, lambertCosLaw };
+	}
+	else if constexpr (lightingMode == LightingMode::Radiance)
+	{
+		return LightUtils::GetRadiance(light, closestHit.origin);
+	}
+	else if constexpr (lightingMode == LightingMode::BRDF)
+	{
+		return materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, -viewRay.direction);
+	}
+	else
+	{
+		const ColorRGB BRDFrgb = materials[closestHit.materialIndex]->Shade(closestHit, lightRayDirection, -viewRay.direction);
+		return LightUtils::GetRadiance(light, closestHit.origin) * BRDFrgb * lambertCosLaw;
+	}
+}
+
+template<Renderer::LightingMode lightingMode>
+void Renderer::RenderShadowTileKernel(const SceneSnapshot& snapshot, int x0, int y0, int x1, int y1)
+{
+	constexpr int maxTilePixels{ TILE_SIZE * TILE_SIZE };
+
+	const std::vector<Material*>& materials = snapshot.GetMaterials();
+	const std::vector<Light>& lights = snapshot.lights;
+
+	// Primary hits of the whole tile first, the shadow rays are then traced light by light
+	uint32_t pixelIndices[maxTilePixels];
+	Ray viewRays[maxTilePixels];
+	HitRecord closestHits[maxTilePixels];
+	ColorRGB colors[maxTilePixels];
+	int pixelCount{};
+
+	for (int y{ y0 }; y < y1; ++y)
+	{
+		for (int x{ x0 }; x < x1; ++x)
+		{
+			uint32_t px, py;
+			Vector3 rayDirection;
+			CalculatePixelCoordinates(static_cast<uint32_t>(x + y * m_Width), snapshot.fov, m_AspectRatio, snapshot.cameraToWorld, px, py, rayDirection);
+
+			pixelIndices[pixelCount] = px + py * m_Width;
+			viewRays[pixelCount] = Ray(snapshot.cameraOrigin, rayDirection);
+			closestHits[pixelCount] = HitRecord{};
+			GetPrimaryHit(snapshot, viewRays[pixelCount], pixelIndices[pixelCount], closestHits[pixelCount]);
+			colors[pixelCount] = ColorRGB{};
+			++pixelCount;
+		}
+	}
+
+	ShadowOccluderCache* pShadowCache{};
+	if constexpr (isOccluderCacheActive) pShadowCache = &AcquireShadowOccluderCache(lights.size());
+
+	thread_local ShadowPacket packet{};
+
+	// Shadow rays toward the current light, the same setup as CalculateColorKernel
+	Ray lightRays[maxTilePixels];
+	Vector3 lightRayOrigins[maxTilePixels];
+	float lambertCosLaws[maxTilePixels];
+	int rayPixels[maxTilePixels];
+
+	for (size_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+	{
+		const Light& light = lights[lightIndex];
+
+		int rayCount{};
+		for (int i{}; i < pixelCount; ++i)
+		{
+			const HitRecord& closestHit = closestHits[i];
+			if (!closestHit.didHit) continue;
+
+			Vector3 lightRayDirection = LightUtils::GetDirectionToLight(light, closestHit.origin);
+			Ray& lightRay = lightRays[rayCount];
+			lightRay = Ray{};
+			lightRay.max = lightRayDirection.Normalize();
+			lightRay.origin = closestHit.origin + closestHit.normal * 0.0001f;
+			lightRay.direction = lightRayDirection;
+
+			const float lambertCosLaw = Vector3::Dot(closestHit.normal, lightRayDirection);
+			if (lambertCosLaw < 0) continue;
+
+			lightRayOrigins[rayCount] = lightRay.origin;
+			lambertCosLaws[rayCount] = lambertCosLaw;
+			rayPixels[rayCount] = i;
+			++rayCount;
+		}
+
+		ShadowOccluder uncachedOccluder{};
+		ShadowOccluder& occluder = pShadowCache ? pShadowCache->occluders[lightIndex] : uncachedOccluder;
+
+		// Below a handful of rays culling the scene costs more than it saves, directional lights have no apex
+		constexpr int minPacketRays{ 4 };
+		const bool isPacket{ light.type != LightType::Directional && rayCount >= minPacketRays && packet.Build(light.origin, light.GetBoundingRadius(), lightRayOrigins, rayCount) };
+		if (isPacket) snapshot.CullShadowPacket(packet);
+
+		if (light.IsAreaLight())
+		{
+			const ShadowPacket* pPacket{ isPacket ? &packet : nullptr };
+
+			// Pixels on the even rows and columns of the tile get the full adaptive sampling first. A pixel in between
+			// whose sampled neighbours are all fully lit (or all fully shadowed) confirms that with a single ray.
+			const int tileWidth{ x1 - x0 };
+			float visibilities[maxTilePixels];
+			std::fill_n(visibilities, pixelCount, -1.f);
+
+			for (int r{}; r < rayCount; ++r)
+			{
+				const int i{ rayPixels[r] };
+				if ((i % tileWidth) % 2 == 0 && (i / tileWidth) % 2 == 0)
+					visibilities[i] = SampleAreaLightVisibility(snapshot, light, lightRays[r].origin, viewRays[i].direction, pPacket, occluder, pShadowCache);
+			}
+
+			for (int r{}; r < rayCount; ++r)
+			{
+				const int i{ rayPixels[r] };
+				if (visibilities[i] >= 0.f) continue;
+
+				const int x{ i % tileWidth };
+				const int y{ i / tileWidth };
+				float sharedVisibility{ -1.f };
+				bool isUniform{ true };
+				for (int neighbourY : { y & ~1, (y & ~1) + 2 })
+				{
+					for (int neighbourX : { x & ~1, (x & ~1) + 2 })
+					{
+						if ((neighbourY != y && y % 2 == 0) || (neighbourX != x && x % 2 == 0)) continue; // on a sampled row or column
+						if (neighbourX >= tileWidth || neighbourY * tileWidth >= pixelCount) continue;
+
+						const float visibility{ visibilities[neighbourY * tileWidth + neighbourX] };
+						if (sharedVisibility < 0.f) sharedVisibility = visibility;
+						isUniform = isUniform && visibility == sharedVisibility && (visibility == 0.f || visibility == 1.f);
+					}
+				}
+
+				const Vector3& origin = lightRays[r].origin;
+				if (isUniform && sharedVisibility >= 0.f && TraceAreaLightSamples(snapshot, light, origin, viewRays[i].direction, 1, pPacket, occluder, pShadowCache) == static_cast<int>(sharedVisibility))
+					visibilities[i] = sharedVisibility;
+				else
+					visibilities[i] = SampleAreaLightVisibility(snapshot, light, origin, viewRays[i].direction, pPacket, occluder, pShadowCache);
+			}
+
+			for (int r{}; r < rayCount; ++r)
+			{
+				const int i{ rayPixels[r] };
+				if (visibilities[i] <= 0.f) continue;
+
+				const ColorRGB contribution{ ShadeLight<lightingMode>(closestHits[i], light, lightRays[r].direction, lambertCosLaws[r], viewRays[i], materials) };
+				colors[i] += contribution * visibilities[i];
+			}
+			continue;
+		}
+
+
+		for (int r{}; r < rayCount; ++r)
+		{
+			const Ray& lightRay = lightRays[r];
+
+			if constexpr (isOccluderCacheActive)
+			{
+				++pShadowCache->shadowRays;
+				if (snapshot.DoesHitOccluder(lightRay, occluder))
+				{
+					++pShadowCache->blockedRays;
+					++pShadowCache->cacheHits;
+					continue;
+				}
+			}
+
+			const bool isBlocked{ isPacket ? snapshot.DoesHit(lightRay, packet, occluder) : snapshot.DoesHit(lightRay, occluder) };
+			if (isBlocked)
+			{
+				if constexpr (isOccluderCacheActive) ++pShadowCache->blockedRays;
+				continue;
+			}
+
+			const int i{ rayPixels[r] };
+			colors[i] += ShadeLight<lightingMode>(closestHits[i], light, lightRay.direction, lambertCosLaws[r], viewRays[i], materials);
+		}
+	}
+
+	for (int i{}; i < pixelCount; ++i)
+	{
+		StorePixel(pixelIndices[i], colors[i]);
+	}
+}
+
+void Renderer::SelectColorKernel()
+{
+	static constexpr ColorKernel kernels[static_cast<int>(LightingMode::Max)][2]
+	{
+		{ &Renderer::CalculateColorKernel<LightingMode::ObservedArea, false>, &Renderer::CalculateColorKernel<LightingMode::ObservedArea, true> },
+		{ &Renderer::CalculateColorKernel<LightingMode::Radiance, false>, &Renderer::CalculateColorKernel<LightingMode::Radiance, true> },
+		{ &Renderer::CalculateColorKernel<LightingMode::BRDF, false>, &Renderer::CalculateColorKernel<LightingMode::BRDF, true> },
+		{ &Renderer::CalculateColorKernel<LightingMode::Combined, false>, &Renderer::CalculateColorKernel<LightingMode::Combined, true> }
+	};
 
+	m_pColorKernel = kernels[static_cast<int>(m_CurrentLightingMode)][m_IsShadowsActive];
 
+#ifdef SHADOW_PACKETS
+	static constexpr ShadowTileKernel shadowTileKernels[static_cast<int>(LightingMode::Max)]
+	{
+		&Renderer::RenderShadowTileKernel<LightingMode::ObservedArea>,
+		&Renderer::RenderShadowTileKernel<LightingMode::Radiance>,
+		&Renderer::RenderShadowTileKernel<LightingMode::BRDF>,
+		&Renderer::RenderShadowTileKernel<LightingMode::Combined>
+	};
+
+	m_pShadowTileKernel = m_IsShadowsActive ? shadowTileKernels[static_cast<int>(m_CurrentLightingMode)] : nullptr;
+#endif
+}
 
-bool Renderer::SaveBufferToImage() const
+
+
+
+void Renderer::CaptureFrame(Image& image) const
+{
+	image.width = static_cast<uint32_t>(m_Width);
+	image.height = static_cast<uint32_t>(m_Height);
+	image.pixels.assign(m_ColorBuffer.begin(), m_ColorBuffer.end());
+}
+
+void Renderer::ReadRegion(int x0, int y0, int x1, int y1, ColorRGB* pColors) const
+{
+	const int regionWidth{ x1 - x0 };
+	for (int y{ y0 }; y < y1; ++y)
+	{
+		std::copy_n(m_ColorBuffer.begin() + (x0 + y * m_Width), regionWidth, pColors);
+		pColors += regionWidth;
+	}
+}
+
+void Renderer::WriteRegion(int x0, int y0, int x1, int y1, const ColorRGB* pColors)
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	for (int y{ y0 }; y < y1; ++y)
+	{
+		for (int x{ x0 }; x < x1; ++x)
+		{
+			StorePixel(static_cast<uint32_t>(x + y * m_Width), *pColors++);
+		}
+	}
 }
 
 void dae::Renderer::ToggleShadowRendering()
 {
 	m_IsShadowsActive = !m_IsShadowsActive;
+	SelectColorKernel();
 }
 
 void dae::Renderer::CycleLightning()
@@ -160,4 +725,70 @@ void dae::Renderer::CycleLightning()
 	cyclePhase = (cyclePhase + 1) % static_cast<int>(LightingMode::Max); // next + check in interval
 
 	m_CurrentLightingMode = static_cast<LightingMode>(cyclePhase);
+	SelectColorKernel();
+}
+
+void Renderer::SetLightingMode(int lightingMode)
+{
+	m_CurrentLightingMode = static_cast<LightingMode>(lightingMode % static_cast<int>(LightingMode::Max));
+	SelectColorKernel();
+}
+
+void Renderer::SetShadowsActive(bool isActive)
+{
+	m_IsShadowsActive = isActive;
+	SelectColorKernel();
+}
+
+void Renderer::SetRasterizedPrimaryVisibility(bool isActive)
+{
+	m_IsRasterizedPrimaryActive = isActive;
+}
+
+void Renderer::ToggleRasterizedPrimaryVisibility()
+{
+	m_IsRasterizedPrimaryActive = !m_IsRasterizedPrimaryActive;
+}
+
+uint32_t Renderer::GetRasterizedFallbackCount() const
+{
+	return m_pVisibilityBuffer ? m_pVisibilityBuffer->GetFallbackCount() : 0;
+}
+
+Renderer::ShadowOccluderCache& Renderer::AcquireShadowOccluderCache(size_t lightCount) const
+{
+	thread_local ShadowOccluderCache cache{};
+
+	if (cache.rendererId != m_Id || cache.renderPass != m_RenderPass)
+	{
+		// First pixel of this thread in a new render, report the previous one.
+		// Counts of another renderer are dropped, it might not exist anymore.
+		// Keyed on the id, a renderer created where a destroyed one lived would inherit its counts and occluders.
+		if (cache.rendererId == m_Id)
+		{
+			m_ShadowRays += cache.shadowRays;
+			m_BlockedShadowRays += cache.blockedRays;
+			m_OccluderCacheHits += cache.cacheHits;
+		}
+		else
+		{
+			cache.occluders.clear();
+		}
+
+		cache.rendererId = m_Id;
+		cache.renderPass = m_RenderPass;
+		cache.shadowRays = 0;
+		cache.blockedRays = 0;
+		cache.cacheHits = 0;
+	}
+
+	// Occluders survive across renders, the next frame is usually blocked by the same primitives
+	if (cache.occluders.size() != lightCount) cache.occluders.resize(lightCount);
+
+	return cache;
+}
+
+ShadowCacheStatistics Renderer::ConsumeShadowCacheStatistics()
+{
+	return ShadowCacheStatistics{ m_ShadowRays.exchange(0), m_BlockedShadowRays.exchange(0), m_OccluderCacheHits.exchange(0) };
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <vector>
 #include "DataTypes.h"
 #include "Material.h"
 
@@ -9,31 +11,83 @@ struct SDL_Surface;
 
 namespace dae
 {
-	class Scene;
+	struct SceneSnapshot;
+	struct ShadowOccluder;
+	struct ShadowPacket;
+	struct Image;
+	class ThreadPool;
+	class VisibilityBuffer;
+
+	struct ShadowCacheStatistics
+	{
+		uint64_t shadowRays{}; // toward lights in front of the surface
+		uint64_t blockedRays{};
+		uint64_t cacheHits{}; // blocked by the cached occluder, no scene traversal needed
+
+		// Fraction of the blocked rays the cache resolved
+		float GetHitRate() const { return blockedRays > 0 ? static_cast<float>(cacheHits) / static_cast<float>(blockedRays) : 0.f; }
+	};
 
 	class Renderer final
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		// Headless renderer without window (render workers), Present must not be called
+		Renderer(int width, int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		// Traces the snapshot into the back buffer, safe to call from a worker thread while the scene updates the next frame
+		void Render(const SceneSnapshot& snapshot);
+		// Per frame work shared by all regions of the snapshot (the visibility buffer setup in hybrid mode), Render calls it itself
+		void BeginFrame(const SceneSnapshot& snapshot);
+		// Traces only the pixels in [x0, x1) x [y0, y1), used for distributed tiles. BeginFrame first, once per frame.
+		void RenderRegion(const SceneSnapshot& snapshot, int x0, int y0, int x1, int y1);
+		// Copies the last rendered frame to the window, main thread only
+		void Present();
 
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectratio, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;
+		// Resolution of the traced frame, defaults to the window size. Not while a frame is rendering.
+		void SetRenderResolution(int width, int height);
+		// 0 (default) leaves the threads to std::execution::par, otherwise renders with exactly this many (scaling benchmarks)
+		void SetThreadCount(uint32_t threadCount);
+
+		void RenderPixel(const SceneSnapshot& snapshot, uint32_t pixelIndex, float fov, float aspectratio, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
 
 		void CalculatePixelCoordinates(uint32_t pixelIndex, float fov, float aspectratio, const Matrix& cameraToWorld, uint32_t& px, uint32_t& py, Vector3& rayDirection) const;
-		dae::ColorRGB CalculateColor(Scene* pScene, const Ray& viewRay, const std::vector<Material*>& materials, const std::vector<Light>& lights) const;
+		// Runs the kernel of the current lighting mode and shadow setting
+		dae::ColorRGB CalculateColor(const SceneSnapshot& snapshot, const Ray& viewRay, const std::vector<Material*>& materials, const std::vector<Light>& lights) const;
 
-		bool SaveBufferToImage() const;
+		// Copies the linear colors of the last rendered frame, hand the image to an ImageWriter to save it
+		void CaptureFrame(Image& image) const;
+		// Row by row copy of the linear colors of a region, from/to a tightly packed (x1 - x0) * (y1 - y0) array
+		void ReadRegion(int x0, int y0, int x1, int y1, ColorRGB* pColors) const;
+		void WriteRegion(int x0, int y0, int x1, int y1, const ColorRGB* pColors);
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
 
 		void ToggleShadowRendering();
 		void CycleLightning();
 
+		// Raw settings, so render workers can match the coordinator
+		int GetLightingMode() const { return static_cast<int>(m_CurrentLightingMode); }
+		void SetLightingMode(int lightingMode);
+		bool IsShadowsActive() const { return m_IsShadowsActive; }
+		void SetShadowsActive(bool isActive);
+		// Hybrid mode: primary visibility is rasterized into a visibility buffer, only shading and shadows are traced
+		bool IsRasterizedPrimaryVisibilityActive() const { return m_IsRasterizedPrimaryActive; }
+		void SetRasterizedPrimaryVisibility(bool isActive);
+		void ToggleRasterizedPrimaryVisibility();
+		// Pixels of the last rasterized frame whose rasterized primitive didn't match the ray and got traced (see VisibilityBuffer)
+		uint32_t GetRasterizedFallbackCount() const;
+
+		// Shadow rays and occluder cache hits since the last call. Render threads hand in their counts
+		// when they start on the next Render/RenderRegion, so the statistics lag up to one render behind.
+		ShadowCacheStatistics ConsumeShadowCacheStatistics();
+
 	private:
 
 		enum class LightingMode
@@ -47,11 +101,58 @@ namespace dae
 
 		LightingMode m_CurrentLightingMode;
 
+		// One CalculateColor per lighting mode and shadow setting, the per-light loop has no settings branches left.
+		// Selected whenever a setting changes, settings only change between frames.
+		// pixelIndex is the buffer index of the view ray, UINT32_MAX for rays that aren't a pixel's primary ray
+		using ColorKernel = ColorRGB(Renderer::*)(const SceneSnapshot&, const Ray&, uint32_t, const std::vector<Material*>&, const std::vector<Light>&) const;
+		ColorKernel m_pColorKernel{};
+
+		template<LightingMode lightingMode, bool isShadowsActive>
+		ColorRGB CalculateColorKernel(const SceneSnapshot& snapshot, const Ray& viewRay, uint32_t pixelIndex, const std::vector<Material*>& materials, const std::vector<Light>& lights) const;
+		// Closest hit of a primary ray, from the visibility buffer in hybrid mode
+		void GetPrimaryHit(const SceneSnapshot& snapshot, const Ray& viewRay, uint32_t pixelIndex, HitRecord& closestHit) const;
+		// Contribution of one unblocked light, shared by the pixel and the tile kernels so both sum the exact same terms
+		template<LightingMode lightingMode>
+		ColorRGB ShadeLight(const HitRecord& closestHit, const Light& light, const Vector3& lightRayDirection, float lambertCosLaw, const Ray& viewRay, const std::vector<Material*>& materials) const;
+		void SelectColorKernel();
+
+		// With shadows on, a tile is traced light by light: the shadow rays of the tile toward a point light
+		// share one cone (see ShadowPacket), the scene is culled against that cone once instead of once per ray.
+		// nullptr when shadows are off, tiles then run the pixel kernel.
+		using ShadowTileKernel = void(Renderer::*)(const SceneSnapshot&, int, int, int, int);
+		ShadowTileKernel m_pShadowTileKernel{};
+
+		template<LightingMode lightingMode>
+		void RenderShadowTileKernel(const SceneSnapshot& snapshot, int x0, int y0, int x1, int y1);
+		// Traces the pixels in [x0, x1) x [y0, y1), at most TILE_SIZE x TILE_SIZE
+		void RenderTile(const SceneSnapshot& snapshot, int x0, int y0, int x1, int y1);
+
+		// Per render thread: the last occluder of every light, shadow rays toward the same light
+		// from neighbouring pixels are usually blocked by the same primitive
+		struct ShadowOccluderCache;
+		ShadowOccluderCache& AcquireShadowOccluderCache(size_t lightCount) const;
+
+		// Visible fraction of an area light from origin: a 2x2 grid of stratified probe rays, only when the probes
+		// disagree (penumbra) the 4x4 grid is traced as well. Fully lit and fully shadowed points cost 4 rays.
+		float SampleAreaLightVisibility(const SceneSnapshot& snapshot, const Light& light, const Vector3& origin, const Vector3& viewDirection, const ShadowPacket* pPacket, ShadowOccluder& occluder, ShadowOccluderCache* pShadowCache) const;
+		// Traces gridSize x gridSize stratified rays toward the light, returns how many reach it. pPacket is optional.
+		// The sample grid is rotated per pixel, viewDirection is the key.
+		int TraceAreaLightSamples(const SceneSnapshot& snapshot, const Light& light, const Vector3& origin, const Vector3& viewDirection, int gridSize, const ShadowPacket* pPacket, ShadowOccluder& occluder, ShadowOccluderCache* pShadowCache) const;
+
+		const uint32_t m_Id; // unique per instance, the thread caches are keyed on it
+		uint32_t m_RenderPass{}; // incremented by every RenderRegion, tells the thread caches to report
+		mutable std::atomic<uint64_t> m_ShadowRays{};
+		mutable std::atomic<uint64_t> m_BlockedShadowRays{};
+		mutable std::atomic<uint64_t> m_OccluderCacheHits{};
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
 
+		std::vector<uint32_t> m_BackBuffer{}; // written by Render, copied to m_pBufferPixels by Present
+		std::vector<ColorRGB> m_ColorBuffer{}; // unclamped radiance of the same frame, for screenshots
+
 		int m_Width{};
 		int m_Height{};
 		float m_InvWidth{};
@@ -59,6 +160,15 @@ namespace dae
 
 		float m_AspectRatio{};
 
+		uint32_t m_ThreadCount{};
+		ThreadPool* m_pThreadPool{}; // m_ThreadCount - 1 threads, the rendering thread helps out
+
 		bool m_IsShadowsActive;
+
+		bool m_IsRasterizedPrimaryActive{ false };
+		VisibilityBuffer* m_pVisibilityBuffer{}; // created the first time hybrid mode renders
+
+		// Stores the unclamped color and its packed window format counterpart
+		void StorePixel(uint32_t pixelIndex, ColorRGB color);
 	};
 }
@@ -0,0 +1,163 @@
+#include "ScalingBenchmark.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SceneSnapshot.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+using namespace dae;
+
+bool ScalingBenchmarkSettings::ParseCommandLine(int argc, char* args[], ScalingBenchmarkSettings& settings)
+{
+	bool isBenchmarking{ false };
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		if (argument == "--scaling")
+			isBenchmarking = true;
+		else if (argument == "--frames" && hasValue)
+			settings.framesPerSample = std::max(static_cast<uint32_t>(std::stoul(args[++i])), 1u);
+		else if (argument == "--size" && hasValue)
+			std::sscanf(args[++i], "%dx%d", &settings.width, &settings.height);
+		else if (argument == "--seed" && hasValue)
+			settings.seed = static_cast<uint32_t>(std::stoul(args[++i]));
+		else if (argument == "--output" && hasValue)
+			settings.outputFilename = args[++i];
+		else if (argument == "--mesh" && hasValue)
+			settings.meshFilename = args[++i];
+	}
+
+	return isBenchmarking;
+}
+
+ScalingBenchmark::ScalingBenchmark(const ScalingBenchmarkSettings& settings)
+	: m_Settings(settings)
+{
+}
+
+bool ScalingBenchmark::Run()
+{
+	m_Output.open(m_Settings.outputFilename);
+	if (!m_Output)
+	{
+		std::cout << "Failed to open " << m_Settings.outputFilename << std::endl;
+		return false;
+	}
+
+	m_Output << "sweep,spheres,meshInstances,lights,depthComplexity,threads,averageMs,minMs,maxMs,occluderCacheHitRate\n";
+	std::cout << "**SCALING BENCHMARK** " << m_Settings.width << "x" << m_Settings.height << ", "
+		<< m_Settings.framesPerSample << " frames per sample, seed " << m_Settings.seed << std::endl;
+
+	MeasureMesh(BVHMode::Full);
+	MeasureMesh(BVHMode::Compressed);
+
+	StressSceneSettings base{};
+	base.seed = m_Settings.seed;
+
+	for (uint32_t sphereCount : { 16u, 64u, 256u, 1024u, 4096u })
+	{
+		StressSceneSettings sceneSettings{ base };
+		sceneSettings.sphereCount = sphereCount;
+		Measure("spheres", sceneSettings, 0);
+	}
+
+	for (uint32_t meshInstanceCount : { 0u, 16u, 64u, 256u, 1024u })
+	{
+		StressSceneSettings sceneSettings{ base };
+		sceneSettings.meshInstanceCount = meshInstanceCount;
+		Measure("meshInstances", sceneSettings, 0);
+	}
+
+	for (uint32_t lightCount : { 1u, 2u, 4u, 8u, 16u, 32u })
+	{
+		StressSceneSettings sceneSettings{ base };
+		sceneSettings.lightCount = lightCount;
+		Measure("lights", sceneSettings, 0);
+	}
+
+	for (uint32_t depthComplexity : { 1u, 2u, 4u, 8u, 16u })
+	{
+		StressSceneSettings sceneSettings{ base };
+		sceneSettings.depthComplexity = depthComplexity;
+		Measure("depthComplexity", sceneSettings, 0);
+	}
+
+	// Powers of two up to the core count, then the core count itself
+	const uint32_t coreCount{ std::max(std::thread::hardware_concurrency(), 1u) };
+	for (uint32_t threadCount{ 1 }; threadCount < coreCount * 2; threadCount *= 2)
+	{
+		Measure("threads", base, std::min(threadCount, coreCount));
+	}
+
+	std::cout << "**SCALING BENCHMARK FINISHED** results in " << m_Settings.outputFilename << std::endl;
+	return static_cast<bool>(m_Output);
+}
+
+void ScalingBenchmark::Measure(const char* sweep, const StressSceneSettings& sceneSettings, uint32_t threadCount)
+{
+	Scene_Stress scene{ sceneSettings };
+	scene.Initialize();
+
+	SceneSnapshot snapshot{};
+	scene.CreateSnapshot(snapshot);
+
+	Renderer renderer{ m_Settings.width, m_Settings.height };
+	renderer.SetThreadCount(threadCount);
+	renderer.Render(snapshot); // warm-up, first touch of the buffers and the pool
+
+	float total{}, low{ FLT_MAX }, high{};
+	for (uint32_t frame{}; frame < m_Settings.framesPerSample; ++frame)
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+		renderer.Render(snapshot);
+		const float frameTime{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+		total += frameTime;
+		low = std::min(low, frameTime);
+		high = std::max(high, frameTime);
+	}
+
+	// Hands in the shadow statistics of the last measured frame (the warm-up counts too, it's the same snapshot)
+	renderer.Render(snapshot);
+	const float hitRate{ renderer.ConsumeShadowCacheStatistics().GetHitRate() };
+
+	const float average{ total / m_Settings.framesPerSample };
+	const uint32_t threads{ threadCount > 0 ? threadCount : std::thread::hardware_concurrency() };
+
+	m_Output << sweep << "," << sceneSettings.sphereCount << "," << sceneSettings.meshInstanceCount << ","
+		<< sceneSettings.lightCount << "," << sceneSettings.depthComplexity << "," << threads << ","
+		<< average << "," << low << "," << high << "," << hitRate << "\n";
+
+	std::cout << sweep << ": " << sceneSettings.sphereCount << " spheres, " << sceneSettings.meshInstanceCount << " mesh instances, "
+		<< sceneSettings.lightCount << " lights, depth " << sceneSettings.depthComplexity << ", " << threads << " threads -> "
+		<< average << " ms (" << low << " - " << high << "), occluder cache " << hitRate * 100.f << "%" << std::endl;
+}
+
+void ScalingBenchmark::MeasureMesh(BVHMode mode) const
+{
+	TriangleMesh mesh{};
+	if (!Utils::ParseOBJ(m_Settings.meshFilename, mesh.positions, mesh.normals, mesh.indices))
+	{
+		std::cout << "Failed to open " << m_Settings.meshFilename << std::endl;
+		return;
+	}
+
+	mesh.UpdateAABB();
+	mesh.UpdateTransforms();
+
+	BVHBuildSettings bvhSettings{};
+	bvhSettings.mode = mode;
+	mesh.BuildBVH(bvhSettings);
+
+	std::cout << m_Settings.meshFilename << " (" << (mode == BVHMode::Compressed ? "compressed BVH" : "full BVH") << "): "
+		<< mesh.indices.size() / 3 << " triangles, " << mesh.GetMemoryFootprint() / 1024 << " KB, "
+		<< GeometryUtils::MeasureTraversalThroughput(mesh) / 1'000'000.f << " MRays/s" << std::endl;
+}
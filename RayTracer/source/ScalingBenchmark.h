@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace dae
+{
+	//Forward Declarations
+	struct StressSceneSettings;
+	enum class BVHMode;
+
+	struct ScalingBenchmarkSettings
+	{
+		uint32_t framesPerSample{ 3 }; // after one warm-up frame
+		int width{ 320 };
+		int height{ 240 };
+		uint32_t seed{ 1 };
+
+		std::string outputFilename{ "scaling_benchmark.csv" };
+		std::string meshFilename{ "Resources/lowpoly_bunny2.obj" }; // compared with a full and a compressed BVH
+
+		// --scaling [--frames 3] [--size 320x240] [--seed 1] [--output scaling_benchmark.csv] [--mesh file.obj]
+		// Returns false when --scaling isn't on the command line
+		static bool ParseCommandLine(int argc, char* args[], ScalingBenchmarkSettings& settings);
+	};
+
+	// Renders Scene_Stress headless while sweeping one parameter at a time (spheres, mesh instances, lights,
+	// depth complexity, render threads) and writes the average frame time of every sample to a CSV file.
+	// Reports the mesh statistics of both BVH modes first (console only).
+	class ScalingBenchmark final
+	{
+	public:
+		explicit ScalingBenchmark(const ScalingBenchmarkSettings& settings);
+		~ScalingBenchmark() = default;
+
+		ScalingBenchmark(const ScalingBenchmark&) = delete;
+		ScalingBenchmark(ScalingBenchmark&&) noexcept = delete;
+		ScalingBenchmark& operator=(const ScalingBenchmark&) = delete;
+		ScalingBenchmark& operator=(ScalingBenchmark&&) noexcept = delete;
+
+		bool Run();
+
+	private:
+		ScalingBenchmarkSettings m_Settings;
+		std::ofstream m_Output{};
+
+		// threadCount 0 uses the default std::execution::par rendering
+		void Measure(const char* sweep, const StressSceneSettings& sceneSettings, uint32_t threadCount);
+
+		// Prints memory footprint and traversal throughput of the mesh with the given BVH, used to pick a BVHMode per asset
+		void MeasureMesh(BVHMode mode) const;
+	};
+}
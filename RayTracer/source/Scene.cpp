@@ -1,6 +1,11 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "SceneFile.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <random>
 
 namespace dae {
 
@@ -24,56 +29,44 @@ namespace dae {
 		}
 
 		m_Materials.clear();
-	}
-
-	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
-	{
-		//todo w1
 
-		for (const Sphere& sphere : m_SphereGeometries)
+		for (auto& pMesh : m_StreamingMeshGeometries)
 		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+			delete pMesh;
+			pMesh = nullptr;
 		}
 
-		for (const Plane& plane : m_PlaneGeometries)
-		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
-		}
-
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
-		{
-			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, closestHit);
-		}
+		m_StreamingMeshGeometries.clear();
 	}
 
-	bool Scene::DoesHit(const Ray& ray) const
+	void Scene::CreateSnapshot(SceneSnapshot& snapshot)
 	{
-		//todo W3
-		for (const Sphere& sphere : m_SphereGeometries)
+		snapshot.cameraToWorld = m_Camera.CalculateCameraToWorld();
+		snapshot.cameraOrigin = m_Camera.origin;
+		snapshot.fov = m_Camera.fov;
+		snapshot.time = m_Time;
+
+		snapshot.spheres = m_SphereGeometries;
+		snapshot.planes = m_PlaneGeometries;
+		snapshot.lights = m_Lights;
+		snapshot.pMaterials = &m_Materials;
+
+		snapshot.triangleMeshes.clear();
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphere, ray))
-			{
-				return true;
-			}
+			snapshot.triangleMeshes.push_back({ &triangleMesh, triangleMesh.GetInstance() });
 		}
 
-		for (const Plane& plane : m_PlaneGeometries)
+		for (const TriangleMeshInstance& meshInstance : m_TriangleMeshInstances)
 		{
-			if (GeometryUtils::HitTest_Plane(plane, ray))
-			{
-				return true;
-			}
+			snapshot.triangleMeshes.push_back({ &m_TriangleMeshGeometries[meshInstance.meshIndex], meshInstance.instance });
 		}
 
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		snapshot.streamingMeshes.clear();
+		for (const StreamingMesh* pStreamingMesh : m_StreamingMeshGeometries)
 		{
-			if (GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray))
-			{
-				return true;
-			}
+			snapshot.streamingMeshes.push_back({ pStreamingMesh, pStreamingMesh->GetInstance() });
 		}
-
-		return false;
 	}
 
 #pragma region Scene Helpers
@@ -109,6 +102,29 @@ namespace dae {
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	void Scene::AddTriangleMeshInstance(size_t meshIndex, const Matrix& worldTransform)
+	{
+		const TriangleMesh& mesh{ m_TriangleMeshGeometries[meshIndex] };
+		m_TriangleMeshInstances.push_back({ meshIndex, { worldTransform, Matrix::Inverse(worldTransform), mesh.aabb.Transformed(worldTransform) } });
+	}
+
+	StreamingMesh* Scene::AddStreamingMesh(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex, size_t residentBudget)
+	{
+		StreamingMesh* pMesh{ new StreamingMesh(residentBudget) };
+		if (!pMesh->Open(filename))
+		{
+			std::cout << "Failed to open streaming mesh " << filename << '\n';
+			delete pMesh;
+			return nullptr;
+		}
+
+		pMesh->cullMode = cullMode;
+		pMesh->materialIndex = materialIndex;
+
+		m_StreamingMeshGeometries.emplace_back(pMesh);
+		return pMesh;
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -133,6 +149,33 @@ namespace dae {
 		return &m_Lights.back();
 	}
 
+	Light* Scene::AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.radius = radius;
+		l.intensity = intensity;
+		l.color = color;
+		l.type = LightType::SphereArea;
+
+		m_Lights.emplace_back(l);
+		return &m_Lights.back();
+	}
+
+	Light* Scene::AddQuadLight(const Vector3& origin, const Vector3& extentU, const Vector3& extentV, float intensity, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.extentU = extentU;
+		l.extentV = extentV;
+		l.intensity = intensity;
+		l.color = color;
+		l.type = LightType::QuadArea;
+
+		m_Lights.emplace_back(l);
+		return &m_Lights.back();
+	}
+
 	unsigned char Scene::AddMaterial(Material* pMaterial)
 	{
 		m_Materials.emplace_back(pMaterial);
@@ -401,7 +444,17 @@ namespace dae {
 
 		m_pMesh->Scale({ 2.0f, 2.0f, 2.0f });
 		m_pMesh->UpdateAABB();
+
+		m_pMesh->BuildBVH();
 		m_pMesh->UpdateTransforms();
+
+		//Camera path for recordings (--record), a slow arc in front of the rotating bunny that ends where it started
+		const Vector3 pathTarget{ 0.f, 1.5f, 0.f };
+		m_CameraPath.AddKeyframe({ 0.f, { 0.f, 3.f, -9.f }, pathTarget, 45.f });
+		m_CameraPath.AddKeyframe({ 2.f, { -3.5f, 2.5f, -7.f }, pathTarget, 45.f });
+		m_CameraPath.AddKeyframe({ 4.f, { 0.f, 1.5f, -5.5f }, pathTarget, 55.f });
+		m_CameraPath.AddKeyframe({ 6.f, { 3.5f, 2.5f, -7.f }, pathTarget, 45.f });
+		m_CameraPath.AddKeyframe({ 8.f, { 0.f, 3.f, -9.f }, pathTarget, 45.f });
 	}
 	void Scene_W4_BunnyScene::Update(Timer* pTimer)
 	{
@@ -415,5 +468,216 @@ namespace dae {
 	}
 #pragma endregion
 
+#pragma region SCENE FILE
+	void Scene_File::Initialize()
+	{
+		SceneDescription description{};
+		if (!SceneFile::Load(m_Filename, description))
+			return;
+
+		sceneName = m_Filename;
+		m_Camera.origin = description.cameraOrigin;
+		m_Camera.fovAngle = description.cameraFovAngle;
+		m_Camera.SetFOV(description.cameraFovAngle);
+		if (description.hasCameraTarget)
+			m_Camera.LookAt(description.cameraTarget);
+
+		for (const MaterialDescription& material : description.materials)
+		{
+			AddMaterial(material.Create());
+		}
+
+		m_SphereGeometries.insert(m_SphereGeometries.end(), description.spheres.begin(), description.spheres.end());
+		m_PlaneGeometries.insert(m_PlaneGeometries.end(), description.planes.begin(), description.planes.end());
+		m_Lights.insert(m_Lights.end(), description.lights.begin(), description.lights.end());
+
+		//Reserve first, AddTriangleMesh hands out pointers into the vector
+		const size_t firstMesh{ m_TriangleMeshGeometries.size() };
+		m_TriangleMeshGeometries.reserve(firstMesh + description.meshes.size());
+
+		for (MeshDescription& meshDescription : description.meshes)
+		{
+			TriangleMesh* pMesh = AddTriangleMesh(meshDescription.cullMode, meshDescription.materialIndex);
+			pMesh->positions = std::move(meshDescription.positions);
+			pMesh->normals = std::move(meshDescription.normals);
+			pMesh->indices = std::move(meshDescription.indices);
+
+			const MeshPlacement& placement{ meshDescription.placements.front() };
+			pMesh->Scale(placement.scale);
+			pMesh->RotateY(placement.yaw);
+			pMesh->Translate(placement.translation);
+			pMesh->UpdateAABB();
+			pMesh->UpdateTransforms();
+		}
+
+		//One mesh per task, large meshes parallelize their own build on the same pool
+		ThreadPool::GetInstance().ParallelFor(static_cast<uint32_t>(description.meshes.size()), 1, [this, firstMesh, &description](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i{ begin }; i < end; ++i)
+			{
+				BVHBuildSettings bvhSettings{};
+				bvhSettings.mode = description.meshes[i].bvhMode;
+				m_TriangleMeshGeometries[firstMesh + i].BuildBVH(bvhSettings);
+			}
+		});
+
+		for (size_t i{}; i < description.meshes.size(); ++i)
+		{
+			const std::vector<MeshPlacement>& placements{ description.meshes[i].placements };
+			for (size_t placement{ 1 }; placement < placements.size(); ++placement)
+			{
+				AddTriangleMeshInstance(firstMesh + i, placements[placement].GetTransform());
+			}
+		}
+
+		for (const StreamingMeshDescription& meshDescription : description.streamingMeshes)
+		{
+			StreamingMesh* pMesh = AddStreamingMesh(meshDescription.streamFilename, meshDescription.cullMode, meshDescription.materialIndex, meshDescription.residentBudget);
+			if (!pMesh) continue;
+
+			pMesh->Scale(meshDescription.placement.scale);
+			pMesh->RotateY(meshDescription.placement.yaw);
+			pMesh->Translate(meshDescription.placement.translation);
+			pMesh->UpdateTransforms();
+		}
+	}
+#pragma endregion
+
+#pragma region SCENE STRESS
+	void Scene_Stress::Initialize()
+	{
+		sceneName = "Stress Scene";
+
+		//std::uniform_real_distribution differs between standard libraries, mt19937 itself doesn't
+		std::mt19937 generator{ m_Settings.seed };
+		const auto random = [&generator](float min, float max)
+		{
+			return min + (max - min) * (static_cast<float>(generator()) * (1.f / 4294967296.f));
+		};
+
+		constexpr float cameraDistance{ 20.f };
+		constexpr float layerSpacing{ 4.f };
+		constexpr float fovAngle{ 45.f };
+
+		m_Camera.origin = { 0.f, 0.f, -cameraDistance };
+		m_Camera.fovAngle = fovAngle;
+		m_Camera.SetFOV(fovAngle);
+
+		//Materials
+		constexpr uint32_t materialCount{ 8 };
+		unsigned char materials[materialCount]{};
+		for (unsigned char& material : materials)
+		{
+			const ColorRGB color{ random(.2f, 1.f), random(.2f, 1.f), random(.2f, 1.f) };
+			if (random(0.f, 1.f) < .5f)
+				material = AddMaterial(new Material_Lambert(color, 1.f));
+			else
+				material = AddMaterial(new Material_CookTorrence(color, random(0.f, 1.f) < .5f ? 1.f : 0.f, random(.1f, 1.f)));
+		}
+		const auto randomMaterial = [&]() { return materials[generator() % materialCount]; };
 
+		//Spheres in depthComplexity layers, sized so every layer roughly covers the view once
+		const uint32_t layerCount{ std::max(m_Settings.depthComplexity, 1u) };
+		const float depth{ layerCount * layerSpacing };
+		for (uint32_t layer{}; layer < layerCount; ++layer)
+		{
+			const uint32_t layerSphereCount{ m_Settings.sphereCount / layerCount + (layer < m_Settings.sphereCount % layerCount ? 1 : 0) };
+			if (layerSphereCount == 0) continue;
+
+			const float layerZ{ layer * layerSpacing };
+			const float halfHeight{ m_Camera.fov * (cameraDistance + layerZ) };
+			const float halfWidth{ halfHeight * 4.f / 3.f };
+			const float radius{ sqrtf(4.f * halfWidth * halfHeight / (PI * layerSphereCount)) };
+
+			for (uint32_t i{}; i < layerSphereCount; ++i)
+			{
+				const Vector3 origin{ random(-halfWidth, halfWidth), random(-halfHeight, halfHeight), layerZ + random(-.25f, .25f) * layerSpacing };
+				AddSphere(origin, radius, randomMaterial());
+			}
+		}
+
+		AddPlane({ 0.f, 0.f, depth + layerSpacing }, { 0.f, 0.f, -1.f }, materials[0]); //BACK
+
+		//Rock: displaced UV sphere, placed meshInstanceCount times without copying the geometry
+		if (m_Settings.meshInstanceCount > 0)
+		{
+			constexpr int rings{ 8 };
+			constexpr int segments{ 12 };
+
+			TriangleMesh* pRock = AddTriangleMesh(TriangleCullMode::BackFaceCulling, randomMaterial());
+			for (int ring{}; ring <= rings; ++ring)
+			{
+				const float theta{ PI * ring / rings };
+				for (int segment{}; segment < segments; ++segment)
+				{
+					const float phi{ PI_2 * segment / segments };
+					const float radius{ (ring == 0 || ring == rings) ? 1.f : random(.8f, 1.2f) };
+					pRock->positions.emplace_back(radius * sinf(theta) * cosf(phi), radius * cosf(theta), radius * sinf(theta) * sinf(phi));
+				}
+			}
+			for (int ring{}; ring < rings; ++ring)
+			{
+				for (int segment{}; segment < segments; ++segment)
+				{
+					const int current{ ring * segments + segment };
+					const int next{ ring * segments + (segment + 1) % segments };
+					//The first and last ring collapse into the poles, skip the degenerate halves
+					if (ring > 0)
+						pRock->indices.insert(pRock->indices.end(), { current, next, current + segments });
+					if (ring < rings - 1)
+						pRock->indices.insert(pRock->indices.end(), { next, next + segments, current + segments });
+				}
+			}
+			pRock->CalculateNormals();
+			pRock->UpdateAABB();
+			pRock->BuildBVH();
+
+			const size_t rockIndex{ m_TriangleMeshGeometries.size() - 1 };
+			for (uint32_t i{}; i < m_Settings.meshInstanceCount; ++i)
+			{
+				const Vector3 position{ random(-10.f, 10.f), random(-6.f, 6.f), random(-8.f, depth) };
+				const float scale{ random(.5f, 1.5f) };
+				const float yaw{ random(0.f, PI_2) };
+
+				if (i == 0)
+				{
+					pRock->Scale({ scale, scale, scale });
+					pRock->RotateY(yaw);
+					pRock->Translate(position);
+					pRock->UpdateTransforms();
+				}
+				else
+				{
+					AddTriangleMeshInstance(rockIndex, Matrix::CreateScale(scale, scale, scale) * Matrix::CreateRotationY(yaw) * Matrix::CreateTranslation(position));
+				}
+			}
+		}
+
+		//Lights in front of the spheres, the total intensity doesn't depend on the count
+		const uint32_t lightCount{ std::max(m_Settings.lightCount, 1u) };
+		for (uint32_t i{}; i < lightCount; ++i)
+		{
+			const Vector3 origin{ random(-15.f, 15.f), random(-10.f, 10.f), random(-cameraDistance, -5.f) };
+			AddPointLight(origin, 1500.f / lightCount, ColorRGB{ random(.6f, 1.f), random(.6f, 1.f), random(.6f, 1.f) });
+		}
+	}
+#pragma endregion
+
+	Scene* CreateScene(uint32_t sceneIndex)
+	{
+		switch (sceneIndex)
+		{
+		case 0: return new Scene_W1();
+		case 1: return new Scene_W2();
+		case 2: return new Scene_W3();
+		case 3: return new Scene_W4_TestScene();
+		case 4: return new Scene_W4_ReferenceScene();
+		case 5: return new Scene_W4_BunnyScene();
+		case 6: return new Scene_File("Resources/reference_scene.rtscene");
+		case 7: return new Scene_Stress();
+		case 8: return new Scene_File("Resources/area_light_scene.rtscene");
+		case 9: return new Scene_File("Resources/streaming_scene.rtscene");
+		default: return nullptr;
+		}
+	}
 }
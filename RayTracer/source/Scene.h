@@ -4,6 +4,8 @@
 
 #include "Math.h"
 #include "DataTypes.h"
+#include "StreamingMesh.h"
+#include "SceneSnapshot.h"
 #include "Camera.h"
 
 namespace dae
@@ -30,35 +32,71 @@ namespace dae
 		virtual void Initialize() = 0;
 		virtual void Update(dae::Timer* pTimer)
 		{
-			m_Camera.Update(pTimer);
+			m_Time = pTimer->GetTotal();
+
+			if (m_IsFollowingCameraPath && !m_CameraPath.IsEmpty())
+				m_Camera.ApplyKeyframe(m_CameraPath.Evaluate(pTimer->GetTotal()));
+			else
+				m_Camera.Update(pTimer);
+
+			// Evict clusters that haven't been touched lately
+			for (StreamingMesh* pMesh : m_StreamingMeshGeometries)
+			{
+				pMesh->TrimResidentSet();
+			}
 		}
 
 		Camera& GetCamera() { return m_Camera; }
-		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
-		bool DoesHit(const Ray& ray) const;
+
+		// Drives the camera from the scene's keyframed path instead of input (recording mode)
+		void SetFollowCameraPath(bool isFollowing) { m_IsFollowingCameraPath = isFollowing; }
+		const CameraPath& GetCameraPath() const { return m_CameraPath; }
+
+		// Copies the state of the current frame, reuses the snapshot's storage
+		void CreateSnapshot(SceneSnapshot& snapshot);
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
 		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+		const std::vector<StreamingMesh*>& GetStreamingMeshes() const { return m_StreamingMeshGeometries; }
 
 	protected:
+		// Extra placement of a mesh in m_TriangleMeshGeometries, shares the mesh's geometry and BVH
+		struct TriangleMeshInstance
+		{
+			size_t meshIndex{};
+			MeshInstance instance{};
+		};
+
 		std::string	sceneName;
 
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		std::vector<TriangleMeshInstance> m_TriangleMeshInstances{};
+		std::vector<StreamingMesh*> m_StreamingMeshGeometries{};
 		std::vector<Light> m_Lights{};
 		std::vector<Material*> m_Materials{};
 
 		Camera m_Camera{};
+		CameraPath m_CameraPath{};
+		bool m_IsFollowingCameraPath{ false };
+		float m_Time{}; // timer total of the last Update
 
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		// The mesh's AABB has to be up to date
+		void AddTriangleMeshInstance(size_t meshIndex, const Matrix& worldTransform);
+		// Maps a file written by StreamingMesh::WriteFile/ConvertOBJ, returns nullptr if it can't be opened
+		StreamingMesh* AddStreamingMesh(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex = 0, size_t residentBudget = 512ull * 1024 * 1024);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+		Light* AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color);
+		// extentU and extentV go from the center to the edges, the quad is 2 * |extentU| by 2 * |extentV|
+		Light* AddQuadLight(const Vector3& origin, const Vector3& extentU, const Vector3& extentV, float intensity, const ColorRGB& color);
 		unsigned char AddMaterial(Material* pMaterial);
 	};
 
@@ -164,4 +202,55 @@ namespace dae
 	private:
 		TriangleMesh* m_pMesh;
 	};
+
+	//Scene loaded from a .rtscene file (see SceneFile.h)
+	class Scene_File final : public Scene
+	{
+	public:
+		explicit Scene_File(const std::string& filename) : m_Filename(filename) {}
+		~Scene_File() override = default;
+
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
+
+		void Initialize() override;
+
+	private:
+		std::string m_Filename;
+	};
+
+	struct StressSceneSettings
+	{
+		uint32_t sphereCount{ 256 };
+		uint32_t meshInstanceCount{ 16 }; // placements of one procedural rock mesh
+		uint32_t lightCount{ 4 };
+		uint32_t depthComplexity{ 4 }; // layers of spheres, roughly the number of spheres a primary ray passes
+		uint32_t seed{ 1 };
+	};
+
+	//Procedural scene for scaling benchmarks, the same settings always produce the same scene (on every platform)
+	class Scene_Stress final : public Scene
+	{
+	public:
+		explicit Scene_Stress(const StressSceneSettings& settings = {}) : m_Settings(settings) {}
+		~Scene_Stress() override = default;
+
+		Scene_Stress(const Scene_Stress&) = delete;
+		Scene_Stress(Scene_Stress&&) noexcept = delete;
+		Scene_Stress& operator=(const Scene_Stress&) = delete;
+		Scene_Stress& operator=(Scene_Stress&&) noexcept = delete;
+
+		void Initialize() override;
+
+	private:
+		StressSceneSettings m_Settings;
+	};
+
+	// All scenes above in order (0 = Scene_W1 ... 5 = Scene_W4_BunnyScene, 6 = Scene_File with Resources/reference_scene.rtscene,
+	// 7 = Scene_Stress with default settings, 8 = Scene_File with Resources/area_light_scene.rtscene,
+	// 9 = Scene_File with Resources/streaming_scene.rtscene), not initialized yet.
+	// Render workers use the index to load the same scene as the coordinator. Returns nullptr for an unknown index.
+	Scene* CreateScene(uint32_t sceneIndex);
 }
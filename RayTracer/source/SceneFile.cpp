@@ -0,0 +1,755 @@
+#include "SceneFile.h"
+#include "Material.h"
+#include "MappedFile.h"
+#include "StreamingMesh.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace dae;
+
+namespace
+{
+	enum class Keyword : uint8_t
+	{
+		Camera,
+		Material,
+		Sphere,
+		Plane,
+		Triangle,
+		Mesh,
+		Instance,
+		StreamMesh,
+		PointLight,
+		DirectionalLight,
+		SphereLight,
+		QuadLight
+	};
+
+	// One tokenized line, words point into the mapped file
+	struct Statement
+	{
+		static constexpr uint8_t MAX_WORDS{ 5 };
+		static constexpr uint8_t MAX_NUMBERS{ 16 };
+
+		Keyword keyword{};
+		uint8_t wordCount{};
+		uint8_t numberCount{};
+		uint32_t line{}; // within its chunk
+
+		std::string_view words[MAX_WORDS]{};
+		float numbers[MAX_NUMBERS]{};
+	};
+
+	// Part of the file that is parsed on its own thread, always starts at the beginning of a line
+	struct Chunk
+	{
+		const char* pBegin{};
+		const char* pEnd{};
+
+		uint32_t lineCount{};
+		std::vector<Statement> statements{};
+		std::vector<std::pair<uint32_t, std::string>> errors{};
+	};
+
+	constexpr size_t CHUNK_SIZE{ 1024 * 1024 };
+
+	bool ParseKeyword(std::string_view word, Keyword& keyword)
+	{
+		static const std::unordered_map<std::string_view, Keyword> keywords{
+			{ "camera", Keyword::Camera },
+			{ "material", Keyword::Material },
+			{ "sphere", Keyword::Sphere },
+			{ "plane", Keyword::Plane },
+			{ "triangle", Keyword::Triangle },
+			{ "mesh", Keyword::Mesh },
+			{ "instance", Keyword::Instance },
+			{ "streammesh", Keyword::StreamMesh },
+			{ "pointlight", Keyword::PointLight },
+			{ "directionallight", Keyword::DirectionalLight },
+			{ "spherelight", Keyword::SphereLight },
+			{ "quadlight", Keyword::QuadLight }
+		};
+
+		const auto it{ keywords.find(word) };
+		if (it == keywords.end()) return false;
+
+		keyword = it->second;
+		return true;
+	}
+
+	bool IsWhitespace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	void ParseChunk(Chunk& chunk)
+	{
+		const char* pLine{ chunk.pBegin };
+		while (pLine < chunk.pEnd)
+		{
+			const char* pLineEnd{ std::find(pLine, chunk.pEnd, '\n') };
+			const char* pContentEnd{ std::find(pLine, pLineEnd, '#') };
+			const uint32_t line{ chunk.lineCount++ };
+
+			Statement statement{};
+			statement.line = line;
+			bool hasKeyword{ false };
+
+			for (const char* pToken{ pLine }; pToken < pContentEnd;)
+			{
+				if (IsWhitespace(*pToken))
+				{
+					++pToken;
+					continue;
+				}
+
+				const char* pTokenEnd{ std::find_if(pToken, pContentEnd, IsWhitespace) };
+				const std::string_view token{ pToken, static_cast<size_t>(pTokenEnd - pToken) };
+				pToken = pTokenEnd;
+
+				if (!hasKeyword)
+				{
+					if (!ParseKeyword(token, statement.keyword))
+					{
+						chunk.errors.emplace_back(line, "unknown statement '" + std::string{ token } + "'");
+						break;
+					}
+					hasKeyword = true;
+					continue;
+				}
+
+				float number{};
+				const auto result{ std::from_chars(token.data(), token.data() + token.size(), number) };
+				if (result.ec == std::errc{} && result.ptr == token.data() + token.size())
+				{
+					if (statement.numberCount == Statement::MAX_NUMBERS)
+					{
+						chunk.errors.emplace_back(line, "too many numbers");
+						hasKeyword = false;
+						break;
+					}
+					statement.numbers[statement.numberCount++] = number;
+				}
+				else
+				{
+					if (statement.wordCount == Statement::MAX_WORDS)
+					{
+						chunk.errors.emplace_back(line, "too many names");
+						hasKeyword = false;
+						break;
+					}
+					statement.words[statement.wordCount++] = token;
+				}
+			}
+
+			if (hasKeyword)
+				chunk.statements.push_back(statement);
+
+			pLine = pLineEnd + 1;
+		}
+	}
+
+	bool ParseCullMode(std::string_view word, TriangleCullMode& cullMode)
+	{
+		if (word == "back") cullMode = TriangleCullMode::BackFaceCulling;
+		else if (word == "front") cullMode = TriangleCullMode::FrontFaceCulling;
+		else if (word == "none") cullMode = TriangleCullMode::NoCulling;
+		else return false;
+		return true;
+	}
+
+	// Optional trailing [tx ty tz [yawAngle [sx sy sz]]]
+	bool ParsePlacement(const float* pNumbers, uint8_t count, MeshPlacement& placement)
+	{
+		if (count != 0 && count != 3 && count != 4 && count != 7) return false;
+
+		if (count >= 3) placement.translation = { pNumbers[0], pNumbers[1], pNumbers[2] };
+		if (count >= 4) placement.yaw = pNumbers[3] * TO_RADIANS;
+		if (count == 7) placement.scale = { pNumbers[4], pNumbers[5], pNumbers[6] };
+		return true;
+	}
+
+	Vector3 ReadVector(const float* pNumbers)
+	{
+		return { pNumbers[0], pNumbers[1], pNumbers[2] };
+	}
+
+	// Runs in file order so names can be resolved, all the number parsing already happened in the chunks
+	class StatementApplier final
+	{
+	public:
+		explicit StatementApplier(SceneDescription& description) : m_Description(description) {}
+
+		// Returns an error message, empty on success
+		std::string Apply(const Statement& statement)
+		{
+			const auto expect = [&statement](uint8_t words, uint8_t minNumbers, uint8_t maxNumbers)
+			{
+				return statement.wordCount == words && statement.numberCount >= minNumbers && statement.numberCount <= maxNumbers;
+			};
+			const float* pNumbers{ statement.numbers };
+
+			switch (statement.keyword)
+			{
+			case Keyword::Camera:
+				if (!expect(0, 4, 7) || statement.numberCount == 5 || statement.numberCount == 6) return "expected camera x y z fovAngle [targetX targetY targetZ]";
+				m_Description.cameraOrigin = ReadVector(pNumbers);
+				m_Description.cameraFovAngle = pNumbers[3];
+				m_Description.hasCameraTarget = statement.numberCount == 7;
+				if (m_Description.hasCameraTarget) m_Description.cameraTarget = ReadVector(pNumbers + 4);
+				return {};
+
+			case Keyword::Material:
+			{
+				if (statement.wordCount != 2) return "expected material name type r g b [parameters...]";
+
+				MaterialDescription material{};
+				uint8_t parameterCount{};
+				if (statement.words[1] == "solid") { material.type = MaterialType::SolidColor; parameterCount = 0; }
+				else if (statement.words[1] == "lambert") { material.type = MaterialType::Lambert; parameterCount = 1; }
+				else if (statement.words[1] == "phong") { material.type = MaterialType::LambertPhong; parameterCount = 3; }
+				else if (statement.words[1] == "cooktorrence") { material.type = MaterialType::CookTorrence; parameterCount = 2; }
+				else return "unknown material type '" + std::string{ statement.words[1] } + "'";
+
+				if (statement.numberCount != 3 + parameterCount) return "wrong number of material parameters";
+				if (m_MaterialIndices.contains(statement.words[0])) return "material '" + std::string{ statement.words[0] } + "' already exists";
+				if (m_Description.materials.size() >= UINT8_MAX) return "too many materials (255)";
+
+				material.color = { pNumbers[0], pNumbers[1], pNumbers[2] };
+				std::copy_n(pNumbers + 3, parameterCount, material.parameters);
+
+				m_Description.materials.push_back(material);
+				m_MaterialIndices[statement.words[0]] = static_cast<unsigned char>(m_Description.materials.size());
+				return {};
+			}
+
+			case Keyword::Sphere:
+			{
+				if (!expect(1, 4, 4)) return "expected sphere x y z radius material";
+
+				Sphere sphere{ ReadVector(pNumbers), pNumbers[3] };
+				if (!FindMaterial(statement.words[0], sphere.materialIndex)) return UnknownMaterial(statement.words[0]);
+				m_Description.spheres.push_back(sphere);
+				return {};
+			}
+
+			case Keyword::Plane:
+			{
+				if (!expect(1, 6, 6)) return "expected plane x y z nx ny nz material";
+
+				Plane plane{ ReadVector(pNumbers), ReadVector(pNumbers + 3).Normalized() };
+				if (!FindMaterial(statement.words[0], plane.materialIndex)) return UnknownMaterial(statement.words[0]);
+				m_Description.planes.push_back(plane);
+				return {};
+			}
+
+			case Keyword::Triangle:
+			{
+				if (!expect(2, 9, 16)) return "expected triangle x0 y0 z0 x1 y1 z1 x2 y2 z2 cullMode material [tx ty tz [yawAngle [sx sy sz]]]";
+
+				MeshDescription mesh{};
+				MeshPlacement placement{};
+				if (!ParseCullMode(statement.words[0], mesh.cullMode)) return "unknown cull mode '" + std::string{ statement.words[0] } + "'";
+				if (!FindMaterial(statement.words[1], mesh.materialIndex)) return UnknownMaterial(statement.words[1]);
+				if (!ParsePlacement(pNumbers + 9, statement.numberCount - 9, placement)) return "expected [tx ty tz [yawAngle [sx sy sz]]] after the vertices";
+
+				const Triangle triangle{ ReadVector(pNumbers), ReadVector(pNumbers + 3), ReadVector(pNumbers + 6) };
+				mesh.positions = { triangle.v0, triangle.v1, triangle.v2 };
+				mesh.normals = { triangle.normal };
+				mesh.indices = { 0, 1, 2 };
+				mesh.placements.push_back(placement);
+
+				m_Description.meshes.push_back(std::move(mesh));
+				return {};
+			}
+
+			case Keyword::Mesh:
+			{
+				if (statement.wordCount != 4 && statement.wordCount != 5) return "expected mesh name file.obj cullMode material [compressed] [tx ty tz [yawAngle [sx sy sz]]]";
+				if (m_MeshIndices.contains(statement.words[0])) return "mesh '" + std::string{ statement.words[0] } + "' already exists";
+
+				MeshDescription mesh{};
+				MeshPlacement placement{};
+				mesh.filename = statement.words[1];
+				if (!ParseCullMode(statement.words[2], mesh.cullMode)) return "unknown cull mode '" + std::string{ statement.words[2] } + "'";
+				if (!FindMaterial(statement.words[3], mesh.materialIndex)) return UnknownMaterial(statement.words[3]);
+				if (statement.wordCount == 5)
+				{
+					if (statement.words[4] != "compressed") return "unknown mesh option '" + std::string{ statement.words[4] } + "'";
+					mesh.bvhMode = BVHMode::Compressed;
+				}
+				if (!ParsePlacement(pNumbers, statement.numberCount, placement)) return "expected [tx ty tz [yawAngle [sx sy sz]]] after the material";
+				mesh.placements.push_back(placement);
+
+				m_MeshIndices[statement.words[0]] = m_Description.meshes.size();
+				m_Description.meshes.push_back(std::move(mesh));
+				return {};
+			}
+
+			case Keyword::Instance:
+			{
+				if (statement.wordCount != 1) return "expected instance name [tx ty tz [yawAngle [sx sy sz]]]";
+
+				const auto it{ m_MeshIndices.find(statement.words[0]) };
+				if (it == m_MeshIndices.end()) return "unknown mesh '" + std::string{ statement.words[0] } + "'";
+
+				MeshPlacement placement{};
+				if (!ParsePlacement(pNumbers, statement.numberCount, placement)) return "expected [tx ty tz [yawAngle [sx sy sz]]] after the mesh name";
+				m_Description.meshes[it->second].placements.push_back(placement);
+				return {};
+			}
+
+			case Keyword::StreamMesh:
+			{
+				if (statement.wordCount != 3 || statement.numberCount < 1) return "expected streammesh file cullMode material residentBudgetMB [tx ty tz [yawAngle [sx sy sz]]]";
+				if (pNumbers[0] <= 0.f) return "the resident budget must be positive";
+
+				StreamingMeshDescription mesh{};
+				mesh.filename = statement.words[0];
+				if (!ParseCullMode(statement.words[1], mesh.cullMode)) return "unknown cull mode '" + std::string{ statement.words[1] } + "'";
+				if (!FindMaterial(statement.words[2], mesh.materialIndex)) return UnknownMaterial(statement.words[2]);
+				if (!ParsePlacement(pNumbers + 1, statement.numberCount - 1, mesh.placement)) return "expected [tx ty tz [yawAngle [sx sy sz]]] after the budget";
+				mesh.residentBudget = static_cast<uint64_t>(pNumbers[0] * 1024.f * 1024.f);
+
+				m_Description.streamingMeshes.push_back(std::move(mesh));
+				return {};
+			}
+
+			case Keyword::PointLight:
+			case Keyword::DirectionalLight:
+			{
+				if (!expect(0, 7, 7)) return "expected x y z intensity r g b";
+
+				Light light{};
+				light.intensity = pNumbers[3];
+				light.color = { pNumbers[4], pNumbers[5], pNumbers[6] };
+				if (statement.keyword == Keyword::PointLight)
+				{
+					light.type = LightType::Point;
+					light.origin = ReadVector(pNumbers);
+				}
+				else
+				{
+					light.type = LightType::Directional;
+					light.direction = ReadVector(pNumbers).Normalized();
+				}
+
+				m_Description.lights.push_back(light);
+				return {};
+			}
+
+			case Keyword::SphereLight:
+			{
+				if (!expect(0, 8, 8)) return "expected x y z radius intensity r g b";
+				if (pNumbers[3] <= 0.f) return "the radius must be positive";
+
+				Light light{};
+				light.type = LightType::SphereArea;
+				light.origin = ReadVector(pNumbers);
+				light.radius = pNumbers[3];
+				light.intensity = pNumbers[4];
+				light.color = { pNumbers[5], pNumbers[6], pNumbers[7] };
+
+				m_Description.lights.push_back(light);
+				return {};
+			}
+
+			case Keyword::QuadLight:
+			{
+				if (!expect(0, 13, 13)) return "expected x y z ux uy uz vx vy vz intensity r g b";
+
+				Light light{};
+				light.type = LightType::QuadArea;
+				light.origin = ReadVector(pNumbers);
+				light.extentU = ReadVector(pNumbers + 3);
+				light.extentV = ReadVector(pNumbers + 6);
+				light.intensity = pNumbers[9];
+				light.color = { pNumbers[10], pNumbers[11], pNumbers[12] };
+
+				m_Description.lights.push_back(light);
+				return {};
+			}
+			}
+
+			return "unsupported statement";
+		}
+
+	private:
+		SceneDescription& m_Description;
+
+		std::unordered_map<std::string_view, unsigned char> m_MaterialIndices{ { "default", 0 } };
+		std::unordered_map<std::string_view, size_t> m_MeshIndices{};
+
+		bool FindMaterial(std::string_view name, unsigned char& materialIndex) const
+		{
+			const auto it{ m_MaterialIndices.find(name) };
+			if (it == m_MaterialIndices.end()) return false;
+
+			materialIndex = it->second;
+			return true;
+		}
+
+		static std::string UnknownMaterial(std::string_view name)
+		{
+			return "unknown material '" + std::string{ name } + "'";
+		}
+	};
+
+	int64_t GetFileTime(const std::filesystem::path& path)
+	{
+		std::error_code error{};
+		const auto time{ std::filesystem::last_write_time(path, error) };
+		return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+	}
+
+	std::filesystem::path GetMeshPath(const std::string& sceneFilename, const std::string& meshFilename)
+	{
+		return std::filesystem::path{ sceneFilename }.parent_path() / meshFilename;
+	}
+
+	std::string GetCacheFilename(const std::string& filename)
+	{
+		return filename + ".cache";
+	}
+
+#pragma region Cache Serialization
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	void WriteVector(std::ofstream& file, const std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		WriteValue(file, static_cast<uint64_t>(values.size()));
+		file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	void WriteString(std::ofstream& file, const std::string& value)
+	{
+		WriteValue(file, static_cast<uint64_t>(value.size()));
+		file.write(value.data(), value.size());
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	// The count is checked against the bytes left so a damaged cache can't trigger a huge allocation
+	bool ReadCount(std::ifstream& file, size_t elementSize, uint64_t& count)
+	{
+		if (!ReadValue(file, count)) return false;
+
+		const auto position{ file.tellg() };
+		file.seekg(0, std::ios::end);
+		const auto remaining{ static_cast<uint64_t>(file.tellg() - position) };
+		file.seekg(position);
+
+		return count <= remaining / std::max<size_t>(elementSize, 1);
+	}
+
+	template<typename T>
+	bool ReadVector(std::ifstream& file, std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		uint64_t count{};
+		if (!ReadCount(file, sizeof(T), count)) return false;
+
+		values.resize(count);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T)));
+	}
+
+	bool ReadString(std::ifstream& file, std::string& value)
+	{
+		uint64_t count{};
+		if (!ReadCount(file, 1, count)) return false;
+
+		value.resize(count);
+		return static_cast<bool>(file.read(value.data(), count));
+	}
+#pragma endregion
+}
+
+Material* MaterialDescription::Create() const
+{
+	switch (type)
+	{
+	case MaterialType::Lambert: return new Material_Lambert(color, parameters[0]);
+	case MaterialType::LambertPhong: return new Material_LambertPhong(color, parameters[0], parameters[1], parameters[2]);
+	case MaterialType::CookTorrence: return new Material_CookTorrence(color, parameters[0], parameters[1]);
+	default: return new Material_SolidColor(color);
+	}
+}
+
+Matrix MeshPlacement::GetTransform() const
+{
+	return Matrix::CreateScale(scale) * Matrix::CreateRotationY(yaw) * Matrix::CreateTranslation(translation);
+}
+
+bool SceneFile::Load(const std::string& filename, SceneDescription& description)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	const bool isCached{ ReadCache(filename, description) };
+	if (!isCached)
+	{
+		description = {};
+		if (!ParseText(filename, description) || !LoadMeshFiles(filename, description)) return false;
+
+		if (!WriteCache(filename, description))
+			std::cout << "Failed to write scene cache " << GetCacheFilename(filename) << std::endl;
+	}
+
+	if (!PrepareStreamingMeshes(filename, description)) return false;
+
+	size_t triangleCount{}, instanceCount{};
+	for (const MeshDescription& mesh : description.meshes)
+	{
+		triangleCount += mesh.indices.size() / 3;
+		instanceCount += mesh.placements.size();
+	}
+
+	const auto duration{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+	std::cout << "Scene " << filename << (isCached ? " (cache)" : "") << " loaded in " << duration << " ms: "
+		<< description.spheres.size() << " spheres, " << description.planes.size() << " planes, "
+		<< description.meshes.size() << " meshes (" << triangleCount << " triangles, " << instanceCount << " instances), "
+		<< description.streamingMeshes.size() << " streaming meshes, "
+		<< description.lights.size() << " lights\n";
+	return true;
+}
+
+bool SceneFile::ParseText(const std::string& filename, SceneDescription& description)
+{
+	MappedFile file{};
+	if (!file.Open(filename))
+	{
+		std::cout << "Failed to open scene file " << filename << std::endl;
+		return false;
+	}
+
+	// Split at line boundaries, every chunk is tokenized and parsed on its own
+	const char* pData{ reinterpret_cast<const char*>(file.GetData()) };
+	const char* pDataEnd{ pData + file.GetSize() };
+
+	std::vector<Chunk> chunks{};
+	for (const char* pBegin{ pData }; pBegin < pDataEnd;)
+	{
+		const char* pEnd{ pDataEnd };
+		if (static_cast<size_t>(pDataEnd - pBegin) > CHUNK_SIZE)
+			pEnd = std::find(pBegin + CHUNK_SIZE, pDataEnd, '\n');
+		if (pEnd < pDataEnd) ++pEnd;
+
+		chunks.push_back({ pBegin, pEnd });
+		pBegin = pEnd;
+	}
+
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(), ParseChunk);
+
+	// Resolving names is cheap compared to parsing, do it in file order
+	StatementApplier applier{ description };
+	std::vector<std::pair<uint32_t, std::string>> errors{};
+	uint32_t firstLine{ 1 };
+
+	for (const Chunk& chunk : chunks)
+	{
+		for (const auto& [line, message] : chunk.errors)
+		{
+			errors.emplace_back(firstLine + line, message);
+		}
+
+		for (const Statement& statement : chunk.statements)
+		{
+			std::string message{ applier.Apply(statement) };
+			if (!message.empty())
+				errors.emplace_back(firstLine + statement.line, std::move(message));
+		}
+
+		firstLine += chunk.lineCount;
+	}
+
+	std::stable_sort(errors.begin(), errors.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	for (const auto& [line, message] : errors)
+	{
+		std::cout << filename << "(" << line << "): " << message << "\n";
+	}
+
+	return errors.empty();
+}
+
+bool SceneFile::LoadMeshFiles(const std::string& sceneFilename, SceneDescription& description)
+{
+	std::atomic<bool> isValid{ true };
+
+	std::for_each(std::execution::par, description.meshes.begin(), description.meshes.end(), [&](MeshDescription& mesh)
+	{
+		if (mesh.filename.empty()) return;
+
+		const std::filesystem::path path{ GetMeshPath(sceneFilename, mesh.filename) };
+		mesh.fileTime = GetFileTime(path);
+
+		if (!Utils::ParseOBJ(path.string(), mesh.positions, mesh.normals, mesh.indices) || mesh.indices.empty())
+		{
+			std::cout << "Failed to load mesh " << path.string() << "\n";
+			isValid = false;
+		}
+	});
+
+	return isValid;
+}
+
+bool SceneFile::PrepareStreamingMeshes(const std::string& sceneFilename, SceneDescription& description)
+{
+	for (StreamingMeshDescription& mesh : description.streamingMeshes)
+	{
+		const std::filesystem::path path{ GetMeshPath(sceneFilename, mesh.filename) };
+		if (path.extension() != ".obj")
+		{
+			mesh.streamFilename = path.string();
+			continue;
+		}
+
+		std::filesystem::path streamPath{ path };
+		streamPath.replace_extension(".rtsm");
+		mesh.streamFilename = streamPath.string();
+
+		const int64_t streamTime{ GetFileTime(streamPath) };
+		if (streamTime != 0 && streamTime >= GetFileTime(path)) continue;
+
+		std::cout << "Converting " << path.string() << " to " << mesh.streamFilename << "\n";
+		if (!StreamingMesh::ConvertOBJ(path.string(), mesh.streamFilename))
+		{
+			std::cout << "Failed to convert mesh " << path.string() << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool SceneFile::WriteCache(const std::string& filename, const SceneDescription& description)
+{
+	std::error_code error{};
+	CacheHeader header{};
+	header.sourceTime = GetFileTime(filename);
+	header.sourceSize = std::filesystem::file_size(filename, error);
+	if (error) return false;
+
+	std::ofstream file{ GetCacheFilename(filename), std::ios::binary };
+	if (!file) return false;
+
+	WriteValue(file, header);
+
+	WriteValue(file, description.cameraOrigin);
+	WriteValue(file, description.cameraFovAngle);
+	WriteValue(file, description.hasCameraTarget);
+	WriteValue(file, description.cameraTarget);
+
+	WriteVector(file, description.materials);
+	WriteVector(file, description.spheres);
+	WriteVector(file, description.planes);
+	WriteVector(file, description.lights);
+
+	WriteValue(file, static_cast<uint64_t>(description.meshes.size()));
+	for (const MeshDescription& mesh : description.meshes)
+	{
+		WriteString(file, mesh.filename);
+		WriteValue(file, mesh.fileTime);
+		WriteValue(file, mesh.cullMode);
+		WriteValue(file, mesh.materialIndex);
+		WriteValue(file, mesh.bvhMode);
+		WriteVector(file, mesh.placements);
+		WriteVector(file, mesh.positions);
+		WriteVector(file, mesh.normals);
+		WriteVector(file, mesh.indices);
+	}
+
+	WriteValue(file, static_cast<uint64_t>(description.streamingMeshes.size()));
+	for (const StreamingMeshDescription& mesh : description.streamingMeshes)
+	{
+		WriteString(file, mesh.filename);
+		WriteValue(file, mesh.cullMode);
+		WriteValue(file, mesh.materialIndex);
+		WriteValue(file, mesh.residentBudget);
+		WriteValue(file, mesh.placement);
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool SceneFile::ReadCache(const std::string& filename, SceneDescription& description)
+{
+	std::ifstream file{ GetCacheFilename(filename), std::ios::binary };
+	if (!file) return false;
+
+	std::error_code error{};
+	const uint64_t sourceSize{ std::filesystem::file_size(filename, error) };
+
+	CacheHeader header{};
+	if (!ReadValue(file, header) || header.magic != CacheHeader::MAGIC || header.version != CacheHeader::VERSION
+		|| error || header.sourceSize != sourceSize || header.sourceTime != GetFileTime(filename))
+		return false;
+
+	bool isValid{ ReadValue(file, description.cameraOrigin)
+		&& ReadValue(file, description.cameraFovAngle)
+		&& ReadValue(file, description.hasCameraTarget)
+		&& ReadValue(file, description.cameraTarget)
+		&& ReadVector(file, description.materials)
+		&& ReadVector(file, description.spheres)
+		&& ReadVector(file, description.planes)
+		&& ReadVector(file, description.lights) };
+
+	uint64_t meshCount{};
+	isValid = isValid && ReadValue(file, meshCount);
+
+	description.meshes.clear();
+	for (uint64_t i{}; isValid && i < meshCount; ++i)
+	{
+		MeshDescription& mesh{ description.meshes.emplace_back() };
+		isValid = ReadString(file, mesh.filename)
+			&& ReadValue(file, mesh.fileTime)
+			&& ReadValue(file, mesh.cullMode)
+			&& ReadValue(file, mesh.materialIndex)
+			&& ReadValue(file, mesh.bvhMode)
+			&& ReadVector(file, mesh.placements)
+			&& ReadVector(file, mesh.positions)
+			&& ReadVector(file, mesh.normals)
+			&& ReadVector(file, mesh.indices);
+
+		// An edited OBJ invalidates the whole cache
+		if (isValid && !mesh.filename.empty())
+			isValid = mesh.fileTime == GetFileTime(GetMeshPath(filename, mesh.filename));
+	}
+
+	uint64_t streamingMeshCount{};
+	isValid = isValid && ReadValue(file, streamingMeshCount);
+
+	description.streamingMeshes.clear();
+	for (uint64_t i{}; isValid && i < streamingMeshCount; ++i)
+	{
+		StreamingMeshDescription& mesh{ description.streamingMeshes.emplace_back() };
+		isValid = ReadString(file, mesh.filename)
+			&& ReadValue(file, mesh.cullMode)
+			&& ReadValue(file, mesh.materialIndex)
+			&& ReadValue(file, mesh.residentBudget)
+			&& ReadValue(file, mesh.placement);
+	}
+
+	return isValid;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Forward Declarations
+	class Material;
+
+	enum class MaterialType : uint8_t
+	{
+		SolidColor, // solid r g b
+		Lambert, // lambert r g b reflectance
+		LambertPhong, // phong r g b kd ks exponent
+		CookTorrence // cooktorrence r g b metalness roughness
+	};
+
+	struct MaterialDescription
+	{
+		MaterialType type{};
+		ColorRGB color{};
+		float parameters[3]{};
+
+		Material* Create() const;
+	};
+
+	// Scale, then rotation around Y, then translation, like TriangleMesh
+	struct MeshPlacement
+	{
+		Vector3 translation{};
+		float yaw{}; // radians
+		Vector3 scale{ 1.f, 1.f, 1.f };
+
+		Matrix GetTransform() const;
+	};
+
+	struct MeshDescription
+	{
+		std::string filename{}; // OBJ relative to the scene file, empty for inline triangles
+		int64_t fileTime{}; // last write time of the OBJ, invalidates the cache
+
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+		unsigned char materialIndex{};
+		BVHMode bvhMode{ BVHMode::Full }; // "compressed" trades traversal speed for memory, for large scanned assets
+
+		// The first placement is the mesh itself, the others are instances sharing its geometry and BVH
+		std::vector<MeshPlacement> placements{};
+
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+	};
+
+	// Out-of-core mesh, see StreamingMesh
+	struct StreamingMeshDescription
+	{
+		std::string filename{}; // .rtsm or OBJ relative to the scene file
+		std::string streamFilename{}; // .rtsm to open, set by SceneFile::Load (not cached)
+
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+		unsigned char materialIndex{};
+		uint64_t residentBudget{}; // bytes
+
+		MeshPlacement placement{};
+	};
+
+	// Everything a scene file describes, with material references resolved to indices (0 is the scene's default material)
+	struct SceneDescription
+	{
+		Vector3 cameraOrigin{};
+		float cameraFovAngle{ 90.f };
+		bool hasCameraTarget{ false };
+		Vector3 cameraTarget{};
+
+		std::vector<MaterialDescription> materials{}; // scene material 1 and up
+		std::vector<Sphere> spheres{};
+		std::vector<Plane> planes{};
+		std::vector<Light> lights{};
+		std::vector<MeshDescription> meshes{};
+		std::vector<StreamingMeshDescription> streamingMeshes{};
+	};
+
+	// Line based .rtscene text format, one statement per line, '#' starts a comment:
+	//   camera x y z fovAngle [targetX targetY targetZ]
+	//   material name solid|lambert|phong|cooktorrence r g b [parameters...]
+	//   sphere x y z radius material
+	//   plane x y z nx ny nz material
+	//   triangle x0 y0 z0 x1 y1 z1 x2 y2 z2 back|front|none material
+	//   mesh name file.obj back|front|none material [compressed] [tx ty tz [yawAngle [sx sy sz]]]
+	//   instance name [tx ty tz [yawAngle [sx sy sz]]]
+	//   streammesh file.rtsm|file.obj back|front|none material residentBudgetMB [tx ty tz [yawAngle [sx sy sz]]]
+	//   pointlight x y z intensity r g b
+	//   directionallight dx dy dz intensity r g b
+	//   spherelight x y z radius intensity r g b
+	//   quadlight x y z ux uy uz vx vy vz intensity r g b (u and v go from the center to the edges)
+	// Materials and meshes must be declared before they are used, "default" is the scene's default material.
+	// A streammesh OBJ is converted to an .rtsm next to it on the first load and again whenever the OBJ changes.
+	// The file is memory mapped and parsed in parallel chunks, OBJs are loaded in parallel.
+	// A loaded scene is cached next to the file (file + ".cache"), later loads read the cache
+	// as long as the scene file and its OBJs haven't changed.
+	class SceneFile final
+	{
+	public:
+		static bool Load(const std::string& filename, SceneDescription& description);
+
+		static bool ParseText(const std::string& filename, SceneDescription& description);
+
+		// filename is the scene file, the cache is stored next to it
+		static bool WriteCache(const std::string& filename, const SceneDescription& description);
+		// Fails when the cache is missing, outdated or written by another version
+		static bool ReadCache(const std::string& filename, SceneDescription& description);
+
+	private:
+		struct CacheHeader
+		{
+			static constexpr uint32_t MAGIC{ 0x42535452 }; // "RTSB"
+			static constexpr uint32_t VERSION{ 4 };
+
+			uint32_t magic{ MAGIC };
+			uint32_t version{ VERSION };
+			int64_t sourceTime{};
+			uint64_t sourceSize{};
+		};
+
+		static bool LoadMeshFiles(const std::string& sceneFilename, SceneDescription& description);
+		// Resolves the .rtsm of every streaming mesh, converting OBJs that have no up to date one
+		static bool PrepareStreamingMeshes(const std::string& sceneFilename, SceneDescription& description);
+	};
+}
@@ -0,0 +1,323 @@
+#include "SceneSnapshot.h"
+#include "StreamingMesh.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+namespace dae {
+
+	namespace
+	{
+		// Conservative: may keep spheres just outside of the cone, never drops one that intersects it.
+		// A ray toward a point within lightRadius of the apex stays within lightRadius of the cone, hence the inflation.
+		bool SphereIntersectsCone(const Vector3& center, float radius, const ShadowPacket& cone)
+		{
+			radius += cone.lightRadius;
+
+			const Vector3 toCenter{ center - cone.apex };
+			const float axialDistance{ Vector3::Dot(toCenter, cone.axis) };
+			if (axialDistance < -radius || axialDistance > cone.length + radius) return false;
+
+			const float radialDistance{ sqrtf(std::max(toCenter.SqrMagnitude() - axialDistance * axialDistance, 0.f)) };
+			return cone.cosAngle * radialDistance - cone.sinAngle * axialDistance <= radius;
+		}
+
+		bool PlaneIntersectsCone(const Plane& plane, const ShadowPacket& cone)
+		{
+			const Vector3 normal{ plane.normal.Normalized() };
+			const float apexDistance{ Vector3::Dot(cone.apex - plane.origin, normal) };
+
+			// Extremes of dot(normal, direction) over all directions inside the cone
+			const float cosNormal{ Vector3::Dot(normal, cone.axis) };
+			const float sinNormal{ sqrtf(std::max(1.f - cosNormal * cosNormal, 0.f)) };
+			const float maxDot{ cosNormal >= cone.cosAngle ? 1.f : cosNormal * cone.cosAngle + sinNormal * cone.sinAngle };
+			const float minDot{ -cosNormal >= cone.cosAngle ? -1.f : cosNormal * cone.cosAngle - sinNormal * cone.sinAngle };
+
+			const float lowest{ apexDistance + cone.length * std::min(minDot, 0.f) };
+			const float highest{ apexDistance + cone.length * std::max(maxDot, 0.f) };
+			return lowest <= cone.lightRadius && highest >= -cone.lightRadius;
+		}
+
+		bool AABBIntersectsCone(const Vector3& minAABB, const Vector3& maxAABB, const ShadowPacket& cone)
+		{
+			return SphereIntersectsCone((minAABB + maxAABB) * 0.5f, (maxAABB - minAABB).Magnitude() * 0.5f, cone);
+		}
+	}
+
+	bool ShadowPacket::Build(const Vector3& lightOrigin, float radius, const Vector3* pRayOrigins, size_t rayCount)
+	{
+		apex = lightOrigin;
+		lightRadius = radius;
+		axis = {};
+		length = 0.f;
+		for (size_t i{}; i < rayCount; ++i)
+		{
+			const Vector3 toOrigin{ pRayOrigins[i] - apex };
+			const float distance{ toOrigin.Magnitude() };
+			if (distance <= 0.f) return false;
+
+			axis += toOrigin / distance;
+			length = std::max(length, distance);
+		}
+
+		const float axisLength{ axis.Magnitude() };
+		if (axisLength <= 0.f) return false;
+		axis /= axisLength;
+
+		cosAngle = 1.f;
+		for (size_t i{}; i < rayCount; ++i)
+		{
+			cosAngle = std::min(cosAngle, Vector3::Dot(axis, (pRayOrigins[i] - apex).Normalized()));
+		}
+
+		// Past ~80 degrees the cone keeps about everything anyway
+		constexpr float minCosAngle{ 0.17f };
+		if (cosAngle < minCosAngle) return false;
+
+		// A little margin against rounding, the culling has to stay conservative
+		const float angle{ acosf(std::min(cosAngle, 1.f)) + 0.001f };
+		cosAngle = cosf(angle);
+		sinAngle = sinf(angle);
+		length = length * 1.001f + 0.001f;
+
+		return true;
+	}
+
+	void SceneSnapshot::CullShadowPacket(ShadowPacket& packet) const
+	{
+		packet.spheres.clear();
+		packet.planes.clear();
+		packet.meshLeaves.clear();
+		packet.leaves.clear();
+		packet.triangleMeshes.clear();
+		packet.streamingMeshes.clear();
+
+		for (uint32_t i{}; i < spheres.size(); ++i)
+		{
+			if (SphereIntersectsCone(spheres[i].origin, spheres[i].radius, packet)) packet.spheres.push_back(i);
+		}
+
+		for (uint32_t i{}; i < planes.size(); ++i)
+		{
+			if (PlaneIntersectsCone(planes[i], packet)) packet.planes.push_back(i);
+		}
+
+		for (uint32_t i{}; i < triangleMeshes.size(); ++i)
+		{
+			const TriangleMesh& mesh = *triangleMeshes[i].pMesh;
+			const MeshInstance& instance = triangleMeshes[i].instance;
+			if (!AABBIntersectsCone(instance.transformedAABB.minAABB, instance.transformedAABB.maxAABB, packet)) continue;
+
+			if (!mesh.bvh.IsBuilt() || mesh.bvh.GetMode() != BVHMode::Full)
+			{
+				packet.triangleMeshes.push_back(i);
+				continue;
+			}
+
+			// Node boxes are in object space, their bounding spheres go to world space with the largest axis scale
+			const Matrix& worldTransform = instance.worldTransform;
+			const float maxScale{ std::max({ worldTransform.GetAxisX().Magnitude(), worldTransform.GetAxisY().Magnitude(), worldTransform.GetAxisZ().Magnitude() }) };
+			const std::vector<BVHNode>& nodes = mesh.bvh.GetNodes();
+
+			const auto isInsideCone = [&](const BVHNode& node)
+			{
+				const Vector3 center{ worldTransform.TransformPoint((node.minAABB + node.maxAABB) * 0.5f) };
+				return SphereIntersectsCone(center, (node.maxAABB - node.minAABB).Magnitude() * 0.5f * maxScale, packet);
+			};
+
+			ShadowPacket::MeshLeaves meshLeaves{ i, static_cast<uint32_t>(packet.leaves.size()), 0 };
+
+			constexpr int maxStackSize{ 64 };
+			uint32_t stack[maxStackSize];
+			int stackSize{ 0 };
+			if (isInsideCone(nodes[0])) stack[stackSize++] = 0;
+
+			while (stackSize > 0)
+			{
+				const uint32_t nodeIndex{ stack[--stackSize] };
+				const BVHNode& node = nodes[nodeIndex];
+
+				if (node.IsLeaf())
+				{
+					packet.leaves.push_back(nodeIndex);
+					continue;
+				}
+
+				for (uint32_t child : { node.leftFirst, node.leftFirst + 1 })
+				{
+					if (!isInsideCone(nodes[child])) continue;
+
+					assert(stackSize < maxStackSize && "BVH traversal stack overflow");
+					stack[stackSize++] = child;
+				}
+			}
+
+			meshLeaves.leafCount = static_cast<uint32_t>(packet.leaves.size()) - meshLeaves.firstLeaf;
+			if (meshLeaves.leafCount > 0) packet.meshLeaves.push_back(meshLeaves);
+		}
+
+		for (uint32_t i{}; i < streamingMeshes.size(); ++i)
+		{
+			const AABB& aabb = streamingMeshes[i].instance.transformedAABB;
+			if (AABBIntersectsCone(aabb.minAABB, aabb.maxAABB, packet)) packet.streamingMeshes.push_back(i);
+		}
+	}
+
+	void SceneSnapshot::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	{
+		for (const Sphere& sphere : spheres)
+		{
+			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+		}
+
+		for (const Plane& plane : planes)
+		{
+			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+		}
+
+		for (const TriangleMeshEntry& entry : triangleMeshes)
+		{
+			GeometryUtils::HitTest_TriangleMesh(*entry.pMesh, entry.instance, ray, closestHit);
+		}
+
+		for (const StreamingMeshEntry& entry : streamingMeshes)
+		{
+			GeometryUtils::HitTest_StreamingMesh(*entry.pMesh, entry.instance, ray, closestHit);
+		}
+	}
+
+	bool SceneSnapshot::DoesHit(const Ray& ray) const
+	{
+		ShadowOccluder occluder{};
+		return DoesHit(ray, occluder);
+	}
+
+	bool SceneSnapshot::DoesHit(const Ray& ray, ShadowOccluder& occluder) const
+	{
+		for (uint32_t i{}; i < spheres.size(); ++i)
+		{
+			if (GeometryUtils::HitTest_Sphere(spheres[i], ray))
+			{
+				occluder = { ShadowOccluder::Type::Sphere, i };
+				return true;
+			}
+		}
+
+		for (uint32_t i{}; i < planes.size(); ++i)
+		{
+			if (GeometryUtils::HitTest_Plane(planes[i], ray))
+			{
+				occluder = { ShadowOccluder::Type::Plane, i };
+				return true;
+			}
+		}
+
+		for (uint32_t i{}; i < triangleMeshes.size(); ++i)
+		{
+			uint32_t triangleIndex{};
+			if (GeometryUtils::HitTest_TriangleMesh(*triangleMeshes[i].pMesh, triangleMeshes[i].instance, ray, &triangleIndex))
+			{
+				occluder = { ShadowOccluder::Type::TriangleMesh, i, triangleIndex };
+				return true;
+			}
+		}
+
+		for (uint32_t i{}; i < streamingMeshes.size(); ++i)
+		{
+			uint32_t triangleIndex{};
+			if (GeometryUtils::HitTest_StreamingMesh(*streamingMeshes[i].pMesh, streamingMeshes[i].instance, ray, &triangleIndex))
+			{
+				occluder = { ShadowOccluder::Type::StreamingMesh, i, triangleIndex };
+				return true;
+			}
+		}
+
+		// Neighbouring rays are likely unblocked as well, don't make them test a stale occluder
+		occluder.type = ShadowOccluder::Type::None;
+		return false;
+	}
+
+	bool SceneSnapshot::DoesHit(const Ray& ray, const ShadowPacket& packet, ShadowOccluder& occluder) const
+	{
+		for (uint32_t i : packet.spheres)
+		{
+			if (GeometryUtils::HitTest_Sphere(spheres[i], ray))
+			{
+				occluder = { ShadowOccluder::Type::Sphere, i };
+				return true;
+			}
+		}
+
+		for (uint32_t i : packet.planes)
+		{
+			if (GeometryUtils::HitTest_Plane(planes[i], ray))
+			{
+				occluder = { ShadowOccluder::Type::Plane, i };
+				return true;
+			}
+		}
+
+		for (const ShadowPacket::MeshLeaves& meshLeaves : packet.meshLeaves)
+		{
+			const TriangleMeshEntry& entry = triangleMeshes[meshLeaves.meshIndex];
+			uint32_t triangleIndex{};
+			if (GeometryUtils::HitTest_TriangleMeshLeaves(*entry.pMesh, entry.instance, packet.leaves.data() + meshLeaves.firstLeaf, meshLeaves.leafCount, ray, &triangleIndex))
+			{
+				occluder = { ShadowOccluder::Type::TriangleMesh, meshLeaves.meshIndex, triangleIndex };
+				return true;
+			}
+		}
+
+		for (uint32_t i : packet.triangleMeshes)
+		{
+			uint32_t triangleIndex{};
+			if (GeometryUtils::HitTest_TriangleMesh(*triangleMeshes[i].pMesh, triangleMeshes[i].instance, ray, &triangleIndex))
+			{
+				occluder = { ShadowOccluder::Type::TriangleMesh, i, triangleIndex };
+				return true;
+			}
+		}
+
+		for (uint32_t i : packet.streamingMeshes)
+		{
+			uint32_t triangleIndex{};
+			if (GeometryUtils::HitTest_StreamingMesh(*streamingMeshes[i].pMesh, streamingMeshes[i].instance, ray, &triangleIndex))
+			{
+				occluder = { ShadowOccluder::Type::StreamingMesh, i, triangleIndex };
+				return true;
+			}
+		}
+
+		occluder.type = ShadowOccluder::Type::None;
+		return false;
+	}
+
+	bool SceneSnapshot::DoesHitOccluder(const Ray& ray, const ShadowOccluder& occluder) const
+	{
+		// The index can be stale (other snapshot, other scene), that only costs a test
+		switch (occluder.type)
+		{
+		case ShadowOccluder::Type::Sphere:
+			return occluder.index < spheres.size() && GeometryUtils::HitTest_Sphere(spheres[occluder.index], ray);
+		case ShadowOccluder::Type::Plane:
+			return occluder.index < planes.size() && GeometryUtils::HitTest_Plane(planes[occluder.index], ray);
+		case ShadowOccluder::Type::TriangleMesh:
+		{
+			if (occluder.index >= triangleMeshes.size()) return false;
+			const TriangleMeshEntry& entry = triangleMeshes[occluder.index];
+			return occluder.triangleIndex < entry.pMesh->indices.size() / 3
+				&& GeometryUtils::HitTest_TriangleMeshTriangle(*entry.pMesh, entry.instance, occluder.triangleIndex, ray);
+		}
+		case ShadowOccluder::Type::StreamingMesh:
+		{
+			if (occluder.index >= streamingMeshes.size()) return false;
+			const StreamingMeshEntry& entry = streamingMeshes[occluder.index];
+			return occluder.triangleIndex < entry.pMesh->GetTriangleCount()
+				&& GeometryUtils::HitTest_StreamingMeshTriangle(*entry.pMesh, entry.instance, occluder.triangleIndex, ray);
+		}
+		default:
+			return false;
+		}
+	}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Forward Declarations
+	class Material;
+	class StreamingMesh;
+
+	// Primitive that blocked an earlier shadow ray, only a hint: whatever it is, a hit means the ray is blocked
+	struct ShadowOccluder
+	{
+		enum class Type : uint8_t
+		{
+			None,
+			Sphere,
+			Plane,
+			TriangleMesh,
+			StreamingMesh
+		};
+
+		Type type{ Type::None };
+		uint32_t index{}; // into the snapshot vector of its type
+		uint32_t triangleIndex{}; // meshes: the triangle that blocked the ray, the only one DoesHitOccluder tests
+	};
+
+	// Shadow rays toward one light from a tile of pixels. A cone with its apex in the light bounds all of them,
+	// primitives outside of it can't block any ray of the packet. Filled by SceneSnapshot::CullShadowPacket.
+	// For area lights the cone is widened by the light's bounding radius, their rays end anywhere on the light.
+	struct ShadowPacket
+	{
+		struct MeshLeaves
+		{
+			uint32_t meshIndex{}; // into SceneSnapshot::triangleMeshes
+			uint32_t firstLeaf{}; // into leaves
+			uint32_t leafCount{};
+		};
+
+		Vector3 apex{};
+		Vector3 axis{};
+		float cosAngle{};
+		float sinAngle{};
+		float length{};
+		float lightRadius{}; // area lights: the rays end anywhere within this distance of the apex
+
+		std::vector<uint32_t> spheres{};
+		std::vector<uint32_t> planes{};
+		std::vector<MeshLeaves> meshLeaves{}; // meshes with a full BVH, only the leaves inside the cone
+		std::vector<uint32_t> leaves{}; // BVH node indices
+		std::vector<uint32_t> triangleMeshes{}; // compressed or no BVH, traced per ray
+		std::vector<uint32_t> streamingMeshes{};
+
+		// False when the rays spread too wide for a cone to cull anything (the light sits among the origins)
+		bool Build(const Vector3& lightOrigin, float lightRadius, const Vector3* pRayOrigins, size_t rayCount);
+	};
+
+	// Immutable copy of everything Update is allowed to change (camera, lights, primitives, mesh transforms).
+	// Render threads only read the snapshot of their frame, so the main thread can update the next frame in the meantime.
+	// Mesh geometry and materials are shared, they don't change after Scene::Initialize.
+	struct SceneSnapshot
+	{
+		struct TriangleMeshEntry
+		{
+			const TriangleMesh* pMesh{};
+			MeshInstance instance{};
+		};
+
+		struct StreamingMeshEntry
+		{
+			const StreamingMesh* pMesh{};
+			MeshInstance instance{};
+		};
+
+		Vector3 cameraOrigin{};
+		Matrix cameraToWorld{};
+		float fov{};
+		float time{}; // timer total the scene was updated with
+
+		std::vector<Sphere> spheres{};
+		std::vector<Plane> planes{};
+		std::vector<TriangleMeshEntry> triangleMeshes{};
+		std::vector<StreamingMeshEntry> streamingMeshes{};
+		std::vector<Light> lights{};
+
+		const std::vector<Material*>* pMaterials{};
+
+		const std::vector<Material*>& GetMaterials() const { return *pMaterials; }
+
+		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		bool DoesHit(const Ray& ray) const;
+		// Same as DoesHit, also records the blocking primitive in occluder (Type::None when unblocked)
+		bool DoesHit(const Ray& ray, ShadowOccluder& occluder) const;
+		// Keeps the primitives and BVH leaves of the packet that intersect its cone
+		void CullShadowPacket(ShadowPacket& packet) const;
+		// DoesHit for a ray of the culled packet, only tests what's left in the packet
+		bool DoesHit(const Ray& ray, const ShadowPacket& packet, ShadowOccluder& occluder) const;
+		// Only tests the recorded occluder, false when it doesn't block the ray (anymore)
+		bool DoesHitOccluder(const Ray& ray, const ShadowOccluder& occluder) const;
+	};
+}
@@ -0,0 +1,207 @@
+#include "Socket.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <utility>
+
+using namespace dae;
+
+namespace
+{
+#if defined(_WIN32)
+	constexpr int SEND_FLAGS{ 0 };
+
+	void CloseHandle(Socket::Handle handle) { closesocket(static_cast<SOCKET>(handle)); }
+	int PollSocket(pollfd* pDescriptors, int timeoutMs) { return WSAPoll(pDescriptors, 1, timeoutMs); }
+#else
+	constexpr int SEND_FLAGS{ MSG_NOSIGNAL }; // a lost peer should fail the send, not kill the process
+
+	void CloseHandle(Socket::Handle handle) { close(handle); }
+	int PollSocket(pollfd* pDescriptors, int timeoutMs) { return poll(pDescriptors, 1, timeoutMs); }
+#endif
+
+	// Tiles are small messages, don't let Nagle hold them back
+	void DisableNagle(Socket::Handle handle)
+	{
+		int enable{ 1 };
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+	}
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+Socket::Socket(Socket&& other) noexcept
+	: m_Handle(std::exchange(other.m_Handle, InvalidHandle()))
+{
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_Handle = std::exchange(other.m_Handle, InvalidHandle());
+	}
+	return *this;
+}
+
+bool Socket::InitializeNetwork()
+{
+#if defined(_WIN32)
+	static const bool isInitialized = []()
+	{
+		WSADATA data{};
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return isInitialized;
+#else
+	return true;
+#endif
+}
+
+bool Socket::Listen(uint16_t port)
+{
+	Close();
+
+	m_Handle = static_cast<Handle>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if (!IsValid()) return false;
+
+	int reuse{ 1 };
+	setsockopt(m_Handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (bind(m_Handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(m_Handle, SOMAXCONN) != 0)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+Socket Socket::Accept(int timeoutMs)
+{
+	pollfd descriptor{};
+	descriptor.fd = m_Handle;
+	descriptor.events = POLLIN;
+
+	if (PollSocket(&descriptor, timeoutMs) <= 0) return Socket{};
+
+	const Handle handle{ static_cast<Handle>(accept(m_Handle, nullptr, nullptr)) };
+	if (handle == InvalidHandle()) return Socket{};
+
+	DisableNagle(handle);
+	return Socket{ handle };
+}
+
+bool Socket::Connect(const std::string& host, uint16_t port)
+{
+	Close();
+
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo* pResult{ nullptr };
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pResult) != 0) return false;
+
+	for (addrinfo* pAddress{ pResult }; pAddress; pAddress = pAddress->ai_next)
+	{
+		m_Handle = static_cast<Handle>(socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol));
+		if (!IsValid()) continue;
+
+		if (connect(m_Handle, pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0) break;
+		Close();
+	}
+	freeaddrinfo(pResult);
+
+	if (!IsValid()) return false;
+
+	DisableNagle(m_Handle);
+	return true;
+}
+
+bool Socket::Send(const void* pData, size_t size)
+{
+	const char* pBytes{ static_cast<const char*>(pData) };
+	while (size > 0)
+	{
+		const int chunkSize{ static_cast<int>(std::min<size_t>(size, 1 << 30)) };
+		const auto sent{ send(m_Handle, pBytes, chunkSize, SEND_FLAGS) };
+		if (sent <= 0) return false;
+
+		pBytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+bool Socket::Receive(void* pData, size_t size)
+{
+	char* pBytes{ static_cast<char*>(pData) };
+	while (size > 0)
+	{
+		const int chunkSize{ static_cast<int>(std::min<size_t>(size, 1 << 30)) };
+		const auto received{ recv(m_Handle, pBytes, chunkSize, 0) };
+		if (received <= 0) return false;
+
+		pBytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+void Socket::SetReceiveTimeout(int timeoutMs)
+{
+#if defined(_WIN32)
+	const DWORD timeout{ static_cast<DWORD>(timeoutMs) };
+#else
+	const timeval timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+#endif
+	setsockopt(m_Handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+bool Socket::IsValid() const
+{
+	return m_Handle != InvalidHandle();
+}
+
+void Socket::Close()
+{
+	if (!IsValid()) return;
+
+	CloseHandle(m_Handle);
+	m_Handle = InvalidHandle();
+}
+
+Socket::Handle Socket::InvalidHandle()
+{
+#if defined(_WIN32)
+	return static_cast<Handle>(INVALID_SOCKET);
+#else
+	return -1;
+#endif
+}
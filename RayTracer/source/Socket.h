@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	// Blocking TCP socket (Winsock on Windows, BSD sockets elsewhere), move-only so connections can live in containers
+	class Socket final
+	{
+	public:
+#if defined(_WIN32)
+		using Handle = uintptr_t;
+#else
+		using Handle = int;
+#endif
+
+		Socket() = default;
+		~Socket();
+
+		Socket(const Socket&) = delete;
+		Socket(Socket&& other) noexcept;
+		Socket& operator=(const Socket&) = delete;
+		Socket& operator=(Socket&& other) noexcept;
+
+		// Call once before using any socket (WSAStartup), safe to call multiple times
+		static bool InitializeNetwork();
+
+		bool Listen(uint16_t port);
+		// Waits at most timeoutMs for a pending connection, returns an invalid socket if there was none
+		Socket Accept(int timeoutMs);
+		bool Connect(const std::string& host, uint16_t port);
+
+		// Both return false on disconnect, error or timeout, and loop until everything is transferred
+		bool Send(const void* pData, size_t size);
+		bool Receive(void* pData, size_t size);
+
+		// Receive fails after this many milliseconds without data, used to detect hung peers
+		void SetReceiveTimeout(int timeoutMs);
+
+		bool IsValid() const;
+		void Close();
+
+	private:
+		Handle m_Handle{ InvalidHandle() };
+
+		explicit Socket(Handle handle) : m_Handle(handle) {}
+		static Handle InvalidHandle();
+	};
+}
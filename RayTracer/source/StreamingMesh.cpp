@@ -0,0 +1,150 @@
+#include "StreamingMesh.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace dae;
+
+StreamingMesh::StreamingMesh(size_t residentBudget)
+	: m_ResidentBudget(residentBudget)
+{
+}
+
+bool StreamingMesh::Open(const std::string& filename)
+{
+	if (!m_File.Open(filename)) return false;
+
+	if (m_File.GetSize() < sizeof(StreamingMeshHeader))
+	{
+		m_File.Close();
+		return false;
+	}
+
+	std::memcpy(&m_Header, m_File.GetData(), sizeof(StreamingMeshHeader));
+
+	const uint64_t expectedSize{ m_Header.clustersOffset + m_Header.clusterCount * StreamingMeshHeader::CLUSTER_SIZE };
+	if (m_Header.magic != StreamingMeshHeader::MAGIC || m_Header.version != StreamingMeshHeader::VERSION
+		|| m_Header.nodeCount == 0 || m_File.GetSize() < expectedSize)
+	{
+		m_File.Close();
+		return false;
+	}
+
+	m_ClusterStates = std::vector<ClusterState>(m_Header.clusterCount);
+	m_ResidentClusterCount.store(0, std::memory_order_relaxed);
+
+	aabb = AABB{ m_Header.minAABB, m_Header.maxAABB };
+	UpdateTransforms();
+
+	return true;
+}
+
+bool StreamingMesh::WriteFile(const std::string& filename, const std::vector<Vector3>& positions, const std::vector<int>& indices, const BVHBuildSettings& settings)
+{
+	if (indices.empty()) return false;
+
+	BVHBuildSettings fullSettings{ settings };
+	fullSettings.mode = BVHMode::Full;
+
+	BVH bvh{};
+	bvh.Build(positions, indices, fullSettings);
+
+	const std::vector<BVHNode>& nodes = bvh.GetNodes();
+	const std::vector<uint32_t>& triangleIndices = bvh.GetTriangleIndices();
+
+	StreamingMeshHeader header{};
+	header.triangleCount = static_cast<uint32_t>(triangleIndices.size());
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+	header.clusterCount = (header.triangleCount + StreamingMeshHeader::TRIANGLES_PER_CLUSTER - 1) / StreamingMeshHeader::TRIANGLES_PER_CLUSTER;
+	header.minAABB = nodes[0].minAABB;
+	header.maxAABB = nodes[0].maxAABB;
+	header.nodesOffset = sizeof(StreamingMeshHeader);
+
+	const uint64_t nodesEnd{ header.nodesOffset + nodes.size() * sizeof(BVHNode) };
+	header.clustersOffset = (nodesEnd + StreamingMeshHeader::CLUSTER_SIZE - 1) / StreamingMeshHeader::CLUSTER_SIZE * StreamingMeshHeader::CLUSTER_SIZE;
+
+	std::ofstream file{ filename, std::ios::binary };
+	if (!file) return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(StreamingMeshHeader));
+	file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(BVHNode));
+
+	// Triangles in leaf order, every cluster padded to CLUSTER_SIZE so it starts on a page boundary
+	std::vector<char> padding(StreamingMeshHeader::CLUSTER_SIZE, 0);
+	file.write(padding.data(), header.clustersOffset - nodesEnd);
+
+	std::vector<StreamedTriangle> cluster{};
+	cluster.reserve(StreamingMeshHeader::TRIANGLES_PER_CLUSTER);
+
+	for (uint32_t first{}; first < header.triangleCount; first += StreamingMeshHeader::TRIANGLES_PER_CLUSTER)
+	{
+		const uint32_t last{ std::min(first + StreamingMeshHeader::TRIANGLES_PER_CLUSTER, header.triangleCount) };
+
+		cluster.clear();
+		for (uint32_t i{ first }; i < last; ++i)
+		{
+			const size_t offset{ triangleIndices[i] * 3ull };
+			const Vector3& v0{ positions[indices[offset]] };
+			const Vector3& v1{ positions[indices[offset + 1]] };
+			const Vector3& v2{ positions[indices[offset + 2]] };
+
+			cluster.push_back({ v0, v1, v2, Vector3::Cross(v1 - v0, v2 - v0).Normalized() });
+		}
+
+		const size_t clusterBytes{ cluster.size() * sizeof(StreamedTriangle) };
+		file.write(reinterpret_cast<const char*>(cluster.data()), clusterBytes);
+		file.write(padding.data(), StreamingMeshHeader::CLUSTER_SIZE - clusterBytes);
+	}
+
+	return file.good();
+}
+
+bool StreamingMesh::ConvertOBJ(const std::string& objFilename, const std::string& filename, const BVHBuildSettings& settings)
+{
+	std::vector<Vector3> positions{};
+	std::vector<Vector3> normals{};
+	std::vector<int> indices{};
+
+	if (!Utils::ParseOBJ(objFilename, positions, normals, indices)) return false;
+
+	return WriteFile(filename, positions, indices, settings);
+}
+
+void StreamingMesh::TrimResidentSet()
+{
+	m_CurrentFrame.fetch_add(1, std::memory_order_relaxed);
+
+	const size_t budgetClusters{ std::max<size_t>(m_ResidentBudget / StreamingMeshHeader::CLUSTER_SIZE, 1) };
+	const size_t residentClusters{ m_ResidentClusterCount.load(std::memory_order_relaxed) };
+	if (residentClusters <= budgetClusters) return;
+
+	// Evict down to 7/8 of the budget so we don't end up trimming a handful of clusters every frame
+	const size_t targetClusters{ budgetClusters - budgetClusters / 8 };
+
+	std::vector<uint32_t> resident{};
+	resident.reserve(residentClusters);
+	for (uint32_t cluster{}; cluster < m_Header.clusterCount; ++cluster)
+	{
+		if (m_ClusterStates[cluster].isResident.load(std::memory_order_relaxed)) resident.push_back(cluster);
+	}
+
+	if (resident.size() <= targetClusters) return;
+
+	const size_t evictCount{ resident.size() - targetClusters };
+	std::nth_element(resident.begin(), resident.begin() + evictCount, resident.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_ClusterStates[a].lastUsedFrame.load(std::memory_order_relaxed) < m_ClusterStates[b].lastUsedFrame.load(std::memory_order_relaxed);
+	});
+
+	for (size_t i{}; i < evictCount; ++i)
+	{
+		const uint32_t cluster{ resident[i] };
+		m_ClusterStates[cluster].isResident.store(false, std::memory_order_relaxed);
+		m_File.Release(GetClusterOffset(cluster), StreamingMeshHeader::CLUSTER_SIZE);
+	}
+
+	m_ResidentClusterCount.fetch_sub(static_cast<uint32_t>(evictCount), std::memory_order_relaxed);
+	m_EvictionCount += evictCount;
+}
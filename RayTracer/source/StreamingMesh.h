@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+#include "MappedFile.h"
+
+namespace dae
+{
+	// 48 bytes, stored in BVH leaf order so a leaf only touches one or two clusters
+	struct StreamedTriangle
+	{
+		Vector3 v0{};
+		Vector3 v1{};
+		Vector3 v2{};
+		Vector3 normal{}; // object space
+	};
+
+	struct StreamingMeshHeader
+	{
+		static constexpr uint32_t MAGIC{ 0x4D535452 }; // "RTSM"
+		static constexpr uint32_t VERSION{ 1 };
+
+		// Clusters are aligned to 64 KB in the file, a multiple of the page size on every platform we target
+		static constexpr uint64_t CLUSTER_SIZE{ 64 * 1024 };
+		static constexpr uint32_t TRIANGLES_PER_CLUSTER{ static_cast<uint32_t>(CLUSTER_SIZE / sizeof(StreamedTriangle)) };
+
+		uint32_t magic{ MAGIC };
+		uint32_t version{ VERSION };
+
+		uint32_t triangleCount{}; // after spatial splits, duplicated references are stored twice
+		uint32_t nodeCount{};
+		uint32_t clusterCount{};
+		uint32_t padding{};
+
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		uint64_t nodesOffset{};
+		uint64_t clustersOffset{};
+	};
+
+	// Mesh whose BVH and triangles live in a memory mapped file instead of RAM.
+	// Leaf clusters are paged in on first access, TrimResidentSet evicts the least recently used ones
+	// once the resident set grows past the budget. The nodes are left to the OS, the top levels are hot anyway.
+	class StreamingMesh final
+	{
+	public:
+		explicit StreamingMesh(size_t residentBudget = 512ull * 1024 * 1024);
+		~StreamingMesh() = default;
+
+		StreamingMesh(const StreamingMesh&) = delete;
+		StreamingMesh(StreamingMesh&&) noexcept = delete;
+		StreamingMesh& operator=(const StreamingMesh&) = delete;
+		StreamingMesh& operator=(StreamingMesh&&) noexcept = delete;
+
+		// Only maps the file and validates the header, nothing is read up front
+		bool Open(const std::string& filename);
+
+		// Offline conversion: builds the BVH and writes nodes + clustered triangles (the source mesh has to fit in RAM once)
+		static bool WriteFile(const std::string& filename, const std::vector<Vector3>& positions, const std::vector<int>& indices, const BVHBuildSettings& settings = {});
+		static bool ConvertOBJ(const std::string& objFilename, const std::string& filename, const BVHBuildSettings& settings = {});
+
+		const BVHNode* GetNodes() const { return reinterpret_cast<const BVHNode*>(m_File.GetData() + m_Header.nodesOffset); }
+		uint32_t GetNodeCount() const { return m_Header.nodeCount; }
+		uint32_t GetTriangleCount() const { return m_Header.triangleCount; }
+
+		const StreamedTriangle& GetTriangle(uint32_t index) const
+		{
+			const uint64_t cluster{ index / StreamingMeshHeader::TRIANGLES_PER_CLUSTER };
+			const uint64_t offset{ m_Header.clustersOffset + cluster * StreamingMeshHeader::CLUSTER_SIZE
+				+ (index % StreamingMeshHeader::TRIANGLES_PER_CLUSTER) * sizeof(StreamedTriangle) };
+			return *reinterpret_cast<const StreamedTriangle*>(m_File.GetData() + offset);
+		}
+
+		// Marks the clusters holding [first, first + count) as used this frame, called by the traversal before reading a leaf
+		void TouchTriangles(uint32_t first, uint32_t count) const
+		{
+			const uint32_t firstCluster{ first / StreamingMeshHeader::TRIANGLES_PER_CLUSTER };
+			const uint32_t lastCluster{ (first + count - 1) / StreamingMeshHeader::TRIANGLES_PER_CLUSTER };
+			for (uint32_t cluster{ firstCluster }; cluster <= lastCluster; ++cluster)
+			{
+				TouchCluster(cluster);
+			}
+		}
+
+		// Call once per frame from the main thread (Scene::Update). Rays of the frame in flight may still
+		// touch evicted clusters, the mapping is read-only so those pages just fault back in from the file.
+		void TrimResidentSet();
+
+		size_t GetResidentBytes() const { return m_ResidentClusterCount.load(std::memory_order_relaxed) * StreamingMeshHeader::CLUSTER_SIZE; }
+		size_t GetResidentBudget() const { return m_ResidentBudget; }
+		uint64_t GetPageInCount() const { return m_PageInCount.load(std::memory_order_relaxed); }
+		uint64_t GetEvictionCount() const { return m_EvictionCount; }
+
+		unsigned char materialIndex{};
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+		Matrix worldTransform{};
+		Matrix inverseTransform{};
+
+		AABB aabb{};
+		AABB transformedAABB{};
+
+		void Translate(const Vector3& translation) { translationTransform = Matrix::CreateTranslation(translation); }
+		void RotateY(float yaw) { rotationTransform = Matrix::CreateRotationY(yaw); }
+		void Scale(const Vector3& scale) { scaleTransform = Matrix::CreateScale(scale); }
+
+		void UpdateTransforms()
+		{
+			worldTransform = scaleTransform * rotationTransform * translationTransform;
+			inverseTransform = Matrix::Inverse(worldTransform);
+			transformedAABB = aabb.Transformed(worldTransform);
+		}
+
+		MeshInstance GetInstance() const { return { worldTransform, inverseTransform, transformedAABB }; }
+
+	private:
+		struct ClusterState
+		{
+			std::atomic<uint32_t> lastUsedFrame{ 0 };
+			std::atomic<bool> isResident{ false };
+		};
+
+		MappedFile m_File{};
+		StreamingMeshHeader m_Header{};
+
+		mutable std::vector<ClusterState> m_ClusterStates{};
+		mutable std::atomic<uint32_t> m_ResidentClusterCount{ 0 };
+		mutable std::atomic<uint64_t> m_PageInCount{ 0 };
+		uint64_t m_EvictionCount{};
+
+		std::atomic<uint32_t> m_CurrentFrame{ 1 }; // 0 means never used
+		size_t m_ResidentBudget{};
+
+		void TouchCluster(uint32_t cluster) const
+		{
+			ClusterState& state{ m_ClusterStates[cluster] };
+
+			// Frame granularity LRU, only write when the stamp changes so the cache line stays shared between threads
+			const uint32_t frame{ m_CurrentFrame.load(std::memory_order_relaxed) };
+			if (state.lastUsedFrame.load(std::memory_order_relaxed) != frame)
+			{
+				state.lastUsedFrame.store(frame, std::memory_order_relaxed);
+			}
+
+			if (!state.isResident.load(std::memory_order_relaxed) && !state.isResident.exchange(true, std::memory_order_relaxed))
+			{
+				m_ResidentClusterCount.fetch_add(1, std::memory_order_relaxed);
+				m_PageInCount.fetch_add(1, std::memory_order_relaxed);
+
+				// The leaf only reads a few of the cluster's pages, the OS reads in the rest in the background
+				m_File.Prefetch(GetClusterOffset(cluster), StreamingMeshHeader::CLUSTER_SIZE);
+			}
+		}
+
+		uint64_t GetClusterOffset(uint32_t cluster) const { return m_Header.clustersOffset + cluster * StreamingMeshHeader::CLUSTER_SIZE; }
+	};
+}
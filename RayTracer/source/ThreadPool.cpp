@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+
+	m_Threads.reserve(threadCount);
+	for (uint32_t i{}; i < threadCount; ++i)
+	{
+		m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_Condition.notify_all();
+
+	for (auto& thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+ThreadPool& ThreadPool::GetInstance()
+{
+	static ThreadPool instance{};
+	return instance;
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_Tasks.emplace_back(std::move(task));
+	}
+	m_Condition.notify_one();
+}
+
+bool ThreadPool::TryRunPendingTask()
+{
+	std::function<void()> task{};
+	{
+		std::lock_guard lock{ m_Mutex };
+		if (m_Tasks.empty()) return false;
+
+		task = std::move(m_Tasks.front());
+		m_Tasks.pop_front();
+	}
+
+	task();
+	return true;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+	grainSize = std::max(grainSize, 1u);
+
+	// Not worth the queue round trip
+	if (count <= grainSize)
+	{
+		func(0, count);
+		return;
+	}
+
+	TaskGroup group{ *this };
+	for (uint32_t begin{}; begin < count; begin += grainSize)
+	{
+		const uint32_t end{ std::min(begin + grainSize, count) };
+		group.Run([&func, begin, end]() { func(begin, end); });
+	}
+	group.Wait();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_Condition.wait(lock, [this]() { return m_IsStopping || !m_Tasks.empty(); });
+
+			if (m_IsStopping && m_Tasks.empty()) return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void TaskGroup::Run(std::function<void()> task)
+{
+	m_PendingTasks.fetch_add(1, std::memory_order_relaxed);
+	m_Pool.Enqueue([this, task = std::move(task)]()
+	{
+		task();
+		m_PendingTasks.fetch_sub(1, std::memory_order_release);
+	});
+}
+
+void TaskGroup::Wait()
+{
+	while (m_PendingTasks.load(std::memory_order_acquire) > 0)
+	{
+		if (!m_Pool.TryRunPendingTask())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// Shared pool used by the whole project (BVH builds, ...)
+		static ThreadPool& GetInstance();
+
+		void Enqueue(std::function<void()> task);
+
+		// Pops and runs one queued task on the calling thread, returns false if the queue was empty.
+		// Waiting threads use this to help instead of blocking a worker (nested tasks can't deadlock).
+		bool TryRunPendingTask();
+
+		// Splits [0, count) into chunks of grainSize and runs them on the pool, the calling thread helps out
+		void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& func);
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> m_Threads{};
+		std::deque<std::function<void()>> m_Tasks{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		bool m_IsStopping{ false };
+	};
+
+	// Tracks a set of tasks enqueued on a ThreadPool so they can be waited on (tasks may add more tasks to the group)
+	class TaskGroup final
+	{
+	public:
+		explicit TaskGroup(ThreadPool& pool) : m_Pool(pool) {}
+		~TaskGroup() { Wait(); }
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup(TaskGroup&&) noexcept = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+		TaskGroup& operator=(TaskGroup&&) noexcept = delete;
+
+		void Run(std::function<void()> task);
+		void Wait();
+
+	private:
+		ThreadPool& m_Pool;
+		std::atomic<uint32_t> m_PendingTasks{ 0 };
+	};
+}
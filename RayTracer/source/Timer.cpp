@@ -88,10 +88,20 @@ void Timer::Update()
 		m_ElapsedTime = m_ElapsedUpperBound;
 	}
 
-	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
+	const float wallElapsedTime = m_ElapsedTime;
+
+	if (IsUsingFixedTimestep())
+	{
+		m_ElapsedTime = m_FixedTimestep;
+		m_TotalTime += m_FixedTimestep;
+	}
+	else
+	{
+		m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
+	}
 
 	//FPS LOGIC
-	m_FPSTimer += m_ElapsedTime;
+	m_FPSTimer += wallElapsedTime;
 	++m_FPSCount;
 	if (m_FPSTimer >= 1.0f)
 	{
@@ -24,6 +24,14 @@ namespace dae
 		void Update();
 		void Stop();
 
+		// Restarts the timeline at 0, every Update then advances it by exactly this step, independent of the wall clock (recording).
+		// FPS and benchmarks keep measuring real time.
+		void SetFixedTimestep(float seconds) { m_FixedTimestep = seconds; m_TotalTime = 0.f; }
+		void ClearFixedTimestep() { m_FixedTimestep = 0.f; }
+		bool IsUsingFixedTimestep() const { return m_FixedTimestep > 0.f; }
+		// Jumps the timeline, render workers use it to update their scene to the coordinator's frame
+		void SetTotal(float seconds) { m_TotalTime = seconds; }
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
@@ -49,6 +57,7 @@ namespace dae
 
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
+		float m_FixedTimestep = 0.0f;
 
 		bool m_BenchmarkActive = false;
 		float m_BenchmarkHigh{ 0.f };
@@ -1,8 +1,11 @@
 #pragma once
 #include <cassert>
+#include <chrono>
 #include <fstream>
+#include <random>
 #include "Math.h"
 #include "DataTypes.h"
+#include "StreamingMesh.h"
 
 namespace dae
 {
@@ -51,7 +54,7 @@ namespace dae
 
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			static HitRecord temp{};
+			HitRecord temp{};
 			return HitTest_Sphere(sphere, ray, temp, true);
 		}
 #pragma endregion
@@ -162,9 +165,9 @@ namespace dae
 #pragma endregion
 #pragma region TriangeMesh HitTest
 
-	inline bool SlabTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+	inline bool SlabTest_TriangleMesh(const MeshInstance& instance, const Ray& ray)
 	{
-		const auto& aabb = mesh.transformedAABB;
+		const auto& aabb = instance.transformedAABB;
 
 		Vector3 invDir = {
 			1.0f / ray.direction.x,
@@ -197,41 +200,492 @@ namespace dae
 		return true;
 	}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+	// Returns the entry distance of the ray into the box, FLT_MAX on a miss
+	inline float SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Vector3& origin, const Vector3& invDir, float tMax)
+	{
+		const float tx1 = (minAABB.x - origin.x) * invDir.x;
+		const float tx2 = (maxAABB.x - origin.x) * invDir.x;
+		float tMin = std::min(tx1, tx2);
+		tMax = std::min(tMax, std::max(tx1, tx2));
+
+		const float ty1 = (minAABB.y - origin.y) * invDir.y;
+		const float ty2 = (maxAABB.y - origin.y) * invDir.y;
+		tMin = std::max(tMin, std::min(ty1, ty2));
+		tMax = std::min(tMax, std::max(ty1, ty2));
+
+		const float tz1 = (minAABB.z - origin.z) * invDir.z;
+		const float tz2 = (maxAABB.z - origin.z) * invDir.z;
+		tMin = std::max(tMin, std::min(tz1, tz2));
+		tMax = std::min(tMax, std::max(tz1, tz2));
+
+		if (tMax >= tMin && tMax > 0.f) return tMin;
+		return FLT_MAX;
+	}
+
+		// Ordered stack traversal shared by every mesh built on BVHNodes, intersectLeaf returns true to stop early (shadow rays)
+		template<typename LeafIntersector>
+		inline void TraverseBVH(const BVHNode* pNodes, const Ray& localRay, const Ray& ray, const HitRecord& hitRecord, bool ignoreHitRecord, LeafIntersector&& intersectLeaf)
+		{
+			const Vector3 invDir = {
+				1.0f / localRay.direction.x,
+				1.0f / localRay.direction.y,
+				1.0f / localRay.direction.z
+			};
+
+			const auto closestT = [&]() { return ignoreHitRecord ? ray.max : std::min(ray.max, hitRecord.t); };
+
+			if (SlabTest_AABB(pNodes[0].minAABB, pNodes[0].maxAABB, localRay.origin, invDir, closestT()) == FLT_MAX) return;
+
+			constexpr int maxStackSize{ 64 };
+			uint32_t stack[maxStackSize];
+			int stackSize{ 0 };
+			uint32_t nodeIndex{ 0 };
+
+			while (true)
+			{
+				const BVHNode& node = pNodes[nodeIndex];
+
+				if (node.IsLeaf())
+				{
+					if (intersectLeaf(node)) return;
+
+					if (stackSize == 0) break;
+					nodeIndex = stack[--stackSize];
+					continue;
+				}
+
+				// Visit the nearest child first, push the other one
+				uint32_t nearIndex = node.leftFirst;
+				uint32_t farIndex = node.leftFirst + 1;
+				float tNear = SlabTest_AABB(pNodes[nearIndex].minAABB, pNodes[nearIndex].maxAABB, localRay.origin, invDir, closestT());
+				float tFar = SlabTest_AABB(pNodes[farIndex].minAABB, pNodes[farIndex].maxAABB, localRay.origin, invDir, closestT());
+
+				if (tFar < tNear)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(tNear, tFar);
+				}
+
+				if (tNear == FLT_MAX)
+				{
+					if (stackSize == 0) break;
+					nodeIndex = stack[--stackSize];
+					continue;
+				}
+
+				nodeIndex = nearIndex;
+				if (tFar != FLT_MAX)
+				{
+					assert(stackSize < maxStackSize && "BVH traversal stack overflow");
+					stack[stackSize++] = farIndex;
+				}
+			}
+		}
+
+		inline bool HitTest_TriangleMeshBVH(const TriangleMesh& mesh, const MeshInstance& instance, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false, uint32_t* pTriangleIndex = nullptr)
+		{
+			const std::vector<uint32_t>& triangleIndices = mesh.bvh.GetTriangleIndices();
+
+			// Trace in object space, the direction is not renormalized so t matches the world space ray
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+
+			bool didHit = false;
+			uint32_t closestTriangleIndex{};
+
+			TraverseBVH(mesh.bvh.GetNodes().data(), localRay, ray, hitRecord, ignoreHitRecord, [&](const BVHNode& leaf)
+			{
+				for (uint32_t i = 0; i < leaf.triangleCount; ++i)
+				{
+					const uint32_t triangleIndex = triangleIndices[leaf.leftFirst + i];
+					const size_t offset = triangleIndex * 3;
+
+					Triangle triangle{
+						mesh.positions[mesh.indices[offset]],
+						mesh.positions[mesh.indices[offset + 1]],
+						mesh.positions[mesh.indices[offset + 2]],
+						Vector3{}
+					};
+
+					triangle.materialIndex = mesh.materialIndex;
+					triangle.cullMode = mesh.cullMode;
+
+					if (HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
+					{
+						didHit = true;
+						closestTriangleIndex = triangleIndex;
+						if (ignoreHitRecord) return true;
+					}
+				}
+				return false;
+			});
+
+			if (didHit && pTriangleIndex) *pTriangleIndex = closestTriangleIndex;
+
+			// Hit point was calculated with the object space ray, only the closest hit needs its normal transformed
+			if (didHit && !ignoreHitRecord)
+			{
+				hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+				hitRecord.normal = instance.worldTransform.TransformVector(mesh.normals[closestTriangleIndex]).Normalized();
+			}
+
+			return didHit;
+		}
+
+		// Closest hit with one triangle of the mesh, the same result HitTest_TriangleMesh gives when that triangle is the closest
+		// (used to resolve rasterized primary visibility, see VisibilityBuffer, and to retest cached shadow occluders)
+		inline bool HitTest_TriangleMeshTriangle(const TriangleMesh& mesh, const MeshInstance& instance, uint32_t triangleIndex, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+
+			// Compressed meshes give the decoded triangle, the one their BVH traversal intersects
+			const size_t offset = triangleIndex * 3;
+			Triangle triangle{
+				mesh.GetPosition(mesh.indices[offset]),
+				mesh.GetPosition(mesh.indices[offset + 1]),
+				mesh.GetPosition(mesh.indices[offset + 2]),
+				Vector3{}
+			};
+
+			triangle.materialIndex = mesh.materialIndex;
+			triangle.cullMode = mesh.cullMode;
+
+			if (!HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord)) return false;
+			if (ignoreHitRecord) return true;
+
+			hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+			hitRecord.normal = instance.worldTransform.TransformVector(mesh.GetNormal(triangleIndex)).Normalized();
+			return true;
+		}
+
+		inline bool HitTest_TriangleMeshTriangle(const TriangleMesh& mesh, const MeshInstance& instance, uint32_t triangleIndex, const Ray& ray)
+		{
+			HitRecord temp{};
+			return HitTest_TriangleMeshTriangle(mesh, instance, triangleIndex, ray, temp, true);
+		}
+
+		// Shadow test against a preselected set of leaves of the mesh's full BVH (see ShadowPacket), no traversal
+		inline bool HitTest_TriangleMeshLeaves(const TriangleMesh& mesh, const MeshInstance& instance, const uint32_t* pLeaves, uint32_t leafCount, const Ray& ray, uint32_t* pTriangleIndex = nullptr)
+		{
+			const std::vector<BVHNode>& nodes = mesh.bvh.GetNodes();
+			const std::vector<uint32_t>& triangleIndices = mesh.bvh.GetTriangleIndices();
+
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+
+			const Vector3 invDir = {
+				1.0f / localRay.direction.x,
+				1.0f / localRay.direction.y,
+				1.0f / localRay.direction.z
+			};
+
+			HitRecord temp{};
+			for (uint32_t leafIndex = 0; leafIndex < leafCount; ++leafIndex)
+			{
+				const BVHNode& leaf = nodes[pLeaves[leafIndex]];
+				if (SlabTest_AABB(leaf.minAABB, leaf.maxAABB, localRay.origin, invDir, ray.max) == FLT_MAX) continue;
+
+				for (uint32_t i = 0; i < leaf.triangleCount; ++i)
+				{
+					const uint32_t triangleIndex = triangleIndices[leaf.leftFirst + i];
+					const size_t offset = triangleIndex * 3;
+
+					Triangle triangle{
+						mesh.positions[mesh.indices[offset]],
+						mesh.positions[mesh.indices[offset + 1]],
+						mesh.positions[mesh.indices[offset + 2]],
+						Vector3{}
+					};
+
+					triangle.materialIndex = mesh.materialIndex;
+					triangle.cullMode = mesh.cullMode;
+
+					if (HitTest_Triangle(triangle, localRay, temp, true))
+					{
+						if (pTriangleIndex) *pTriangleIndex = triangleIndex;
+						return true;
+					}
+				}
+			}
+
+			return false;
+		}
+
+		inline bool HitTest_TriangleMeshCompressedBVH(const TriangleMesh& mesh, const MeshInstance& instance, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false, uint32_t* pTriangleIndex = nullptr)
+		{
+			const std::vector<CompressedBVHNode>& nodes = mesh.bvh.GetCompressedNodes();
+			const std::vector<uint32_t>& triangleIndices = mesh.bvh.GetTriangleIndices();
+
+			// Trace in object space, the direction is not renormalized so t matches the world space ray
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+
+			const Vector3 invDir = {
+				1.0f / localRay.direction.x,
+				1.0f / localRay.direction.y,
+				1.0f / localRay.direction.z
+			};
+
+			const auto closestT = [&]() { return ignoreHitRecord ? ray.max : std::min(ray.max, hitRecord.t); };
+
+			constexpr int maxStackSize{ 64 };
+			uint32_t stack[maxStackSize];
+			int stackSize{ 0 };
+			stack[stackSize++] = 0;
+
+			bool didHit = false;
+			uint32_t closestTriangleIndex{};
+
+			while (stackSize > 0)
+			{
+				const CompressedBVHNode& node = nodes[stack[--stackSize]];
+
+				// Decode both child boxes on the fly
+				float tEntry[2]{ FLT_MAX, FLT_MAX };
+				for (int child = 0; child < 2; ++child)
+				{
+					if (node.childData[child] == CompressedBVHNode::EMPTY_CHILD) continue;
+					tEntry[child] = SlabTest_AABB(node.GetChildMin(child), node.GetChildMax(child), localRay.origin, invDir, closestT());
+				}
+
+				const int nearChild = tEntry[1] < tEntry[0] ? 1 : 0;
+				const int order[2]{ nearChild, 1 - nearChild };
+
+				// Leaves are intersected right away (near first), interior children pushed far first so the near one pops next
+				for (int child : order)
+				{
+					if (tEntry[child] == FLT_MAX || !node.IsLeaf(child)) continue;
+
+					const uint32_t first = node.childData[child] >> 5;
+					const uint32_t count = (node.childData[child] & 31) + 1;
+
+					for (uint32_t i = first; i < first + count; ++i)
+					{
+						const uint32_t triangleIndex = triangleIndices[i];
+						const size_t offset = triangleIndex * 3;
+
+						Triangle triangle{
+							mesh.bvh.DecodeVertex(mesh.indices[offset]),
+							mesh.bvh.DecodeVertex(mesh.indices[offset + 1]),
+							mesh.bvh.DecodeVertex(mesh.indices[offset + 2]),
+							Vector3{}
+						};
+
+						triangle.materialIndex = mesh.materialIndex;
+						triangle.cullMode = mesh.cullMode;
+
+						if (HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
+						{
+							if (ignoreHitRecord)
+							{
+								if (pTriangleIndex) *pTriangleIndex = triangleIndex;
+								return true;
+							}
+							didHit = true;
+							closestTriangleIndex = triangleIndex;
+						}
+					}
+				}
+
+				for (int child : { order[1], order[0] })
+				{
+					if (tEntry[child] == FLT_MAX || node.IsLeaf(child)) continue;
+
+					assert(stackSize < maxStackSize && "BVH traversal stack overflow");
+					stack[stackSize++] = node.childData[child];
+				}
+			}
+
+			// Hit point was calculated with the object space ray, only the closest hit needs its normal transformed
+			if (didHit)
+			{
+				if (pTriangleIndex) *pTriangleIndex = closestTriangleIndex;
+				hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+				hitRecord.normal = instance.worldTransform.TransformVector(mesh.GetNormal(closestTriangleIndex)).Normalized();
+			}
+
+			return didHit;
+		}
+
+		// pTriangleIndex receives the closest triangle, or with ignoreHitRecord the first one found that blocks the ray
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const MeshInstance& instance, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false, uint32_t* pTriangleIndex = nullptr)
 		{
-			if (!SlabTest_TriangleMesh(mesh, ray)) return false;
+			if (mesh.bvh.IsBuilt())
+			{
+				if (mesh.bvh.GetMode() == BVHMode::Compressed) return HitTest_TriangleMeshCompressedBVH(mesh, instance, ray, hitRecord, ignoreHitRecord, pTriangleIndex);
+				return HitTest_TriangleMeshBVH(mesh, instance, ray, hitRecord, ignoreHitRecord, pTriangleIndex);
+			}
+
+			if (!SlabTest_TriangleMesh(instance, ray)) return false;
+
+			// Trace in object space, the direction is not renormalized so t matches the world space ray
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
 
 			size_t triangleCount = mesh.indices.size() / 3;
 
 			bool didHit = false;
+			size_t closestTriangleIndex{};
 
 			for (size_t i = 0; i < triangleCount; ++i)
 			{
 				size_t offset = i * 3;
 				 
 				Triangle triangle{
-					mesh.transformedPositions[mesh.indices[offset]],
-					mesh.transformedPositions[mesh.indices[offset + 1]],
-					mesh.transformedPositions[mesh.indices[offset + 2]],
-					mesh.transformedNormals[i]
+					mesh.positions[mesh.indices[offset]],
+					mesh.positions[mesh.indices[offset + 1]],
+					mesh.positions[mesh.indices[offset + 2]],
+					Vector3{}
 				};
 
 				triangle.materialIndex = mesh.materialIndex;
 				triangle.cullMode = mesh.cullMode;
 
-				if (HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord))
+				if (HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
 				{
 					didHit = true;
+					closestTriangleIndex = i;
+					if (ignoreHitRecord) break;
+				}
+			}
+
+			if (didHit && pTriangleIndex) *pTriangleIndex = static_cast<uint32_t>(closestTriangleIndex);
+
+			if (didHit && !ignoreHitRecord)
+			{
+				hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+				hitRecord.normal = instance.worldTransform.TransformVector(mesh.normals[closestTriangleIndex]).Normalized();
+			}
+
+			return didHit;
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const MeshInstance& instance, const Ray& ray, uint32_t* pTriangleIndex = nullptr)
+		{
+			HitRecord temp{};
+			return HitTest_TriangleMesh(mesh, instance, ray, temp, true, pTriangleIndex);
+		}
+
+		// Traces the mesh with its current transform, the renderer uses the transforms captured in the SceneSnapshot instead
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			return HitTest_TriangleMesh(mesh, mesh.GetInstance(), ray, hitRecord, ignoreHitRecord);
+		}
+
+		// pTriangleIndex receives the closest triangle (in file order), or with ignoreHitRecord the first one found that blocks the ray
+		inline bool HitTest_StreamingMesh(const StreamingMesh& mesh, const MeshInstance& instance, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false, uint32_t* pTriangleIndex = nullptr)
+		{
+			// Trace in object space, the direction is not renormalized so t matches the world space ray
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+
+			bool didHit = false;
+			uint32_t closestTriangleIndex{};
+
+			TraverseBVH(mesh.GetNodes(), localRay, ray, hitRecord, ignoreHitRecord, [&](const BVHNode& leaf)
+			{
+				mesh.TouchTriangles(leaf.leftFirst, leaf.triangleCount);
+
+				for (uint32_t i = leaf.leftFirst; i < leaf.leftFirst + leaf.triangleCount; ++i)
+				{
+					const StreamedTriangle& streamed = mesh.GetTriangle(i);
+
+					Triangle triangle{ streamed.v0, streamed.v1, streamed.v2, streamed.normal };
+					triangle.materialIndex = mesh.materialIndex;
+					triangle.cullMode = mesh.cullMode;
+
+					if (HitTest_Triangle(triangle, localRay, hitRecord, ignoreHitRecord))
+					{
+						didHit = true;
+						closestTriangleIndex = i;
+						if (ignoreHitRecord) return true;
+					}
 				}
+				return false;
+			});
+
+			if (didHit && pTriangleIndex) *pTriangleIndex = closestTriangleIndex;
+
+			// Hit point was calculated with the object space ray, only the closest hit needs its normal transformed
+			if (didHit && !ignoreHitRecord)
+			{
+				hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+				hitRecord.normal = instance.worldTransform.TransformVector(mesh.GetTriangle(closestTriangleIndex).normal).Normalized();
 			}
 
 			return didHit;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		inline bool HitTest_StreamingMesh(const StreamingMesh& mesh, const MeshInstance& instance, const Ray& ray, uint32_t* pTriangleIndex = nullptr)
+		{
+			HitRecord temp{};
+			return HitTest_StreamingMesh(mesh, instance, ray, temp, true, pTriangleIndex);
+		}
+
+		// Shadow test against one triangle of the mesh (a cached occluder), pages its cluster in like the traversal does
+		inline bool HitTest_StreamingMeshTriangle(const StreamingMesh& mesh, const MeshInstance& instance, uint32_t triangleIndex, const Ray& ray)
 		{
-			static HitRecord temp{};
-			return HitTest_TriangleMesh(mesh, ray, temp, true);
+			Ray localRay{ ray };
+			localRay.origin = instance.inverseTransform.TransformPoint(ray.origin);
+			localRay.direction = instance.inverseTransform.TransformVector(ray.direction);
+
+			mesh.TouchTriangles(triangleIndex, 1);
+			const StreamedTriangle& streamed = mesh.GetTriangle(triangleIndex);
+
+			Triangle triangle{ streamed.v0, streamed.v1, streamed.v2, streamed.normal };
+			triangle.materialIndex = mesh.materialIndex;
+			triangle.cullMode = mesh.cullMode;
+
+			HitRecord temp{};
+			return HitTest_Triangle(triangle, localRay, temp, true);
+		}
+
+		// Fires random rays from a sphere around the mesh towards its bounds, returns closest hit rays per second
+		inline float MeasureTraversalThroughput(const TriangleMesh& mesh, uint32_t rayCount = 100'000)
+		{
+			const Vector3 center = (mesh.transformedAABB.minAABB + mesh.transformedAABB.maxAABB) * 0.5f;
+			const Vector3 extent = mesh.transformedAABB.maxAABB - mesh.transformedAABB.minAABB;
+			const float radius = extent.Magnitude();
+
+			std::mt19937 generator{ 42 };
+			std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+
+			std::vector<Ray> rays(rayCount);
+			for (Ray& ray : rays)
+			{
+				Vector3 direction{ distribution(generator), distribution(generator), distribution(generator) };
+				if (direction.SqrMagnitude() < 0.0001f) direction = Vector3::UnitZ;
+				direction.Normalize();
+
+				const Vector3 target{
+					center.x + distribution(generator) * extent.x * 0.5f,
+					center.y + distribution(generator) * extent.y * 0.5f,
+					center.z + distribution(generator) * extent.z * 0.5f
+				};
+
+				ray.origin = center + direction * radius;
+				ray.direction = (target - ray.origin).Normalized();
+			}
+
+			const auto startTime = std::chrono::high_resolution_clock::now();
+
+			for (const Ray& ray : rays)
+			{
+				HitRecord hitRecord{};
+				HitTest_TriangleMesh(mesh, ray, hitRecord);
+			}
+
+			const auto endTime = std::chrono::high_resolution_clock::now();
+			const float seconds = std::chrono::duration<float>(endTime - startTime).count();
+
+			return seconds > 0.f ? rayCount / seconds : 0.f;
 		}
 
 #pragma endregion
@@ -244,19 +698,32 @@ namespace dae
 		{
 			//todo W3
 
-			if (light.type == LightType::Point) return (light.origin - origin);
-			else if (light.type == LightType::Directional) return -light.direction;
+			if (light.type == LightType::Directional) return -light.direction;
 
-			return Vector3{};
+			return (light.origin - origin); // point and area lights (their center)
 		}
 
 		inline ColorRGB GetRadiance(const Light& light, const Vector3& target)
 		{
 			//todo W3
-			if (light.type == LightType::Point) return light.color * (light.intensity / GetDirectionToLight(light, target).SqrMagnitude());
-			else if (light.type == LightType::Directional) return light.color * light.intensity;;
+			if (light.type == LightType::Directional) return light.color * light.intensity;
+
+			return light.color * (light.intensity / GetDirectionToLight(light, target).SqrMagnitude());
+		}
+
+		// Point on an area light for u, v in [0, 1). Sphere lights are sampled on the disk facing the target.
+		inline Vector3 GetAreaLightSample(const Light& light, const Vector3& target, float u, float v)
+		{
+			if (light.type == LightType::QuadArea)
+				return light.origin + light.extentU * (2.f * u - 1.f) + light.extentV * (2.f * v - 1.f);
+
+			const Vector3 toTarget{ (target - light.origin).Normalized() };
+			const Vector3 tangent{ Vector3::Cross(fabsf(toTarget.y) < .99f ? Vector3::UnitY : Vector3::UnitX, toTarget).Normalized() };
+			const Vector3 bitangent{ Vector3::Cross(toTarget, tangent) };
 
-			return ColorRGB{};
+			const float distance{ light.radius * sqrtf(u) };
+			const float angle{ PI_2 * v };
+			return light.origin + tangent * (distance * cosf(angle)) + bitangent * (distance * sinf(angle));
 		}
 	}
 
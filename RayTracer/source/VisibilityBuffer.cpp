@@ -0,0 +1,388 @@
+#include "VisibilityBuffer.h"
+#include "SceneSnapshot.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <execution>
+#include <ranges>
+
+namespace dae
+{
+	namespace
+	{
+		// Closer than this to the camera triangles get clipped, spheres cover the whole region
+		constexpr float NEAR_PLANE{ 0.001f };
+		constexpr int BAND_HEIGHT{ 16 };
+
+		float EdgeFunction(float ax, float ay, float bx, float by, float px, float py)
+		{
+			return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+		}
+	}
+
+	void VisibilityBuffer::Setup(const SceneSnapshot& snapshot, int width, int height, float aspectRatio)
+	{
+		if (width != m_Width || height != m_Height || aspectRatio != m_AspectRatio || snapshot.fov != m_Fov)
+			UpdateCameraDirections(width, height, aspectRatio, snapshot.fov);
+
+		m_FallbackCount = 0;
+
+		const Matrix worldToCamera{ Matrix::Inverse(snapshot.cameraToWorld) };
+		SetupTriangles(snapshot, worldToCamera);
+		SetupSpheres(snapshot, worldToCamera);
+	}
+
+	void VisibilityBuffer::Rasterize(int x0, int y0, int x1, int y1, ThreadPool* pThreadPool)
+	{
+		m_RegionX0 = x0;
+		m_RegionY0 = y0;
+		m_RegionX1 = x1;
+		m_RegionY1 = y1;
+
+		// Distributed tiles are small, the bands only loop over what overlaps this region
+		const auto isOverlapping = [&](int minX, int maxX, int minY, int maxY)
+		{
+			return maxX >= x0 && minX < x1 && maxY >= y0 && minY < y1;
+		};
+
+		m_RegionTriangles.clear();
+		for (uint32_t i{}; i < m_Triangles.size(); ++i)
+		{
+			const ScreenTriangle& triangle = m_Triangles[i];
+			if (isOverlapping(triangle.minX, triangle.maxX, triangle.minY, triangle.maxY)) m_RegionTriangles.push_back(i);
+		}
+
+		m_RegionSpheres.clear();
+		for (uint32_t i{}; i < m_Spheres.size(); ++i)
+		{
+			const ScreenSphere& sphere = m_Spheres[i];
+			if (isOverlapping(sphere.minX, sphere.maxX, sphere.minY, sphere.maxY)) m_RegionSpheres.push_back(i);
+		}
+
+		const uint32_t bandCount{ static_cast<uint32_t>((y1 - y0 + BAND_HEIGHT - 1) / BAND_HEIGHT) };
+		const auto rasterizeBand = [&](uint32_t band)
+		{
+			const int bandY0{ y0 + static_cast<int>(band) * BAND_HEIGHT };
+			RasterizeBand(bandY0, std::min(bandY0 + BAND_HEIGHT, y1));
+		};
+
+		if (pThreadPool)
+		{
+			pThreadPool->ParallelFor(bandCount, 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t band{ begin }; band < end; ++band) rasterizeBand(band);
+			});
+		}
+		else
+		{
+			auto bands = std::views::iota(0u, bandCount);
+			std::for_each(std::execution::par, bands.begin(), bands.end(), rasterizeBand);
+		}
+	}
+
+	void VisibilityBuffer::UpdateCameraDirections(int width, int height, float aspectRatio, float fov)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_AspectRatio = aspectRatio;
+		m_Fov = fov;
+
+		m_Samples.resize(static_cast<size_t>(width) * height);
+		m_CameraDirections.resize(static_cast<size_t>(width) * height);
+
+		// Same as Renderer::CalculatePixelCoordinates, before the camera transform
+		const float invWidth{ 1.f / width };
+		const float invHeight{ 1.f / height };
+		for (int y{}; y < height; ++y)
+		{
+			for (int x{}; x < width; ++x)
+			{
+				const float cx{ (2 * ((x + .5f) * invWidth) - 1) * aspectRatio * fov };
+				const float cy{ (1 - (2 * ((y + .5f) * invHeight))) * fov };
+				m_CameraDirections[x + y * width] = Vector3(cx, cy, 1).Normalized();
+			}
+		}
+	}
+
+	void VisibilityBuffer::SetupTriangles(const SceneSnapshot& snapshot, const Matrix& worldToCamera)
+	{
+		m_Triangles.clear();
+
+		std::vector<Vector3> cameraPositions{};
+		for (uint32_t meshIndex{}; meshIndex < snapshot.triangleMeshes.size(); ++meshIndex)
+		{
+			const TriangleMesh& mesh = *snapshot.triangleMeshes[meshIndex].pMesh;
+			const MeshInstance& instance = snapshot.triangleMeshes[meshIndex].instance;
+
+			const Matrix objectToCamera{ instance.worldTransform * worldToCamera };
+			// Compressed meshes only have their decoded positions, the ones their BVH traces
+			cameraPositions.resize(mesh.GetVertexCount());
+			for (size_t vertexIndex{}; vertexIndex < cameraPositions.size(); ++vertexIndex)
+			{
+				cameraPositions[vertexIndex] = objectToCamera.TransformPoint(mesh.GetPosition(static_cast<int>(vertexIndex)));
+			}
+
+			// The tracer decides the facing in object space, a mirroring transform flips it
+			const float handedness{ Vector3::Dot(Vector3::Cross(instance.worldTransform.GetAxisX(), instance.worldTransform.GetAxisY()), instance.worldTransform.GetAxisZ()) < 0.f ? -1.f : 1.f };
+
+			const uint32_t triangleCount{ static_cast<uint32_t>(mesh.indices.size() / 3) };
+			for (uint32_t triangleIndex{}; triangleIndex < triangleCount; ++triangleIndex)
+			{
+				const Vector3 vertices[3]{
+					cameraPositions[mesh.indices[triangleIndex * 3]],
+					cameraPositions[mesh.indices[triangleIndex * 3 + 1]],
+					cameraPositions[mesh.indices[triangleIndex * 3 + 2]]
+				};
+
+				// Sign of the determinant HitTest_Triangle checks, the camera sits in the origin so any ray toward the triangle will do
+				const float facing{ Vector3::Dot(Vector3::Cross(vertices[1] - vertices[0], vertices[2] - vertices[0]), vertices[0]) * handedness };
+				if (facing == 0.f) continue;
+				if (mesh.cullMode == TriangleCullMode::FrontFaceCulling && facing < 0.f) continue;
+				if (mesh.cullMode == TriangleCullMode::BackFaceCulling && facing > 0.f) continue;
+
+				AddTriangle(vertices, meshIndex, triangleIndex);
+			}
+		}
+	}
+
+	void VisibilityBuffer::AddTriangle(const Vector3* pCameraVertices, uint32_t meshIndex, uint32_t triangleIndex)
+	{
+		// Sutherland-Hodgman against z = NEAR_PLANE, a triangle becomes at most a quad
+		Vector3 polygon[4]{};
+		int vertexCount{};
+		for (int i{}; i < 3; ++i)
+		{
+			const Vector3& current = pCameraVertices[i];
+			const Vector3& next = pCameraVertices[(i + 1) % 3];
+			const bool isCurrentInside{ current.z >= NEAR_PLANE };
+			const bool isNextInside{ next.z >= NEAR_PLANE };
+
+			if (isCurrentInside) polygon[vertexCount++] = current;
+			if (isCurrentInside != isNextInside)
+			{
+				const float s{ (NEAR_PLANE - current.z) / (next.z - current.z) };
+				polygon[vertexCount++] = current + (next - current) * s;
+			}
+		}
+		if (vertexCount < 3) return;
+
+		// Pixel center (x, y) sits at (x + .5, y + .5)
+		const float scaleX{ .5f * m_Width / (m_AspectRatio * m_Fov) };
+		const float scaleY{ .5f * m_Height / m_Fov };
+
+		float screenX[4]{}, screenY[4]{}, invZ[4]{};
+		for (int i{}; i < vertexCount; ++i)
+		{
+			invZ[i] = 1.f / polygon[i].z;
+			screenX[i] = .5f * m_Width + polygon[i].x * invZ[i] * scaleX;
+			screenY[i] = .5f * m_Height - polygon[i].y * invZ[i] * scaleY;
+		}
+
+		for (int i{ 1 }; i + 1 < vertexCount; ++i)
+		{
+			ScreenTriangle triangle{};
+			const int corners[3]{ 0, i, i + 1 };
+			for (int c{}; c < 3; ++c)
+			{
+				triangle.x[c] = screenX[corners[c]];
+				triangle.y[c] = screenY[corners[c]];
+				triangle.invZ[c] = invZ[corners[c]];
+			}
+
+			const auto [minX, maxX] = std::minmax({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			const auto [minY, maxY] = std::minmax({ triangle.y[0], triangle.y[1], triangle.y[2] });
+			if (maxX < 0.f || minX > m_Width || maxY < 0.f || minY > m_Height) continue;
+
+			triangle.minX = std::max(static_cast<int>(ceilf(minX - .5f)), 0);
+			triangle.maxX = std::min(static_cast<int>(floorf(maxX - .5f)), m_Width - 1);
+			triangle.minY = std::max(static_cast<int>(ceilf(minY - .5f)), 0);
+			triangle.maxY = std::min(static_cast<int>(floorf(maxY - .5f)), m_Height - 1);
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+
+			triangle.meshIndex = meshIndex;
+			triangle.triangleIndex = triangleIndex;
+			m_Triangles.push_back(triangle);
+		}
+	}
+
+	void VisibilityBuffer::SetupSpheres(const SceneSnapshot& snapshot, const Matrix& worldToCamera)
+	{
+		m_Spheres.clear();
+
+		const float scaleX{ .5f * m_Width / (m_AspectRatio * m_Fov) };
+		const float scaleY{ .5f * m_Height / m_Fov };
+
+		for (uint32_t sphereIndex{}; sphereIndex < snapshot.spheres.size(); ++sphereIndex)
+		{
+			ScreenSphere sphere{};
+			sphere.center = worldToCamera.TransformPoint(snapshot.spheres[sphereIndex].origin);
+			sphere.radius = snapshot.spheres[sphereIndex].radius;
+			sphere.sphereIndex = sphereIndex;
+
+			if (sphere.center.z + sphere.radius < NEAR_PLANE) continue; // behind the camera
+
+			sphere.minX = 0;
+			sphere.maxX = m_Width - 1;
+			sphere.minY = 0;
+			sphere.maxY = m_Height - 1;
+
+			if (sphere.center.z - sphere.radius >= NEAR_PLANE)
+			{
+				// x / z and y / z of the bounding box corners bound the projection, z > 0 everywhere
+				const float nearZ{ sphere.center.z - sphere.radius };
+				const float farZ{ sphere.center.z + sphere.radius };
+				const float left{ sphere.center.x - sphere.radius }, right{ sphere.center.x + sphere.radius };
+				const float bottom{ sphere.center.y - sphere.radius }, top{ sphere.center.y + sphere.radius };
+
+				const float minX{ std::min(left / nearZ, left / farZ) * scaleX + .5f * m_Width };
+				const float maxX{ std::max(right / nearZ, right / farZ) * scaleX + .5f * m_Width };
+				const float minY{ .5f * m_Height - std::max(top / nearZ, top / farZ) * scaleY };
+				const float maxY{ .5f * m_Height - std::min(bottom / nearZ, bottom / farZ) * scaleY };
+
+				sphere.minX = std::max(static_cast<int>(floorf(minX - .5f)), sphere.minX);
+				sphere.maxX = std::min(static_cast<int>(ceilf(maxX - .5f)), sphere.maxX);
+				sphere.minY = std::max(static_cast<int>(floorf(minY - .5f)), sphere.minY);
+				sphere.maxY = std::min(static_cast<int>(ceilf(maxY - .5f)), sphere.maxY);
+				if (sphere.minX > sphere.maxX || sphere.minY > sphere.maxY) continue;
+			}
+
+			m_Spheres.push_back(sphere);
+		}
+	}
+
+	void VisibilityBuffer::RasterizeBand(int bandY0, int bandY1)
+	{
+		for (int y{ bandY0 }; y < bandY1; ++y)
+		{
+			std::fill(m_Samples.begin() + (m_RegionX0 + y * m_Width), m_Samples.begin() + (m_RegionX1 + y * m_Width), Sample{});
+		}
+
+		const float rayMin{ Ray{}.min };
+
+		// Analytic spheres: the exact intersection of the primary ray, over the projected bounds only
+		for (uint32_t screenSphereIndex : m_RegionSpheres)
+		{
+			const ScreenSphere& sphere = m_Spheres[screenSphereIndex];
+			const int rowBegin{ std::max(sphere.minY, bandY0) };
+			const int rowEnd{ std::min(sphere.maxY + 1, bandY1) };
+			const int columnBegin{ std::max(sphere.minX, m_RegionX0) };
+			const int columnEnd{ std::min(sphere.maxX + 1, m_RegionX1) };
+			const float c{ sphere.center.SqrMagnitude() - sphere.radius * sphere.radius };
+
+			for (int y{ rowBegin }; y < rowEnd; ++y)
+			{
+				for (int x{ columnBegin }; x < columnEnd; ++x)
+				{
+					const int pixelIndex{ x + y * m_Width };
+					const float b{ Vector3::Dot(m_CameraDirections[pixelIndex], sphere.center) };
+					const float discriminant{ b * b - c };
+					if (discriminant < 0.f) continue;
+
+					const float root{ sqrtf(discriminant) };
+					float t{ b - root };
+					if (t < rayMin) t = b + root;
+					if (t < rayMin) continue;
+
+					Sample& sample = m_Samples[pixelIndex];
+					if (t >= sample.t) continue;
+
+					sample.t = t;
+					sample.primitiveIndex = sphere.sphereIndex;
+					sample.type = PrimitiveType::Sphere;
+				}
+			}
+		}
+
+		// Triangles: edge functions at the pixel centers, 1 / z interpolates linearly in screen space
+		for (uint32_t screenTriangleIndex : m_RegionTriangles)
+		{
+			const ScreenTriangle& triangle = m_Triangles[screenTriangleIndex];
+			const int rowBegin{ std::max(triangle.minY, bandY0) };
+			const int rowEnd{ std::min(triangle.maxY + 1, bandY1) };
+			if (rowBegin >= rowEnd) continue;
+			const int columnBegin{ std::max(triangle.minX, m_RegionX0) };
+			const int columnEnd{ std::min(triangle.maxX + 1, m_RegionX1) };
+
+			const float area{ EdgeFunction(triangle.x[0], triangle.y[0], triangle.x[1], triangle.y[1], triangle.x[2], triangle.y[2]) };
+			if (area == 0.f) continue;
+			const float invArea{ 1.f / area };
+
+			for (int y{ rowBegin }; y < rowEnd; ++y)
+			{
+				const float py{ y + .5f };
+				const float px{ columnBegin + .5f };
+
+				// Barycentric weights of the first pixel of the row, stepped along x
+				float w0{ EdgeFunction(triangle.x[1], triangle.y[1], triangle.x[2], triangle.y[2], px, py) * invArea };
+				float w1{ EdgeFunction(triangle.x[2], triangle.y[2], triangle.x[0], triangle.y[0], px, py) * invArea };
+				float w2{ EdgeFunction(triangle.x[0], triangle.y[0], triangle.x[1], triangle.y[1], px, py) * invArea };
+				const float step0{ -(triangle.y[2] - triangle.y[1]) * invArea };
+				const float step1{ -(triangle.y[0] - triangle.y[2]) * invArea };
+				const float step2{ -(triangle.y[1] - triangle.y[0]) * invArea };
+
+				for (int x{ columnBegin }; x < columnEnd; ++x, w0 += step0, w1 += step1, w2 += step2)
+				{
+					if (w0 < 0.f || w1 < 0.f || w2 < 0.f) continue;
+
+					const int pixelIndex{ x + y * m_Width };
+					const float invZ{ w0 * triangle.invZ[0] + w1 * triangle.invZ[1] + w2 * triangle.invZ[2] };
+					const float t{ 1.f / (invZ * m_CameraDirections[pixelIndex].z) };
+
+					Sample& sample = m_Samples[pixelIndex];
+					if (t >= sample.t) continue;
+
+					sample.t = t;
+					sample.primitiveIndex = triangle.meshIndex;
+					sample.triangleIndex = triangle.triangleIndex;
+					sample.type = PrimitiveType::Triangle;
+				}
+			}
+		}
+	}
+
+	void VisibilityBuffer::GetClosestHit(const SceneSnapshot& snapshot, uint32_t pixelIndex, const Ray& viewRay, HitRecord& closestHit) const
+	{
+		const Sample& sample = m_Samples[pixelIndex];
+
+		// Same order as SceneSnapshot::GetClosestHit (spheres, planes, meshes), so equal distances resolve the same way
+		if (sample.type == PrimitiveType::Sphere && !GeometryUtils::HitTest_Sphere(snapshot.spheres[sample.primitiveIndex], viewRay, closestHit))
+		{
+			++m_FallbackCount;
+			closestHit = HitRecord{};
+			snapshot.GetClosestHit(viewRay, closestHit);
+			return;
+		}
+
+		HitRecord meshHit{};
+		if (sample.type == PrimitiveType::Triangle)
+		{
+			const SceneSnapshot::TriangleMeshEntry& entry = snapshot.triangleMeshes[sample.primitiveIndex];
+
+			if (!GeometryUtils::HitTest_TriangleMeshTriangle(*entry.pMesh, entry.instance, sample.triangleIndex, viewRay, meshHit))
+			{
+				++m_FallbackCount;
+				snapshot.GetClosestHit(viewRay, closestHit);
+				return;
+			}
+		}
+
+		for (const Plane& plane : snapshot.planes)
+		{
+			GeometryUtils::HitTest_Plane(plane, viewRay, closestHit);
+		}
+
+		if (meshHit.didHit && meshHit.t < closestHit.t) closestHit = meshHit;
+
+		for (const SceneSnapshot::StreamingMeshEntry& entry : snapshot.streamingMeshes)
+		{
+			GeometryUtils::HitTest_StreamingMesh(*entry.pMesh, entry.instance, viewRay, closestHit);
+		}
+	}
+
+	uint32_t VisibilityBuffer::GetFallbackCount() const
+	{
+		return m_FallbackCount;
+	}
+
+}
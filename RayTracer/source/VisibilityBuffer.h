@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Forward Declarations
+	struct SceneSnapshot;
+	class ThreadPool;
+
+	// Primary visibility by rasterization: every pixel center gets the closest sphere or mesh triangle under it, so the
+	// primary ray only has to intersect that one primitive instead of the whole scene. Planes (unbounded) and streaming
+	// meshes (not resident) aren't rasterized, they are still intersected per pixel.
+	// Triangles are rasterized with edge functions in bands of rows, spheres are splatted over their projected bounds
+	// with an exact intersection per pixel.
+	class VisibilityBuffer final
+	{
+	public:
+		VisibilityBuffer() = default;
+		~VisibilityBuffer() = default;
+
+		VisibilityBuffer(const VisibilityBuffer&) = delete;
+		VisibilityBuffer(VisibilityBuffer&&) noexcept = delete;
+		VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+		VisibilityBuffer& operator=(VisibilityBuffer&&) noexcept = delete;
+
+		// Projects the spheres and mesh triangles of the snapshot for a width x height frame, same camera model as
+		// Renderer::CalculatePixelCoordinates. Once per frame, before the Rasterize calls of that frame.
+		void Setup(const SceneSnapshot& snapshot, int width, int height, float aspectRatio);
+		// Rasterizes the pixels in [x0, x1) x [y0, y1) from the primitives of the last Setup, only the ones overlapping the region.
+		// Without a thread pool the bands run on std::execution::par.
+		void Rasterize(int x0, int y0, int x1, int y1, ThreadPool* pThreadPool);
+
+		// Same HitRecord as SceneSnapshot::GetClosestHit for the primary ray of pixelIndex. Where the rasterizer
+		// and the ray disagree (pixel centers on a silhouette) the pixel falls back to tracing the whole scene.
+		void GetClosestHit(const SceneSnapshot& snapshot, uint32_t pixelIndex, const Ray& viewRay, HitRecord& closestHit) const;
+
+		// Pixels of the current frame that had to be traced, reset by Setup
+		uint32_t GetFallbackCount() const;
+
+	private:
+		enum class PrimitiveType : uint8_t
+		{
+			None,
+			Sphere,
+			Triangle
+		};
+
+		struct Sample
+		{
+			float t{ FLT_MAX }; // along the normalized primary ray
+			uint32_t primitiveIndex{}; // sphere or triangle mesh entry of the snapshot
+			uint32_t triangleIndex{};
+			PrimitiveType type{ PrimitiveType::None };
+		};
+
+		// Screen space triangle, x and y in pixels (pixel centers at + .5), 1 / z for perspective correct depth
+		struct ScreenTriangle
+		{
+			float x[3]{};
+			float y[3]{};
+			float invZ[3]{};
+
+			int minX{}, maxX{}, minY{}, maxY{}; // inclusive pixel bounds, clamped to the frame
+
+			uint32_t meshIndex{};
+			uint32_t triangleIndex{};
+		};
+
+		struct ScreenSphere
+		{
+			Vector3 center{}; // camera space
+			float radius{};
+
+			int minX{}, maxX{}, minY{}, maxY{};
+
+			uint32_t sphereIndex{};
+		};
+
+		int m_Width{};
+		int m_Height{};
+		float m_AspectRatio{};
+		float m_Fov{};
+		int m_RegionX0{}, m_RegionY0{}, m_RegionX1{}, m_RegionY1{};
+
+		std::vector<Sample> m_Samples{};
+		std::vector<Vector3> m_CameraDirections{}; // normalized, per pixel
+
+		std::vector<ScreenTriangle> m_Triangles{};
+		std::vector<ScreenSphere> m_Spheres{};
+		// Indices of the primitives overlapping the current region, filled by Rasterize
+		std::vector<uint32_t> m_RegionTriangles{};
+		std::vector<uint32_t> m_RegionSpheres{};
+
+		mutable std::atomic<uint32_t> m_FallbackCount{};
+
+		void UpdateCameraDirections(int width, int height, float aspectRatio, float fov);
+		void SetupTriangles(const SceneSnapshot& snapshot, const Matrix& worldToCamera);
+		void SetupSpheres(const SceneSnapshot& snapshot, const Matrix& worldToCamera);
+		// Clips against the near plane and appends the 0, 1 or 2 resulting screen triangles
+		void AddTriangle(const Vector3* pCameraVertices, uint32_t meshIndex, uint32_t triangleIndex);
+
+		void RasterizeBand(int bandY0, int bandY1);
+	};
+}
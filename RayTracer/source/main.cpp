@@ -5,12 +5,18 @@
 #undef main
 
 //Standard includes
+#include <future>
 #include <iostream>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
+#include "ImageWriter.h"
+#include "Recorder.h"
+#include "DistributedRendering.h"
+#include "ScalingBenchmark.h"
 #include "Scene.h"
+#include "SceneSnapshot.h"
 
 using namespace dae;
 
@@ -22,9 +28,28 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Recording mode (see RecordingSettings::ParseCommandLine)
+	RecordingSettings recordingSettings{};
+	const bool isRecording = RecordingSettings::ParseCommandLine(argc, args, recordingSettings);
+
+	//Distributed rendering (see DistributedSettings::ParseCommandLine)
+	DistributedSettings distributedSettings{};
+	DistributedSettings::ParseCommandLine(argc, args, distributedSettings);
+
+	if (distributedSettings.mode == DistributedSettings::Mode::Worker)
+	{
+		//Headless, the coordinator picks the scene
+		RenderWorker worker{};
+		return worker.Run(distributedSettings.host, distributedSettings.port) ? 0 : 1;
+	}
+
+	//Scaling benchmark (see ScalingBenchmarkSettings::ParseCommandLine), headless as well
+	ScalingBenchmarkSettings scalingSettings{};
+	if (ScalingBenchmarkSettings::ParseCommandLine(argc, args, scalingSettings))
+	{
+		ScalingBenchmark benchmark{ scalingSettings };
+		return benchmark.Run() ? 0 : 1;
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -44,26 +69,73 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
-
-	//const auto pScene = new Scene_W1();
-	//const auto pScene = new Scene_W2();
-	//const auto pScene = new Scene_W3();
-	//const auto pScene = new Scene_W4_TestScene();
-	const auto pScene = new Scene_W4_ReferenceScene();
-	//const auto pScene = new Scene_W4_BunnyScene();
+	const auto pImageWriter = new ImageWriter();
+
+	//const uint32_t sceneIndex = 0; // Scene_W1
+	//const uint32_t sceneIndex = 1; // Scene_W2
+	//const uint32_t sceneIndex = 2; // Scene_W3
+	//const uint32_t sceneIndex = 3; // Scene_W4_TestScene
+	const uint32_t sceneIndex = 4; // Scene_W4_ReferenceScene
+	//const uint32_t sceneIndex = 5; // Scene_W4_BunnyScene
+	//const uint32_t sceneIndex = 6; // Scene_File (Resources/reference_scene.rtscene)
+	//const uint32_t sceneIndex = 7; // Scene_Stress
+	//const uint32_t sceneIndex = 8; // Scene_File (Resources/area_light_scene.rtscene), soft shadows
+	//const uint32_t sceneIndex = 9; // Scene_File (Resources/streaming_scene.rtscene), out-of-core bunny
+	const auto pScene = CreateScene(sceneIndex);
 	pScene->Initialize();
 
+	RenderCoordinator* pCoordinator = nullptr;
+	if (distributedSettings.mode == DistributedSettings::Mode::Coordinator)
+	{
+		pCoordinator = new RenderCoordinator(sceneIndex);
+		if (pCoordinator->Listen(distributedSettings.port))
+			pCoordinator->AcceptWorkers(distributedSettings.expectedWorkers, 30000);
+	}
+
+	Recorder* pRecorder = nullptr;
+	if (isRecording)
+	{
+		pRecorder = new Recorder(recordingSettings, *pImageWriter);
+		if (!pRecorder->Begin(*pTimer, *pRenderer, *pScene))
+		{
+			delete pRecorder;
+			pRecorder = nullptr;
+		}
+	}
+
 	//Start loop
 	pTimer->Start();
 
 	// Start Benchmark
 	pTimer->StartBenchmark();
 
+	// Frame N is traced from its own snapshot while the main thread updates frame N + 1 into the other one
+	SceneSnapshot snapshots[2]{};
+	int currentSnapshot = 0;
+	pScene->Update(pTimer);
+	pScene->CreateSnapshot(snapshots[currentSnapshot]);
+
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	ImageFormat screenshotFormat = ImageFormat::PNG;
 	while (isLooping)
 	{
+		//--------- Render (worker) ---------
+		const SceneSnapshot& renderSnapshot = snapshots[currentSnapshot];
+		std::future<void> renderTask = std::async(std::launch::async, [pRenderer, pCoordinator, &renderSnapshot]()
+		{
+			if (pCoordinator)
+				pCoordinator->RenderFrame(renderSnapshot, *pRenderer);
+			else
+				pRenderer->Render(renderSnapshot);
+		});
+
+		//Renderer settings are applied between frames
+		bool toggleShadows = false;
+		bool cycleLighting = false;
+		bool toggleRasterizedPrimary = false;
+
 		//--------- Get input events ---------
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
@@ -75,12 +147,24 @@ int main(int argc, char* args[])
 				break;
 			case SDL_KEYUP:
 				if(e.key.keysym.scancode == SDL_SCANCODE_X)
+				{
+					takeScreenshot = true;
+					screenshotFormat = ImageFormat::PNG;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_C)
+				{
 					takeScreenshot = true;
+					screenshotFormat = ImageFormat::EXR; // unclamped radiance
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
-					pRenderer->ToggleShadowRendering();
+					toggleShadows = true;
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 				{
-					pRenderer->CycleLightning();
+					cycleLighting = true;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+				{
+					toggleRasterizedPrimary = true;
 				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 				{
@@ -91,34 +175,77 @@ int main(int argc, char* args[])
 		}
 
 		//--------- Update ---------
+		pTimer->Update();
 		pScene->Update(pTimer);
+		pScene->CreateSnapshot(snapshots[1 - currentSnapshot]);
 
-		//--------- Render ---------
-		pRenderer->Render(pScene);
+		//--------- Present ---------
+		renderTask.get();
+		currentSnapshot = 1 - currentSnapshot;
+
+		pRenderer->Present();
+
+		if (toggleShadows)
+			pRenderer->ToggleShadowRendering();
+		if (cycleLighting)
+			pRenderer->CycleLightning();
+		if (toggleRasterizedPrimary)
+		{
+			pRenderer->ToggleRasterizedPrimaryVisibility();
+			std::cout << "Primary visibility: " << (pRenderer->IsRasterizedPrimaryVisibilityActive() ? "rasterized" : "traced") << std::endl;
+		}
+
+		//--------- Recording ---------
+		if (pRecorder && !pRecorder->SubmitFrame(*pRenderer))
+		{
+			isLooping = false;
+		}
 
 		//--------- Timer ---------
-		pTimer->Update();
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+
+			const ShadowCacheStatistics shadowStatistics{ pRenderer->ConsumeShadowCacheStatistics() };
+			if (shadowStatistics.shadowRays > 0)
+				std::cout << "Shadow occluder cache: " << shadowStatistics.GetHitRate() * 100.f << "% hits, "
+					<< shadowStatistics.blockedRays << " of " << shadowStatistics.shadowRays << " shadow rays blocked" << std::endl;
+
+			if (pRenderer->IsRasterizedPrimaryVisibilityActive())
+				std::cout << "Rasterized primary visibility: " << pRenderer->GetRasterizedFallbackCount() << " of "
+					<< pRenderer->GetWidth() * pRenderer->GetHeight() << " pixels fell back to tracing" << std::endl;
+
+			for (const StreamingMesh* pMesh : pScene->GetStreamingMeshes())
+			{
+				std::cout << "Streaming mesh: " << pMesh->GetResidentBytes() / (1024 * 1024) << " of " << pMesh->GetResidentBudget() / (1024 * 1024)
+					<< " MB resident, " << pMesh->GetPageInCount() << " clusters paged in, " << pMesh->GetEvictionCount() << " evicted" << std::endl;
+			}
 		}
 
-		//Save screenshot after full render
+		//Save screenshot after full render, encoding and writing happens on the writer's thread
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			Image screenshot = pImageWriter->AcquireImage(pRenderer->GetWidth(), pRenderer->GetHeight());
+			pRenderer->CaptureFrame(screenshot);
+			pImageWriter->Submit(std::move(screenshot), screenshotFormat == ImageFormat::EXR ? "RayTracing_Buffer.exr" : "RayTracing_Buffer.png", screenshotFormat);
+			std::cout << "Screenshot queued!" << std::endl;
 			takeScreenshot = false;
 		}
 	}
 	pTimer->Stop();
 
+	if (pRecorder)
+	{
+		pRecorder->End(*pTimer);
+		delete pRecorder;
+	}
+
 	//Shutdown "framework"
+	delete pCoordinator; // stops the workers
 	delete pScene;
+	delete pImageWriter; // finishes pending writes
 	delete pRenderer;
 	delete pTimer;
 